@@ -10,6 +10,7 @@
 #include <atomic>
 
 #include <libcamera/base/bound_method.h>
+#include <libcamera/base/utils.h>
 
 namespace libcamera {
 
@@ -42,6 +43,7 @@ private:
 
 	Type type_;
 	Object *receiver_;
+	utils::time_point timestamp_;
 
 	static std::atomic_uint nextUserType_;
 };
@@ -0,0 +1,161 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * metrics.h - Latency metrics registry
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <libcamera/base/private.h>
+
+#include <libcamera/base/class.h>
+#include <libcamera/base/mutex.h>
+#include <libcamera/base/thread_annotations.h>
+#include <libcamera/base/utils.h>
+
+namespace libcamera {
+
+class MetricHistogram
+{
+public:
+	MetricHistogram(const std::string &name);
+	~MetricHistogram();
+
+	const std::string &name() const { return name_; }
+
+	void record(uint64_t value);
+	void record(utils::duration duration)
+	{
+		record(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+	}
+
+	uint64_t count() const;
+	uint64_t sum() const;
+	uint64_t min() const;
+	uint64_t max() const;
+	uint64_t percentile(double percent) const;
+
+	void reset();
+
+	class Timer
+	{
+	public:
+		Timer(MetricHistogram &histogram)
+			: histogram_(histogram), start_(utils::clock::now())
+		{
+		}
+
+		~Timer()
+		{
+			histogram_.record(utils::clock::now() - start_);
+		}
+
+	private:
+		LIBCAMERA_DISABLE_COPY_AND_MOVE(Timer)
+
+		MetricHistogram &histogram_;
+		utils::time_point start_;
+	};
+
+	static constexpr unsigned int kSubBucketBits = 3;
+	static constexpr unsigned int kSubBuckets = 1 << kSubBucketBits;
+	static constexpr unsigned int kBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+	static unsigned int bucketIndex(uint64_t value);
+	static uint64_t bucketLowerBound(unsigned int index);
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(MetricHistogram)
+
+	const std::string name_;
+
+	std::atomic<uint64_t> buckets_[kBuckets];
+	std::atomic<uint64_t> count_;
+	std::atomic<uint64_t> sum_;
+	std::atomic<uint64_t> min_;
+	std::atomic<uint64_t> max_;
+};
+
+class MetricCounter
+{
+public:
+	MetricCounter(const std::string &name);
+	~MetricCounter();
+
+	const std::string &name() const { return name_; }
+
+	void add(uint64_t value = 1)
+	{
+		value_.fetch_add(value, std::memory_order_relaxed);
+	}
+
+	uint64_t value() const
+	{
+		return value_.load(std::memory_order_relaxed);
+	}
+
+	void reset()
+	{
+		value_.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(MetricCounter)
+
+	const std::string name_;
+	std::atomic<uint64_t> value_;
+};
+
+class MetricsRegistry
+{
+public:
+	struct HistogramStats {
+		std::string name;
+		uint64_t count;
+		uint64_t sum;
+		uint64_t min;
+		uint64_t max;
+		uint64_t p50;
+		uint64_t p90;
+		uint64_t p99;
+	};
+
+	struct CounterStats {
+		std::string name;
+		uint64_t value;
+	};
+
+	static MetricsRegistry *instance();
+
+	std::vector<HistogramStats> histograms() const;
+	std::vector<CounterStats> counters() const;
+
+	void dump(std::ostream &out) const;
+	void reset();
+
+private:
+	MetricsRegistry();
+	~MetricsRegistry();
+
+	friend class MetricHistogram;
+	friend class MetricCounter;
+
+	void registerHistogram(MetricHistogram *histogram);
+	void unregisterHistogram(MetricHistogram *histogram);
+	void registerCounter(MetricCounter *counter);
+	void unregisterCounter(MetricCounter *counter);
+
+	mutable Mutex mutex_;
+	std::vector<MetricHistogram *> histograms_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	std::vector<MetricCounter *> counters_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+};
+
+} /* namespace libcamera */
@@ -8,8 +8,10 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include <sys/types.h>
 #include <thread>
+#include <vector>
 
 #include <libcamera/base/private.h>
 
@@ -28,7 +30,13 @@ class ThreadMain;
 class Thread
 {
 public:
-	Thread();
+	enum class Policy {
+		Other,
+		Fifo,
+		RoundRobin,
+	};
+
+	explicit Thread(const std::string &name = {});
 	virtual ~Thread();
 
 	void start();
@@ -37,10 +45,15 @@ public:
 
 	bool isRunning();
 
+	const std::string &name() const { return name_; }
+	int setPriority(Policy policy, int priority = 0);
+	int setAffinity(const std::vector<unsigned int> &cpus);
+
 	Signal<> finished;
 
 	static Thread *current();
 	static pid_t currentId();
+	static void configureCurrent(const std::string &name);
 
 	EventDispatcher *eventDispatcher();
 
@@ -53,6 +66,7 @@ protected:
 private:
 	void startThread();
 	void finishThread();
+	void applySettings();
 
 	void postMessage(std::unique_ptr<Message> msg, Object *receiver);
 	void removeMessages(Object *receiver);
@@ -67,6 +81,7 @@ private:
 
 	std::thread thread_;
 	ThreadData *data_;
+	std::string name_;
 };
 
 } /* namespace libcamera */
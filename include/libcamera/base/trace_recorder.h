@@ -0,0 +1,185 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * trace_recorder.h - In-process trace event recorder
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <libcamera/base/private.h>
+
+#include <libcamera/base/class.h>
+#include <libcamera/base/mutex.h>
+#include <libcamera/base/thread_annotations.h>
+#include <libcamera/base/utils.h>
+
+namespace libcamera {
+
+class TraceRecorder
+{
+public:
+	static constexpr unsigned int kMaxArgs = 6;
+
+	struct Arg {
+		enum Type : uint8_t {
+			Int,
+			UInt,
+			Double,
+			Pointer,
+			String,
+		};
+
+		Type type;
+		union {
+			int64_t i;
+			uint64_t u;
+			double d;
+			char s[16];
+		};
+	};
+
+	struct Event {
+		const char *name;
+		const char *category;
+		const char *const *argNames;
+		uint64_t timestamp;
+		uint64_t value;
+		char phase;
+		uint8_t numArgs;
+		Arg args[kMaxArgs];
+	};
+
+	class Scope
+	{
+	public:
+		Scope(const char *name)
+			: name_(enabled() ? name : nullptr)
+		{
+			if (name_)
+				start_ = utils::clock::now();
+		}
+
+		~Scope()
+		{
+			if (name_)
+				instance()->complete(name_, start_, utils::clock::now());
+		}
+
+	private:
+		LIBCAMERA_DISABLE_COPY_AND_MOVE(Scope)
+
+		const char *name_;
+		utils::time_point start_;
+	};
+
+	static TraceRecorder *instance();
+
+	static bool enabled()
+	{
+		return enabled_.load(std::memory_order_relaxed);
+	}
+
+	void start();
+	void stop();
+
+	template<typename... Args>
+	void record(const char *category, const char *name,
+		    const char *const *argNames, const Args &...args)
+	{
+		static_assert(sizeof...(Args) <= kMaxArgs, "Too many arguments");
+
+		Event *event = reserve();
+		if (!event)
+			return;
+
+		event->name = name;
+		event->category = category;
+		event->argNames = argNames;
+		event->timestamp = timestamp(utils::clock::now());
+		event->value = 0;
+		event->phase = 'i';
+		event->numArgs = sizeof...(Args);
+
+		[[maybe_unused]] unsigned int i = 0;
+		(convert(args, &event->args[i++]), ...);
+
+		commit();
+	}
+
+	void begin(const char *category, const char *name);
+	void end(const char *category, const char *name);
+	void complete(const char *name, utils::time_point start,
+		      utils::time_point end);
+
+	void write(std::ostream &out) const;
+	int write(const std::string &path) const;
+	void flush() const;
+
+private:
+	struct Buffer;
+
+	TraceRecorder();
+	~TraceRecorder();
+
+	Event *reserve();
+	void commit();
+	Buffer *createBuffer();
+
+	static uint64_t timestamp(utils::time_point time);
+
+	template<typename T>
+	static void convert(const T &value, Arg *arg)
+	{
+		using U = std::decay_t<T>;
+
+		if constexpr (std::is_same_v<U, std::string>) {
+			convert(value.c_str(), arg);
+		} else if constexpr (std::is_same_v<U, char *> ||
+				     std::is_same_v<U, const char *>) {
+			arg->type = Arg::String;
+			convertString(value, arg);
+		} else if constexpr (std::is_pointer_v<U>) {
+			arg->type = Arg::Pointer;
+			arg->u = reinterpret_cast<uintptr_t>(value);
+		} else if constexpr (std::is_enum_v<U>) {
+			arg->type = Arg::Int;
+			arg->i = static_cast<int64_t>(value);
+		} else if constexpr (std::is_floating_point_v<U>) {
+			arg->type = Arg::Double;
+			arg->d = value;
+		} else if constexpr (std::is_signed_v<U>) {
+			arg->type = Arg::Int;
+			arg->i = value;
+		} else {
+			arg->type = Arg::UInt;
+			arg->u = value;
+		}
+	}
+
+	static void convertString(const char *value, Arg *arg);
+
+	static std::atomic<bool> enabled_;
+	static thread_local Buffer *currentBuffer_;
+
+	mutable Mutex mutex_;
+	std::vector<std::unique_ptr<Buffer>> buffers_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	std::string path_;
+	unsigned int capacity_;
+};
+
+} /* namespace libcamera */
+
+#define LIBCAMERA_TRACE_CONCAT_(a, b) a##b
+#define LIBCAMERA_TRACE_CONCAT(a, b) LIBCAMERA_TRACE_CONCAT_(a, b)
+
+#define LIBCAMERA_TRACE_SCOPE(name) \
+	libcamera::TraceRecorder::Scope LIBCAMERA_TRACE_CONCAT(_traceScope, __LINE__)(name)
@@ -7,14 +7,18 @@
 
 #pragma once
 
+#include <array>
 #include <memory>
 #include <utility>
 
 #include <libcamera/base/class.h>
+#include <libcamera/base/mutex.h>
 
 #include <libcamera/fence.h>
 #include <libcamera/framebuffer.h>
 
+#include "libcamera/internal/mapped_framebuffer.h"
+
 namespace libcamera {
 
 class FrameBuffer::Private : public Extensible::Private
@@ -33,10 +37,16 @@ public:
 
 	void cancel() { LIBCAMERA_O_PTR()->metadata_.status = FrameMetadata::FrameCancelled; }
 
+	const MappedFrameBuffer *map(MappedFrameBuffer::MapFlags flags) const;
+
 private:
 	std::unique_ptr<Fence> fence_;
 	Request *request_;
 	bool isContiguous_;
+
+	mutable Mutex mappingsMutex_;
+	mutable std::array<std::unique_ptr<MappedFrameBuffer>, 3> mappings_
+		LIBCAMERA_TSA_GUARDED_BY(mappingsMutex_);
 };
 
 } /* namespace libcamera */
@@ -12,6 +12,7 @@
 
 #include <libcamera/base/class.h>
 #include <libcamera/base/flags.h>
+#include <libcamera/base/shared_fd.h>
 #include <libcamera/base/span.h>
 
 #include <libcamera/framebuffer.h>
@@ -54,7 +55,36 @@ public:
 
 	using MapFlags = Flags<MapFlag>;
 
+	class CpuAccess
+	{
+	public:
+		CpuAccess(const MappedFrameBuffer &buffer)
+			: buffer_(buffer)
+		{
+			buffer_.beginCpuAccess();
+		}
+
+		~CpuAccess()
+		{
+			buffer_.endCpuAccess();
+		}
+
+	private:
+		LIBCAMERA_DISABLE_COPY_AND_MOVE(CpuAccess)
+
+		const MappedFrameBuffer &buffer_;
+	};
+
 	MappedFrameBuffer(const FrameBuffer *buffer, MapFlags flags);
+
+	int beginCpuAccess() const;
+	int endCpuAccess() const;
+
+private:
+	int sync(uint64_t flags) const;
+
+	MapFlags flags_;
+	std::vector<SharedFD> fds_;
 };
 
 LIBCAMERA_FLAGS_ENABLE_OPERATORS(MappedFrameBuffer::MapFlag)
@@ -8,11 +8,13 @@
 #define __LIBCAMERA_INTERNAL_REQUEST_H__
 
 #include <chrono>
-#include <map>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #include <libcamera/base/event_notifier.h>
 #include <libcamera/base/timer.h>
+#include <libcamera/base/utils.h>
 
 #include <libcamera/request.h>
 
@@ -56,8 +58,12 @@ private:
 	uint32_t sequence_ = 0;
 	bool prepared_ = false;
 
-	std::unordered_set<FrameBuffer *> pending_;
-	std::map<FrameBuffer *, std::unique_ptr<EventNotifier>> notifiers_;
+	utils::time_point queueTime_;
+	utils::time_point deviceQueueTime_;
+	utils::time_point bufferTime_;
+
+	std::vector<FrameBuffer *> pending_;
+	std::vector<std::pair<FrameBuffer *, std::unique_ptr<EventNotifier>>> notifiers_;
 	std::unique_ptr<Timer> timer_;
 };
 
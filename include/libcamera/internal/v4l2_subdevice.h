@@ -7,10 +7,12 @@
 
 #pragma once
 
+#include <map>
 #include <memory>
 #include <optional>
 #include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <libcamera/base/class.h>
@@ -60,7 +62,8 @@ public:
 	int setSelection(unsigned int pad, unsigned int target,
 			 Rectangle *rect);
 
-	Formats formats(unsigned int pad);
+	Formats formats(unsigned int pad, Whence whence = ActiveFormat);
+	void invalidateFormats();
 
 	int getFormat(unsigned int pad, V4L2SubdeviceFormat *format,
 		      Whence whence = ActiveFormat);
@@ -78,13 +81,14 @@ protected:
 private:
 	LIBCAMERA_DISABLE_COPY(V4L2Subdevice)
 
-	std::vector<unsigned int> enumPadCodes(unsigned int pad);
-	std::vector<SizeRange> enumPadSizes(unsigned int pad,
-					    unsigned int code);
+	std::vector<unsigned int> enumPadCodes(unsigned int pad, Whence whence);
+	std::vector<SizeRange> enumPadSizes(unsigned int pad, unsigned int code,
+					    Whence whence);
 
 	const MediaEntity *entity_;
 
 	std::string model_;
+	std::map<std::pair<unsigned int, Whence>, Formats> formats_;
 };
 
 } /* namespace libcamera */
@@ -8,11 +8,12 @@
 #pragma once
 
 #include <iterator>
-#include <map>
+#include <memory>
 #include <string>
-#include <vector>
+#include <string_view>
 
 #include <libcamera/base/class.h>
+#include <libcamera/base/span.h>
 
 #include <libcamera/geometry.h>
 
@@ -24,8 +25,13 @@ class YamlParserContext;
 class YamlObject
 {
 private:
-	using DictContainer = std::map<std::string, std::unique_ptr<YamlObject>>;
-	using ListContainer = std::vector<std::unique_ptr<YamlObject>>;
+	struct DictEntry {
+		const std::string *key;
+		const YamlObject *value;
+	};
+
+	using DictContainer = Span<const DictEntry>;
+	using ListContainer = Span<const YamlObject *const>;
 
 public:
 #ifndef __DOXYGEN__
@@ -100,12 +106,12 @@ public:
 
 		value_type operator*() const
 		{
-			return *it_->get();
+			return **it_;
 		}
 
 		pointer operator->() const
 		{
-			return it_->get();
+			return *it_;
 		}
 	};
 
@@ -118,7 +124,7 @@ public:
 
 		value_type operator*() const
 		{
-			return { it_->first, *it_->second.get() };
+			return { *it_->key, *it_->value };
 		}
 	};
 
@@ -167,6 +173,32 @@ public:
 #endif
 	T get(const T &defaultValue, bool *ok = nullptr) const;
 
+#ifndef __DOXYGEN__
+	template<typename T,
+		 typename std::enable_if_t<
+			 std::is_same_v<double, T> ||
+			 std::is_same_v<int16_t, T> ||
+			 std::is_same_v<uint16_t, T> ||
+			 std::is_same_v<int32_t, T> ||
+			 std::is_same_v<uint32_t, T>> * = nullptr>
+#else
+	template<typename T>
+#endif
+	bool getList(Span<T> values) const;
+
+#ifndef __DOXYGEN__
+	template<typename T,
+		 typename std::enable_if_t<
+			 std::is_same_v<double, T> ||
+			 std::is_same_v<int16_t, T> ||
+			 std::is_same_v<uint16_t, T> ||
+			 std::is_same_v<int32_t, T> ||
+			 std::is_same_v<uint32_t, T>> * = nullptr>
+#else
+	template<typename T>
+#endif
+	bool getTable(Span<T> values, std::size_t rows, std::size_t columns) const;
+
 	DictAdapter asDict() const { return DictAdapter{ dictionary_ }; }
 	ListAdapter asList() const { return ListAdapter{ list_ }; }
 
@@ -180,6 +212,8 @@ private:
 
 	friend class YamlParserContext;
 
+	struct Storage;
+
 	enum class Type {
 		Dictionary,
 		List,
@@ -188,9 +222,12 @@ private:
 
 	Type type_;
 
-	std::string value_;
+	std::string_view value_;
 	ListContainer list_;
 	DictContainer dictionary_;
+
+	/* Storage for the whole tree, owned by the root object. */
+	std::unique_ptr<Storage> storage_;
 };
 
 class YamlParser final
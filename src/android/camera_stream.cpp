@@ -257,7 +257,7 @@ void CameraStream::putBuffer(FrameBuffer *buffer)
  * its queue.
  */
 CameraStream::PostProcessorWorker::PostProcessorWorker(PostProcessor *postProcessor)
-	: postProcessor_(postProcessor)
+	: Thread("PostProcessor"), postProcessor_(postProcessor)
 {
 }
 
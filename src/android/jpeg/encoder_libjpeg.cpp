@@ -7,6 +7,7 @@
 
 #include "encoder_libjpeg.h"
 
+#include <errno.h>
 #include <fcntl.h>
 #include <iomanip>
 #include <iostream>
@@ -22,6 +23,7 @@
 #include <libcamera/pixel_format.h>
 
 #include "libcamera/internal/formats.h"
+#include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/mapped_framebuffer.h"
 
 using namespace libcamera;
@@ -181,14 +183,16 @@ void EncoderLibJpeg::compressNV(const std::vector<Span<uint8_t>> &planes)
 int EncoderLibJpeg::encode(const FrameBuffer &source, Span<uint8_t> dest,
 			   Span<const uint8_t> exifData, unsigned int quality)
 {
-	MappedFrameBuffer frame(&source, MappedFrameBuffer::MapFlag::Read);
-	if (!frame.isValid()) {
-		LOG(JPEG, Error) << "Failed to map FrameBuffer : "
-				 << strerror(frame.error());
-		return frame.error();
+	const MappedFrameBuffer *frame =
+		source._d()->map(MappedFrameBuffer::MapFlag::Read);
+	if (!frame) {
+		LOG(JPEG, Error) << "Failed to map FrameBuffer";
+		return -EINVAL;
 	}
 
-	return encode(frame.planes(), dest, exifData, quality);
+	MappedFrameBuffer::CpuAccess access(*frame);
+
+	return encode(frame->planes(), dest, exifData, quality);
 }
 
 int EncoderLibJpeg::encode(const std::vector<Span<uint8_t>> &src,
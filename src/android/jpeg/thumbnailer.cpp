@@ -11,6 +11,7 @@
 
 #include <libcamera/formats.h>
 
+#include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/mapped_framebuffer.h"
 
 using namespace libcamera;
@@ -41,11 +42,10 @@ void Thumbnailer::createThumbnail(const FrameBuffer &source,
 				  const Size &targetSize,
 				  std::vector<unsigned char> *destination)
 {
-	MappedFrameBuffer frame(&source, MappedFrameBuffer::MapFlag::Read);
-	if (!frame.isValid()) {
-		LOG(Thumbnailer, Error)
-			<< "Failed to map FrameBuffer : "
-			<< strerror(frame.error());
+	const MappedFrameBuffer *frame =
+		source._d()->map(MappedFrameBuffer::MapFlag::Read);
+	if (!frame) {
+		LOG(Thumbnailer, Error) << "Failed to map FrameBuffer";
 		return;
 	}
 
@@ -59,12 +59,14 @@ void Thumbnailer::createThumbnail(const FrameBuffer &source,
 	const unsigned int tw = targetSize.width;
 	const unsigned int th = targetSize.height;
 
-	ASSERT(frame.planes().size() == 2);
+	ASSERT(frame->planes().size() == 2);
 	ASSERT(tw % 2 == 0 && th % 2 == 0);
 
+	MappedFrameBuffer::CpuAccess access(*frame);
+
 	/* Image scaling block implementing nearest-neighbour algorithm. */
-	unsigned char *src = frame.planes()[0].data();
-	unsigned char *srcC = frame.planes()[1].data();
+	unsigned char *src = frame->planes()[0].data();
+	unsigned char *srcC = frame->planes()[1].data();
 	unsigned char *srcCb, *srcCr;
 	unsigned char *dstY, *srcY;
 
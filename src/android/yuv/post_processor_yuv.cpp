@@ -16,6 +16,7 @@
 #include <libcamera/pixel_format.h>
 
 #include "libcamera/internal/formats.h"
+#include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/mapped_framebuffer.h"
 
 using namespace libcamera;
@@ -59,16 +60,19 @@ void PostProcessorYuv::process(Camera3RequestDescriptor::StreamBuffer *streamBuf
 		return;
 	}
 
-	const MappedFrameBuffer sourceMapped(&source, MappedFrameBuffer::MapFlag::Read);
-	if (!sourceMapped.isValid()) {
+	const MappedFrameBuffer *sourceMapped =
+		source._d()->map(MappedFrameBuffer::MapFlag::Read);
+	if (!sourceMapped) {
 		LOG(YUV, Error) << "Failed to mmap camera frame buffer";
 		processComplete.emit(streamBuffer, PostProcessor::Status::Error);
 		return;
 	}
 
-	int ret = libyuv::NV12Scale(sourceMapped.planes()[0].data(),
+	MappedFrameBuffer::CpuAccess access(*sourceMapped);
+
+	int ret = libyuv::NV12Scale(sourceMapped->planes()[0].data(),
 				    sourceStride_[0],
-				    sourceMapped.planes()[1].data(),
+				    sourceMapped->planes()[1].data(),
 				    sourceStride_[1],
 				    sourceSize_.width, sourceSize_.height,
 				    destination->plane(0).data(),
@@ -10,6 +10,8 @@
 
 #include <libcamera/formats.h>
 
+#include <gst/allocators/allocators.h>
+
 using namespace libcamera;
 
 static struct {
@@ -87,10 +89,105 @@ bare_structure_from_format(const PixelFormat &format)
 	}
 }
 
+/*
+ * Create the structure describing the format for DMABuf memory. Starting with
+ * GStreamer 1.24, the format is expressed with a DRM fourcc and modifier in
+ * the drm-format field, while the format field is set to DMA_DRM. Older
+ * versions use the same format names as for system memory.
+ */
+static GstStructure *
+dmabuf_structure_from_format(const PixelFormat &format)
+{
+	GstVideoFormat gst_format = pixel_format_to_gst_format(format);
+
+	/* Compressed formats are not exported as DMABuf. */
+	if (gst_format == GST_VIDEO_FORMAT_UNKNOWN ||
+	    gst_format == GST_VIDEO_FORMAT_ENCODED)
+		return nullptr;
+
+#if GST_CHECK_VERSION(1, 24, 0)
+	g_autofree gchar *drm_format =
+		gst_video_dma_drm_fourcc_to_string(format.fourcc(), format.modifier());
+	if (!drm_format)
+		return nullptr;
+
+	return gst_structure_new("video/x-raw",
+				 "format", G_TYPE_STRING, "DMA_DRM",
+				 "drm-format", G_TYPE_STRING, drm_format,
+				 nullptr);
+#else
+	return bare_structure_from_format(format);
+#endif
+}
+
+static PixelFormat
+dmabuf_structure_to_pixel_format(const GstStructure *s)
+{
+	const gchar *format = gst_structure_get_string(s, "format");
+
+#if GST_CHECK_VERSION(1, 24, 0)
+	if (g_strcmp0(format, "DMA_DRM") == 0) {
+		const gchar *drm_format = gst_structure_get_string(s, "drm-format");
+		guint64 modifier;
+		guint32 fourcc;
+
+		if (!drm_format)
+			return PixelFormat{};
+
+		fourcc = gst_video_dma_drm_fourcc_from_string(drm_format, &modifier);
+		if (!fourcc)
+			return PixelFormat{};
+
+		PixelFormat pixelformat(fourcc, modifier);
+		if (pixel_format_to_gst_format(pixelformat) == GST_VIDEO_FORMAT_UNKNOWN)
+			return PixelFormat{};
+
+		return pixelformat;
+	}
+#endif
+
+	return gst_format_to_pixel_format(gst_video_format_from_string(format));
+}
+
+static void
+append_format_structures(GstCaps *caps, const GstStructure *bare_s,
+			 const StreamFormats &formats, const PixelFormat &pixelformat,
+			 const gchar *feature)
+{
+	for (const Size &size : formats.sizes(pixelformat)) {
+		GstStructure *s = gst_structure_copy(bare_s);
+		gst_structure_set(s,
+				  "width", G_TYPE_INT, size.width,
+				  "height", G_TYPE_INT, size.height,
+				  nullptr);
+		gst_caps_append_structure_full(caps, s,
+					       feature ? gst_caps_features_new(feature, nullptr)
+						       : nullptr);
+	}
+
+	const SizeRange &range = formats.range(pixelformat);
+	if (range.hStep && range.vStep) {
+		GstStructure *s = gst_structure_copy(bare_s);
+		GValue val = G_VALUE_INIT;
+
+		g_value_init(&val, GST_TYPE_INT_RANGE);
+		gst_value_set_int_range_step(&val, range.min.width, range.max.width, range.hStep);
+		gst_structure_set_value(s, "width", &val);
+		gst_value_set_int_range_step(&val, range.min.height, range.max.height, range.vStep);
+		gst_structure_set_value(s, "height", &val);
+		g_value_unset(&val);
+
+		gst_caps_append_structure_full(caps, s,
+					       feature ? gst_caps_features_new(feature, nullptr)
+						       : nullptr);
+	}
+}
+
 GstCaps *
 gst_libcamera_stream_formats_to_caps(const StreamFormats &formats)
 {
 	GstCaps *caps = gst_caps_new_empty();
+	GstCaps *sysmem_caps = gst_caps_new_empty();
 
 	for (PixelFormat pixelformat : formats.pixelformats()) {
 		g_autoptr(GstStructure) bare_s = bare_structure_from_format(pixelformat);
@@ -101,50 +198,102 @@ gst_libcamera_stream_formats_to_caps(const StreamFormats &formats)
 			continue;
 		}
 
-		for (const Size &size : formats.sizes(pixelformat)) {
-			GstStructure *s = gst_structure_copy(bare_s);
-			gst_structure_set(s,
-					  "width", G_TYPE_INT, size.width,
-					  "height", G_TYPE_INT, size.height,
-					  nullptr);
-			gst_caps_append_structure(caps, s);
-		}
-
-		const SizeRange &range = formats.range(pixelformat);
-		if (range.hStep && range.vStep) {
-			GstStructure *s = gst_structure_copy(bare_s);
-			GValue val = G_VALUE_INIT;
-
-			g_value_init(&val, GST_TYPE_INT_RANGE);
-			gst_value_set_int_range_step(&val, range.min.width, range.max.width, range.hStep);
-			gst_structure_set_value(s, "width", &val);
-			gst_value_set_int_range_step(&val, range.min.height, range.max.height, range.vStep);
-			gst_structure_set_value(s, "height", &val);
-			g_value_unset(&val);
+		append_format_structures(sysmem_caps, bare_s, formats, pixelformat,
+					 nullptr);
 
-			gst_caps_append_structure(caps, s);
-		}
+		g_autoptr(GstStructure) dmabuf_s = dmabuf_structure_from_format(pixelformat);
+		if (dmabuf_s)
+			append_format_structures(caps, dmabuf_s, formats, pixelformat,
+						 GST_CAPS_FEATURE_MEMORY_DMABUF);
 	}
 
+	/*
+	 * List the DMABuf caps first, so that they get preferred when
+	 * downstream supports both DMABuf and system memory.
+	 */
+	gst_caps_append(caps, sysmem_caps);
+
 	return caps;
 }
 
 GstCaps *
-gst_libcamera_stream_configuration_to_caps(const StreamConfiguration &stream_cfg)
+gst_libcamera_stream_configuration_to_caps(const StreamConfiguration &stream_cfg,
+					   gboolean dmabuf)
 {
 	GstCaps *caps = gst_caps_new_empty();
-	GstStructure *s = bare_structure_from_format(stream_cfg.pixelFormat);
+	GstStructure *s = nullptr;
+
+	if (dmabuf)
+		s = dmabuf_structure_from_format(stream_cfg.pixelFormat);
+	if (!s) {
+		s = bare_structure_from_format(stream_cfg.pixelFormat);
+		dmabuf = FALSE;
+	}
 
 	gst_structure_set(s,
 			  "width", G_TYPE_INT, stream_cfg.size.width,
 			  "height", G_TYPE_INT, stream_cfg.size.height,
 			  nullptr);
-	gst_caps_append_structure(caps, s);
+	gst_caps_append_structure_full(caps, s,
+				       dmabuf ? gst_caps_features_new(GST_CAPS_FEATURE_MEMORY_DMABUF, nullptr)
+					      : nullptr);
 
 	return caps;
 }
 
-void
+gboolean
+gst_libcamera_stream_configuration_to_video_info(const StreamConfiguration &stream_cfg,
+						 GstVideoInfo *info)
+{
+	GstVideoFormat gst_format = pixel_format_to_gst_format(stream_cfg.pixelFormat);
+
+	if (gst_format == GST_VIDEO_FORMAT_UNKNOWN ||
+	    gst_format == GST_VIDEO_FORMAT_ENCODED)
+		return FALSE;
+
+	if (!gst_video_info_set_format(info, gst_format, stream_cfg.size.width,
+				       stream_cfg.size.height))
+		return FALSE;
+
+	if (!stream_cfg.stride)
+		return TRUE;
+
+	/*
+	 * libcamera only reports the stride of the first plane. Derive the
+	 * stride of the other planes from the horizontal subsampling and pixel
+	 * stride of their first component, and lay the planes out
+	 * contiguously.
+	 */
+	const GstVideoFormatInfo *finfo = info->finfo;
+	gint pstride0 = GST_VIDEO_FORMAT_INFO_PSTRIDE(finfo, 0);
+	gsize offset = 0;
+
+	for (guint plane = 0; plane < GST_VIDEO_INFO_N_PLANES(info); plane++) {
+		guint comp;
+
+		for (comp = 0; comp < GST_VIDEO_INFO_N_COMPONENTS(info); comp++) {
+			if (GST_VIDEO_FORMAT_INFO_PLANE(finfo, comp) == plane)
+				break;
+		}
+
+		gint stride = GST_VIDEO_FORMAT_INFO_SCALE_WIDTH(finfo, comp, stream_cfg.stride);
+		if (pstride0)
+			stride = stride * GST_VIDEO_FORMAT_INFO_PSTRIDE(finfo, comp) / pstride0;
+
+		gint height = GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT(finfo, comp,
+								 stream_cfg.size.height);
+
+		info->stride[plane] = stride;
+		info->offset[plane] = offset;
+		offset += static_cast<gsize>(stride) * height;
+	}
+
+	info->size = offset;
+
+	return TRUE;
+}
+
+gboolean
 gst_libcamera_configure_stream_from_caps(StreamConfiguration &stream_cfg,
 					 GstCaps *caps)
 {
@@ -196,21 +345,37 @@ gst_libcamera_configure_stream_from_caps(StreamConfiguration &stream_cfg,
 	}
 
 	/* Prefer reliable fixed value over ranges */
-	if (best_fixed >= 0)
-		s = gst_caps_get_structure(caps, best_fixed);
-	else
-		s = gst_caps_get_structure(caps, best_in_range);
+	guint index = best_fixed >= 0 ? best_fixed : best_in_range;
+	s = gst_caps_get_structure(caps, index);
+
+	GstCapsFeatures *features = gst_caps_get_features(caps, index);
+	gboolean dmabuf = features &&
+			  gst_caps_features_contains(features, GST_CAPS_FEATURE_MEMORY_DMABUF);
 
 	if (gst_structure_has_name(s, "video/x-raw")) {
 		const gchar *format = gst_video_format_to_string(gst_format);
 		gst_structure_fixate_field_string(s, "format", format);
+
+#if GST_CHECK_VERSION(1, 24, 0)
+		if (dmabuf) {
+			g_autofree gchar *drm_format =
+				gst_video_dma_drm_fourcc_to_string(stream_cfg.pixelFormat.fourcc(),
+								   stream_cfg.pixelFormat.modifier());
+			if (drm_format)
+				gst_structure_fixate_field_string(s, "drm-format", drm_format);
+		}
+#endif
 	}
 
 	/* Then configure the stream with the result. */
 	if (gst_structure_has_name(s, "video/x-raw")) {
-		const gchar *format = gst_structure_get_string(s, "format");
-		gst_format = gst_video_format_from_string(format);
-		stream_cfg.pixelFormat = gst_format_to_pixel_format(gst_format);
+		if (dmabuf) {
+			stream_cfg.pixelFormat = dmabuf_structure_to_pixel_format(s);
+		} else {
+			const gchar *format = gst_structure_get_string(s, "format");
+			gst_format = gst_video_format_from_string(format);
+			stream_cfg.pixelFormat = gst_format_to_pixel_format(gst_format);
+		}
 	} else if (gst_structure_has_name(s, "image/jpeg")) {
 		stream_cfg.pixelFormat = formats::MJPEG;
 	} else {
@@ -222,6 +387,122 @@ gst_libcamera_configure_stream_from_caps(StreamConfiguration &stream_cfg,
 	gst_structure_get_int(s, "height", &height);
 	stream_cfg.size.width = width;
 	stream_cfg.size.height = height;
+
+	return dmabuf;
+}
+
+static gboolean
+control_value_from_gvalue(const ControlId *id, const GValue *value,
+			  ControlValue &control_value)
+{
+	GValue val = G_VALUE_INIT;
+
+	switch (id->type()) {
+	case ControlTypeBool:
+		g_value_init(&val, G_TYPE_BOOLEAN);
+		if (!g_value_transform(value, &val))
+			return FALSE;
+		control_value.set<bool>(g_value_get_boolean(&val));
+		break;
+	case ControlTypeInteger32:
+		g_value_init(&val, G_TYPE_INT);
+		if (!g_value_transform(value, &val))
+			return FALSE;
+		control_value.set<int32_t>(g_value_get_int(&val));
+		break;
+	case ControlTypeInteger64:
+		g_value_init(&val, G_TYPE_INT64);
+		if (!g_value_transform(value, &val))
+			return FALSE;
+		control_value.set<int64_t>(g_value_get_int64(&val));
+		break;
+	case ControlTypeFloat:
+		g_value_init(&val, G_TYPE_FLOAT);
+		if (!g_value_transform(value, &val))
+			return FALSE;
+		control_value.set<float>(g_value_get_float(&val));
+		break;
+	default:
+		/* \todo Support array and compound controls. */
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+template<typename T>
+static gboolean
+control_value_in_range(const ControlInfo &info, const ControlValue &value)
+{
+	/* Controls without limits accept any value. */
+	if (info.min().type() != value.type() || info.max().type() != value.type())
+		return TRUE;
+
+	T val = value.get<T>();
+	return val >= info.min().get<T>() && val <= info.max().get<T>();
+}
+
+static gboolean
+control_value_validate(const ControlInfo &info, const ControlValue &value)
+{
+	switch (value.type()) {
+	case ControlTypeInteger32:
+		return control_value_in_range<int32_t>(info, value);
+	case ControlTypeInteger64:
+		return control_value_in_range<int64_t>(info, value);
+	case ControlTypeFloat:
+		return control_value_in_range<float>(info, value);
+	default:
+		return TRUE;
+	}
+}
+
+gboolean
+gst_libcamera_controls_from_structure(const GstStructure *structure,
+				      const ControlInfoMap &info,
+				      ControlList &controls)
+{
+	gboolean ret = TRUE;
+
+	for (gint i = 0; i < gst_structure_n_fields(structure); i++) {
+		const gchar *name = gst_structure_nth_field_name(structure, i);
+		const ControlId *id = nullptr;
+		const ControlInfo *ctrl_info = nullptr;
+
+		for (const auto &ctrl : info) {
+			if (ctrl.first->name() == name) {
+				id = ctrl.first;
+				ctrl_info = &ctrl.second;
+				break;
+			}
+		}
+
+		if (!id) {
+			GST_WARNING("Control %s isn't supported by the camera", name);
+			ret = FALSE;
+			continue;
+		}
+
+		ControlValue value;
+		if (!control_value_from_gvalue(id, gst_structure_get_value(structure, name),
+					       value)) {
+			GST_WARNING("Invalid value for control %s", name);
+			ret = FALSE;
+			continue;
+		}
+
+		if (!control_value_validate(*ctrl_info, value)) {
+			GST_WARNING("Value %s for control %s out of range %s",
+				    value.toString().c_str(), name,
+				    ctrl_info->toString().c_str());
+			ret = FALSE;
+			continue;
+		}
+
+		controls.set(id->id(), value);
+	}
+
+	return ret;
 }
 
 void
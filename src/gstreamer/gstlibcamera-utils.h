@@ -9,15 +9,22 @@
 #pragma once
 
 #include <libcamera/camera_manager.h>
+#include <libcamera/controls.h>
 #include <libcamera/stream.h>
 
 #include <gst/gst.h>
 #include <gst/video/video.h>
 
 GstCaps *gst_libcamera_stream_formats_to_caps(const libcamera::StreamFormats &formats);
-GstCaps *gst_libcamera_stream_configuration_to_caps(const libcamera::StreamConfiguration &stream_cfg);
-void gst_libcamera_configure_stream_from_caps(libcamera::StreamConfiguration &stream_cfg,
-					      GstCaps *caps);
+GstCaps *gst_libcamera_stream_configuration_to_caps(const libcamera::StreamConfiguration &stream_cfg,
+						    gboolean dmabuf);
+gboolean gst_libcamera_stream_configuration_to_video_info(const libcamera::StreamConfiguration &stream_cfg,
+							  GstVideoInfo *info);
+gboolean gst_libcamera_configure_stream_from_caps(libcamera::StreamConfiguration &stream_cfg,
+						  GstCaps *caps);
+gboolean gst_libcamera_controls_from_structure(const GstStructure *structure,
+					       const libcamera::ControlInfoMap &info,
+					       libcamera::ControlList &controls);
 void gst_libcamera_resume_task(GstTask *task);
 std::shared_ptr<libcamera::CameraManager> gst_libcamera_get_camera_manager(int &ret);
 
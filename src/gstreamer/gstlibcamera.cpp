@@ -6,12 +6,15 @@
  * gstlibcamera.c - GStreamer plugin
  */
 
+#include "gstlibcamerameta.h"
 #include "gstlibcameraprovider.h"
 #include "gstlibcamerasrc.h"
 
 static gboolean
 plugin_init(GstPlugin *plugin)
 {
+	gst_libcamera_meta_register();
+
 	if (!gst_element_register(plugin, "libcamerasrc", GST_RANK_PRIMARY,
 				  GST_TYPE_LIBCAMERA_SRC) ||
 	    !gst_device_provider_register(plugin, "libcameraprovider",
@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * gstlibcamerameta.cpp - GStreamer libcamera Request Metadata
+ */
+
+#include "gstlibcamerameta.h"
+
+#include <libcamera/control_ids.h>
+
+using namespace libcamera;
+
+void
+gst_libcamera_meta_register()
+{
+#if GST_CHECK_VERSION(1, 20, 0)
+	static const gchar *tags[] = { nullptr };
+
+	gst_meta_register_custom(GST_LIBCAMERA_META_NAME, tags,
+				 nullptr, nullptr, nullptr);
+#endif
+}
+
+void
+gst_libcamera_buffer_set_metadata([[maybe_unused]] GstBuffer *buffer,
+				  [[maybe_unused]] const FrameMetadata &frame_metadata,
+				  [[maybe_unused]] const ControlList &metadata)
+{
+#if GST_CHECK_VERSION(1, 20, 0)
+	GstCustomMeta *meta = gst_buffer_get_custom_meta(buffer, GST_LIBCAMERA_META_NAME);
+	if (!meta) {
+		meta = gst_buffer_add_custom_meta(buffer, GST_LIBCAMERA_META_NAME);
+		if (!meta)
+			return;
+
+		/*
+		 * Keep the meta attached when the buffer is returned to the
+		 * pool, to update it in place for the next frames instead of
+		 * allocating a new one.
+		 */
+		GST_META_FLAG_SET(meta, GST_META_FLAG_POOLED);
+	}
+
+	GstStructure *s = gst_custom_meta_get_structure(meta);
+
+	guint64 timestamp = metadata.contains(controls::SensorTimestamp.id())
+				    ? metadata.get(controls::SensorTimestamp)
+				    : frame_metadata.timestamp;
+
+	gst_structure_set(s,
+			  "sequence", G_TYPE_UINT, frame_metadata.sequence,
+			  "sensor-timestamp", G_TYPE_UINT64, timestamp,
+			  nullptr);
+
+	if (metadata.contains(controls::ExposureTime.id()))
+		gst_structure_set(s, "exposure-time", G_TYPE_INT,
+				  metadata.get(controls::ExposureTime), nullptr);
+	else
+		gst_structure_remove_field(s, "exposure-time");
+
+	if (metadata.contains(controls::AnalogueGain.id()))
+		gst_structure_set(s, "analogue-gain", G_TYPE_FLOAT,
+				  metadata.get(controls::AnalogueGain), nullptr);
+	else
+		gst_structure_remove_field(s, "analogue-gain");
+#endif
+}
@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * gstlibcamerameta.h - GStreamer libcamera Request Metadata
+ *
+ * The request metadata is attached to the output buffers as a GstCustomMeta
+ * named "GstLibcameraMeta", whose structure can be retrieved by applications
+ * with gst_buffer_get_custom_meta() and gst_custom_meta_get_structure(). The
+ * structure contains the following fields, when reported by the camera:
+ *
+ * - sequence (guint): The frame sequence number
+ * - sensor-timestamp (guint64): The time the first row of the frame was
+ *   exposed, in nanoseconds
+ * - exposure-time (gint): The exposure time, in microseconds
+ * - analogue-gain (gfloat): The analogue gain applied to the sensor
+ */
+
+#pragma once
+
+#include <libcamera/controls.h>
+#include <libcamera/framebuffer.h>
+
+#include <gst/gst.h>
+
+#define GST_LIBCAMERA_META_NAME "GstLibcameraMeta"
+
+void gst_libcamera_meta_register();
+
+void gst_libcamera_buffer_set_metadata(GstBuffer *buffer,
+				       const libcamera::FrameMetadata &frame_metadata,
+				       const libcamera::ControlList &metadata);
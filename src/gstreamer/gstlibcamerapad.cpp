@@ -8,6 +8,8 @@
 
 #include "gstlibcamerapad.h"
 
+#include <algorithm>
+
 #include <libcamera/stream.h>
 
 #include "gstlibcamera-utils.h"
@@ -20,8 +22,18 @@ struct _GstLibcameraPad {
 	GstLibcameraPool *pool;
 	GQueue pending_buffers;
 	GstClockTime latency;
+	GstClockTime max_latency;
+	GstClockTime last_timestamp;
+	GstClockTime window_latency;
+	guint window_frames;
 };
 
+/*
+ * Number of frames over which the worst capture latency is measured before
+ * updating the latency reported to downstream.
+ */
+static constexpr guint kLatencyWindow = 30;
+
 enum {
 	PROP_0,
 	PROP_STREAM_ROLE
@@ -71,9 +83,14 @@ gst_libcamera_pad_query(GstPad *pad, GstObject *parent, GstQuery *query)
 	if (query->type != GST_QUERY_LATENCY)
 		return gst_pad_query_default(pad, parent, query);
 
-	/* TRUE here means live, we assumes that max latency is the same as min
-	 * as we have no idea that duration of frames. */
-	gst_query_set_latency(query, TRUE, self->latency, self->latency);
+	/*
+	 * TRUE here means live. The min latency is the worst capture latency
+	 * measured from the sensor timestamps over the last measurement
+	 * window, and the max latency accounts for the frames that can be held
+	 * in the requests in flight.
+	 */
+	GLibLocker lock(GST_OBJECT(self));
+	gst_query_set_latency(query, TRUE, self->latency, self->max_latency);
 	return TRUE;
 }
 
@@ -81,6 +98,7 @@ static void
 gst_libcamera_pad_init(GstLibcameraPad *self)
 {
 	GST_PAD_QUERYFUNC(self) = gst_libcamera_pad_query;
+	self->last_timestamp = GST_CLOCK_TIME_NONE;
 }
 
 static GType
@@ -142,6 +160,14 @@ gst_libcamera_pad_set_pool(GstPad *pad, GstLibcameraPool *pool)
 	if (self->pool)
 		g_object_unref(self->pool);
 	self->pool = pool;
+
+	/* Restart latency measurements for the new capture session. */
+	GLibLocker lock(GST_OBJECT(self));
+	self->latency = 0;
+	self->max_latency = 0;
+	self->last_timestamp = GST_CLOCK_TIME_NONE;
+	self->window_latency = 0;
+	self->window_frames = 0;
 }
 
 Stream *
@@ -189,10 +215,53 @@ gst_libcamera_pad_has_pending(GstPad *pad)
 	return self->pending_buffers.length > 0;
 }
 
-void
-gst_libcamera_pad_set_latency(GstPad *pad, GstClockTime latency)
+/*
+ * Record the capture latency of a buffer, measured from its sensor timestamp,
+ * given the number of requests that can be in flight. The latency reported to
+ * downstream is recomputed from the worst latency of each window of
+ * kLatencyWindow frames and the current frame duration and number of requests,
+ * and can thus decrease as well as increase. Return true if it has changed by
+ * more than a millisecond.
+ */
+bool
+gst_libcamera_pad_update_latency(GstPad *pad, GstClockTime latency,
+				 GstClockTime timestamp, guint depth)
 {
 	auto *self = GST_LIBCAMERA_PAD(pad);
 	GLibLocker lock(GST_OBJECT(self));
-	self->latency = latency;
+
+	GstClockTime duration = 0;
+	if (GST_CLOCK_TIME_IS_VALID(self->last_timestamp) &&
+	    timestamp > self->last_timestamp)
+		duration = timestamp - self->last_timestamp;
+	self->last_timestamp = timestamp;
+
+	self->window_latency = std::max(self->window_latency, latency);
+	self->window_frames++;
+
+	/*
+	 * Report the first measurement as soon as the frame duration is known,
+	 * and update it at the end of each window.
+	 */
+	if (!duration || (self->latency && self->window_frames < kLatencyWindow))
+		return false;
+
+	GstClockTime min_latency = self->window_latency;
+	GstClockTime max_latency = min_latency + (depth > 1 ? (depth - 1) * duration : 0);
+
+	self->window_latency = 0;
+	self->window_frames = 0;
+
+	auto changed = [](GstClockTime a, GstClockTime b) {
+		return (a > b ? a - b : b - a) > GST_MSECOND;
+	};
+
+	if (self->latency && !changed(min_latency, self->latency) &&
+	    !changed(max_latency, self->max_latency))
+		return false;
+
+	self->latency = min_latency;
+	self->max_latency = max_latency;
+
+	return true;
 }
@@ -31,4 +31,5 @@ GstFlowReturn gst_libcamera_pad_push_pending(GstPad *pad);
 
 bool gst_libcamera_pad_has_pending(GstPad *pad);
 
-void gst_libcamera_pad_set_latency(GstPad *pad, GstClockTime latency);
+bool gst_libcamera_pad_update_latency(GstPad *pad, GstClockTime latency,
+				      GstClockTime timestamp, guint depth);
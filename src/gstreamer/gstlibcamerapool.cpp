@@ -10,6 +10,8 @@
 
 #include <libcamera/stream.h>
 
+#include <gst/video/gstvideometa.h>
+
 #include "gstlibcamera-utils.h"
 
 using namespace libcamera;
@@ -27,10 +29,53 @@ struct _GstLibcameraPool {
 	GstAtomicQueue *queue;
 	GstLibcameraAllocator *allocator;
 	Stream *stream;
+
+	/* Layout of the frames, only valid for raw video formats. */
+	GstVideoInfo info;
+	gboolean has_info;
 };
 
 G_DEFINE_TYPE(GstLibcameraPool, gst_libcamera_pool, GST_TYPE_BUFFER_POOL)
 
+static void
+gst_libcamera_pool_add_video_meta(GstLibcameraPool *self, GstBuffer *buffer)
+{
+	const GstVideoInfo *info = &self->info;
+	gsize offset[GST_VIDEO_MAX_PLANES];
+	guint n_planes = GST_VIDEO_INFO_N_PLANES(info);
+
+	/*
+	 * When each plane is stored in a separate memory, the plane offsets
+	 * are given by the position of the memories in the buffer. Otherwise
+	 * the planes are contiguous in a single memory.
+	 */
+	if (gst_buffer_n_memory(buffer) == n_planes) {
+		gsize position = 0;
+
+		for (guint i = 0; i < n_planes; i++) {
+			offset[i] = position;
+			position += gst_buffer_peek_memory(buffer, i)->size;
+		}
+	} else {
+		for (guint i = 0; i < n_planes; i++)
+			offset[i] = GST_VIDEO_INFO_PLANE_OFFSET(info, i);
+	}
+
+	GstVideoMeta *meta =
+		gst_buffer_add_video_meta_full(buffer, GST_VIDEO_FRAME_FLAG_NONE,
+					       GST_VIDEO_INFO_FORMAT(info),
+					       GST_VIDEO_INFO_WIDTH(info),
+					       GST_VIDEO_INFO_HEIGHT(info),
+					       n_planes, offset,
+					       const_cast<gint *>(info->stride));
+
+	/*
+	 * The frame layout doesn't change for the lifetime of the pool, keep
+	 * the meta attached when the buffer is recycled.
+	 */
+	GST_META_FLAG_SET(meta, GST_META_FLAG_POOLED);
+}
+
 static GstFlowReturn
 gst_libcamera_pool_acquire_buffer(GstBufferPool *pool, GstBuffer **buffer,
 				  [[maybe_unused]] GstBufferPoolAcquireParams *params)
@@ -45,6 +90,9 @@ gst_libcamera_pool_acquire_buffer(GstBufferPool *pool, GstBuffer **buffer,
 		return GST_FLOW_ERROR;
 	}
 
+	if (self->has_info && !gst_buffer_get_video_meta(buf))
+		gst_libcamera_pool_add_video_meta(self, buf);
+
 	*buffer = buf;
 	return GST_FLOW_OK;
 }
@@ -118,6 +166,9 @@ gst_libcamera_pool_new(GstLibcameraAllocator *allocator, Stream *stream)
 
 	pool->allocator = GST_LIBCAMERA_ALLOCATOR(g_object_ref(allocator));
 	pool->stream = stream;
+	pool->has_info =
+		gst_libcamera_stream_configuration_to_video_info(stream->configuration(),
+								 &pool->info);
 
 	gsize pool_size = gst_libcamera_allocator_get_pool_size(allocator, stream);
 	for (gsize i = 0; i < pool_size; i++) {
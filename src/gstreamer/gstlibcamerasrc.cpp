@@ -24,20 +24,23 @@
  *  - Add colorimetry support
  *  - Add timestamp support
  *  - Use unique names to select the camera devices
- *  - Add GstVideoMeta support (strides and offsets)
  */
 
 #include "gstlibcamerasrc.h"
 
-#include <queue>
+#include <algorithm>
+#include <errno.h>
 #include <vector>
 
 #include <libcamera/camera.h>
 #include <libcamera/camera_manager.h>
+#include <libcamera/control_ids.h>
 
+#include <gst/allocators/allocators.h>
 #include <gst/base/base.h>
 
 #include "gstlibcameraallocator.h"
+#include "gstlibcamerameta.h"
 #include "gstlibcamerapad.h"
 #include "gstlibcamerapool.h"
 #include "gstlibcamera-utils.h"
@@ -48,58 +51,57 @@ GST_DEBUG_CATEGORY_STATIC(source_debug);
 #define GST_CAT_DEFAULT source_debug
 
 struct RequestWrap {
-	RequestWrap(std::unique_ptr<Request> request);
+	RequestWrap(std::unique_ptr<Request> request, gsize streams);
 	~RequestWrap();
 
-	void attachBuffer(GstBuffer *buffer);
-	GstBuffer *detachBuffer(Stream *stream);
+	void attachBuffer(gsize index, GstBuffer *buffer);
+	GstBuffer *detachBuffer(gsize index);
+	void releaseBuffers();
 
 	std::unique_ptr<Request> request_;
-	std::map<Stream *, GstBuffer *> buffers_;
+	/* Buffers indexed by stream, in the order of the source pads. */
+	std::vector<GstBuffer *> buffers_;
 };
 
-RequestWrap::RequestWrap(std::unique_ptr<Request> request)
-	: request_(std::move(request))
+RequestWrap::RequestWrap(std::unique_ptr<Request> request, gsize streams)
+	: request_(std::move(request)), buffers_(streams, nullptr)
 {
 }
 
 RequestWrap::~RequestWrap()
 {
-	for (std::pair<Stream *const, GstBuffer *> &item : buffers_) {
-		if (item.second)
-			gst_buffer_unref(item.second);
-	}
+	releaseBuffers();
 }
 
-void RequestWrap::attachBuffer(GstBuffer *buffer)
+void RequestWrap::attachBuffer(gsize index, GstBuffer *buffer)
 {
 	FrameBuffer *fb = gst_libcamera_buffer_get_frame_buffer(buffer);
 	Stream *stream = gst_libcamera_buffer_get_stream(buffer);
 
 	request_->addBuffer(stream, fb);
 
-	auto item = buffers_.find(stream);
-	if (item != buffers_.end()) {
-		gst_buffer_unref(item->second);
-		item->second = buffer;
-	} else {
-		buffers_[stream] = buffer;
-	}
+	if (buffers_[index])
+		gst_buffer_unref(buffers_[index]);
+	buffers_[index] = buffer;
 }
 
-GstBuffer *RequestWrap::detachBuffer(Stream *stream)
+GstBuffer *RequestWrap::detachBuffer(gsize index)
 {
-	GstBuffer *buffer = nullptr;
-
-	auto item = buffers_.find(stream);
-	if (item != buffers_.end()) {
-		buffer = item->second;
-		item->second = nullptr;
-	}
+	GstBuffer *buffer = buffers_[index];
+	buffers_[index] = nullptr;
 
 	return buffer;
 }
 
+void RequestWrap::releaseBuffers()
+{
+	for (GstBuffer *&buffer : buffers_) {
+		if (buffer)
+			gst_buffer_unref(buffer);
+		buffer = nullptr;
+	}
+}
+
 /* Used for C++ object with destructors. */
 struct GstLibcameraSrcState {
 	GstLibcameraSrc *src_;
@@ -108,10 +110,29 @@ struct GstLibcameraSrcState {
 	std::shared_ptr<Camera> cam_;
 	std::unique_ptr<CameraConfiguration> config_;
 	std::vector<GstPad *> srcpads_;
-	std::queue<std::unique_ptr<RequestWrap>> requests_;
 	guint group_id_;
 
+	/*
+	 * The requests are allocated once when streaming starts and reused for
+	 * the whole session. Completed requests are handed over from the
+	 * libcamera thread to the streaming thread through a lock-free queue,
+	 * and the free requests are only accessed by the streaming thread.
+	 */
+	std::vector<std::unique_ptr<RequestWrap>> requests_;
+	std::vector<RequestWrap *> freeRequests_;
+	GstAtomicQueue *completedRequests_;
+
+	/*
+	 * Controls received through upstream events, applied to the next
+	 * queued request. Protected by the object lock.
+	 */
+	ControlList pendingControls_{ controls::controls };
+
+	int allocateRequests(guint count);
+	void freeRequests();
 	void requestCompleted(Request *request);
+	void processRequest(RequestWrap *wrap);
+	bool setControls(const GstStructure *structure);
 };
 
 struct _GstLibcameraSrc {
@@ -121,6 +142,8 @@ struct _GstLibcameraSrc {
 	GstTask *task;
 
 	gchar *camera_name;
+	guint buffer_count;
+	gboolean low_latency;
 
 	GstLibcameraSrcState *state;
 	GstLibcameraAllocator *allocator;
@@ -129,14 +152,22 @@ struct _GstLibcameraSrc {
 
 enum {
 	PROP_0,
-	PROP_CAMERA_NAME
+	PROP_CAMERA_NAME,
+	PROP_BUFFER_COUNT,
+	PROP_LOW_LATENCY,
 };
 
 G_DEFINE_TYPE_WITH_CODE(GstLibcameraSrc, gst_libcamera_src, GST_TYPE_ELEMENT,
 			GST_DEBUG_CATEGORY_INIT(source_debug, "libcamerasrc", 0,
 						"libcamera Source"))
 
-#define TEMPLATE_CAPS GST_STATIC_CAPS("video/x-raw; image/jpeg")
+/*
+ * Raw formats are produced in system memory, or in DMABuf memory when the
+ * downstream element supports it.
+ */
+#define TEMPLATE_CAPS GST_STATIC_CAPS("video/x-raw; " \
+				      "video/x-raw(" GST_CAPS_FEATURE_MEMORY_DMABUF "); " \
+				      "image/jpeg")
 
 /* For the simple case, we have a src pad that is always present. */
 GstStaticPadTemplate src_template = {
@@ -148,27 +179,70 @@ GstStaticPadTemplate request_src_template = {
 	"src_%u", GST_PAD_SRC, GST_PAD_REQUEST, TEMPLATE_CAPS
 };
 
+int
+GstLibcameraSrcState::allocateRequests(guint count)
+{
+	for (guint i = 0; i < count; i++) {
+		/* The cookie stores the index of the request wrapper. */
+		std::unique_ptr<Request> request = cam_->createRequest(requests_.size());
+		if (!request)
+			return -ENOMEM;
+
+		requests_.push_back(std::make_unique<RequestWrap>(std::move(request),
+								  srcpads_.size()));
+		freeRequests_.push_back(requests_.back().get());
+	}
+
+	return 0;
+}
+
 void
-GstLibcameraSrcState::requestCompleted(Request *request)
+GstLibcameraSrcState::freeRequests()
 {
-	GLibLocker lock(GST_OBJECT(src_));
+	/* Drop the requests cancelled when stopping the camera. */
+	while (gst_atomic_queue_pop(completedRequests_))
+		;
 
-	GST_DEBUG_OBJECT(src_, "buffers are ready");
+	freeRequests_.clear();
+	requests_.clear();
+}
 
-	std::unique_ptr<RequestWrap> wrap = std::move(requests_.front());
-	requests_.pop();
+void
+GstLibcameraSrcState::requestCompleted(Request *request)
+{
+	GST_DEBUG_OBJECT(src_, "buffers are ready");
 
+	RequestWrap *wrap = requests_[request->cookie()].get();
 	g_return_if_fail(wrap->request_.get() == request);
 
+	gst_atomic_queue_push(completedRequests_, wrap);
+
+	/*
+	 * Resume the task with the object lock held, in lock step with the
+	 * streaming thread which decides to pause under the same lock.
+	 */
+	GLibLocker lock(GST_OBJECT(src_));
+	gst_libcamera_resume_task(this->src_->task);
+}
+
+void
+GstLibcameraSrcState::processRequest(RequestWrap *wrap)
+{
+	Request *request = wrap->request_.get();
+
 	if ((request->status() == Request::RequestCancelled)) {
 		GST_DEBUG_OBJECT(src_, "Request was cancelled");
+		wrap->releaseBuffers();
+		request->reuse();
+		freeRequests_.push_back(wrap);
 		return;
 	}
 
 	GstBuffer *buffer;
-	for (GstPad *srcpad : srcpads_) {
-		Stream *stream = gst_libcamera_pad_get_stream(srcpad);
-		buffer = wrap->detachBuffer(stream);
+	bool latency_changed = false;
+	for (gsize i = 0; i < srcpads_.size(); i++) {
+		GstPad *srcpad = srcpads_[i];
+		buffer = wrap->detachBuffer(i);
 
 		FrameBuffer *fb = gst_libcamera_buffer_get_frame_buffer(buffer);
 
@@ -181,7 +255,12 @@ GstLibcameraSrcState::requestCompleted(Request *request)
 			/* Deduced from: sys_now - sys_base_time == gst_now - gst_base_time */
 			GstClockTime sys_base_time = sys_now - (gst_now - gst_base_time);
 			GST_BUFFER_PTS(buffer) = fb->metadata().timestamp - sys_base_time;
-			gst_libcamera_pad_set_latency(srcpad, sys_now - fb->metadata().timestamp);
+
+			if (gst_libcamera_pad_update_latency(srcpad,
+							     sys_now - fb->metadata().timestamp,
+							     fb->metadata().timestamp,
+							     requests_.size()))
+				latency_changed = true;
 		} else {
 			GST_BUFFER_PTS(buffer) = 0;
 		}
@@ -189,10 +268,31 @@ GstLibcameraSrcState::requestCompleted(Request *request)
 		GST_BUFFER_OFFSET(buffer) = fb->metadata().sequence;
 		GST_BUFFER_OFFSET_END(buffer) = fb->metadata().sequence;
 
+		gst_libcamera_buffer_set_metadata(buffer, fb->metadata(),
+						  request->metadata());
+
 		gst_libcamera_pad_queue_buffer(srcpad, buffer);
 	}
 
-	gst_libcamera_resume_task(this->src_->task);
+	/* Let the pipeline query the updated latency. */
+	if (latency_changed)
+		gst_element_post_message(GST_ELEMENT(src_),
+					 gst_message_new_latency(GST_OBJECT(src_)));
+
+	request->reuse();
+	freeRequests_.push_back(wrap);
+}
+
+bool
+GstLibcameraSrcState::setControls(const GstStructure *structure)
+{
+	GLibLocker lock(GST_OBJECT(src_));
+
+	if (!cam_)
+		return false;
+
+	return gst_libcamera_controls_from_structure(structure, cam_->controls(),
+						     pendingControls_);
 }
 
 static bool
@@ -262,45 +362,54 @@ gst_libcamera_src_task_run(gpointer user_data)
 	GstLibcameraSrc *self = GST_LIBCAMERA_SRC(user_data);
 	GstLibcameraSrcState *state = self->state;
 
-	std::unique_ptr<Request> request = state->cam_->createRequest();
-	if (!request) {
-		GST_ELEMENT_ERROR(self, RESOURCE, NO_SPACE_LEFT,
-				  ("Failed to allocate request for camera '%s'.",
-				   state->cam_->id().c_str()),
-				  ("libcamera::Camera::createRequest() failed"));
-		gst_task_stop(self->task);
-		return;
-	}
-
-	std::unique_ptr<RequestWrap> wrap =
-		std::make_unique<RequestWrap>(std::move(request));
-
-	for (GstPad *srcpad : state->srcpads_) {
-		GstLibcameraPool *pool = gst_libcamera_pad_get_pool(srcpad);
-		GstBuffer *buffer;
-		GstFlowReturn ret;
+	/* Hand the buffers of the completed requests over to the pads. */
+	RequestWrap *wrap;
+	while ((wrap = static_cast<RequestWrap *>(gst_atomic_queue_pop(state->completedRequests_))))
+		state->processRequest(wrap);
+
+	if (!state->freeRequests_.empty()) {
+		wrap = state->freeRequests_.back();
+		state->freeRequests_.pop_back();
+
+		bool ready = true;
+
+		for (gsize i = 0; i < state->srcpads_.size(); i++) {
+			GstLibcameraPool *pool = gst_libcamera_pad_get_pool(state->srcpads_[i]);
+			GstBuffer *buffer;
+			GstFlowReturn ret;
+
+			ret = gst_buffer_pool_acquire_buffer(GST_BUFFER_POOL(pool),
+							     &buffer, nullptr);
+			if (ret != GST_FLOW_OK) {
+				/*
+				 * We won't be queueing this request due to
+				 * lack of buffers, return it to the free list.
+				 */
+				ready = false;
+				break;
+			}
 
-		ret = gst_buffer_pool_acquire_buffer(GST_BUFFER_POOL(pool),
-						     &buffer, nullptr);
-		if (ret != GST_FLOW_OK) {
-			/*
-			 * RequestWrap has ownership of the request, and we
-			 * won't be queueing this one due to lack of buffers.
-			 */
-			wrap.release();
-			break;
+			wrap->attachBuffer(i, buffer);
 		}
 
-		wrap->attachBuffer(buffer);
-	}
+		if (ready) {
+			{
+				GLibLocker lock(GST_OBJECT(self));
+				if (!state->pendingControls_.empty()) {
+					wrap->request_->controls().merge(state->pendingControls_);
+					state->pendingControls_.clear();
+				}
+			}
 
-	if (wrap) {
-		GLibLocker lock(GST_OBJECT(self));
-		GST_TRACE_OBJECT(self, "Requesting buffers");
-		state->cam_->queueRequest(wrap->request_.get());
-		state->requests_.push(std::move(wrap));
+			GST_TRACE_OBJECT(self, "Requesting buffers");
+			state->cam_->queueRequest(wrap->request_.get());
 
-		/* The RequestWrap will be deleted in the completion handler. */
+			/* The request will be recycled once it completes. */
+		} else {
+			wrap->releaseBuffers();
+			wrap->request_->reuse();
+			state->freeRequests_.push_back(wrap);
+		}
 	}
 
 	GstFlowReturn ret = GST_FLOW_OK;
@@ -332,7 +441,7 @@ gst_libcamera_src_task_run(gpointer user_data)
 		 * to resume the task and might push pending buffers.
 		 */
 		GLibLocker lock(GST_OBJECT(self));
-		bool do_pause = true;
+		bool do_pause = gst_atomic_queue_length(state->completedRequests_) == 0;
 		for (GstPad *srcpad : state->srcpads_) {
 			if (gst_libcamera_pad_has_pending(srcpad)) {
 				do_pause = false;
@@ -345,6 +454,32 @@ gst_libcamera_src_task_run(gpointer user_data)
 	}
 }
 
+static gboolean
+gst_libcamera_src_src_event(GstPad *pad, GstObject *parent, GstEvent *event)
+{
+	GstLibcameraSrc *self = GST_LIBCAMERA_SRC(parent);
+	const GstStructure *structure = gst_event_get_structure(event);
+
+	if (GST_EVENT_TYPE(event) != GST_EVENT_CUSTOM_UPSTREAM ||
+	    !gst_structure_has_name(structure, "libcamera-controls"))
+		return gst_pad_event_default(pad, parent, event);
+
+	GST_DEBUG_OBJECT(self, "Received controls %" GST_PTR_FORMAT, structure);
+
+	gboolean ret = self->state->setControls(structure);
+	gst_event_unref(event);
+
+	return ret;
+}
+
+static gboolean
+gst_libcamera_src_filter_sysmem(GstCapsFeatures *features,
+				[[maybe_unused]] GstStructure *structure,
+				[[maybe_unused]] gpointer user_data)
+{
+	return !gst_caps_features_contains(features, GST_CAPS_FEATURE_MEMORY_DMABUF);
+}
+
 static void
 gst_libcamera_src_task_enter(GstTask *task, [[maybe_unused]] GThread *thread,
 			     gpointer user_data)
@@ -357,6 +492,14 @@ gst_libcamera_src_task_enter(GstTask *task, [[maybe_unused]] GThread *thread,
 
 	GST_DEBUG_OBJECT(self, "Streaming thread has started");
 
+	guint buffer_count;
+	gboolean low_latency;
+	{
+		GLibLocker lock(GST_OBJECT(self));
+		buffer_count = self->buffer_count;
+		low_latency = self->low_latency;
+	}
+
 	gint stream_id_num = 0;
 	StreamRoles roles;
 	for (GstPad *srcpad : state->srcpads_) {
@@ -382,12 +525,27 @@ gst_libcamera_src_task_enter(GstTask *task, [[maybe_unused]] GThread *thread,
 	}
 	g_assert(state->config_->size() == state->srcpads_.size());
 
+	/* Whether DMABuf memory has been negotiated, indexed by pad. */
+	std::vector<gboolean> dmabuf(state->srcpads_.size(), FALSE);
+
 	for (gsize i = 0; i < state->srcpads_.size(); i++) {
 		GstPad *srcpad = state->srcpads_[i];
 		StreamConfiguration &stream_cfg = state->config_->at(i);
 
 		/* Retrieve the supported caps. */
 		g_autoptr(GstCaps) filter = gst_libcamera_stream_formats_to_caps(stream_cfg.formats());
+
+		/*
+		 * Only negotiate DMABuf memory with peers that explicitly
+		 * support it. Elements accepting any caps, such as fakesink or
+		 * appsink, would otherwise receive DMA_DRM buffers they can't
+		 * interpret.
+		 */
+		g_autoptr(GstCaps) peer_caps = gst_pad_peer_query_caps(srcpad, nullptr);
+		if (gst_caps_is_any(peer_caps))
+			gst_caps_filter_and_map_in_place(filter, gst_libcamera_src_filter_sysmem,
+							 nullptr);
+
 		g_autoptr(GstCaps) caps = gst_pad_peer_query_caps(srcpad, filter);
 		if (gst_caps_is_empty(caps)) {
 			flow_ret = GST_FLOW_NOT_NEGOTIATED;
@@ -396,7 +554,11 @@ gst_libcamera_src_task_enter(GstTask *task, [[maybe_unused]] GThread *thread,
 
 		/* Fixate caps and configure the stream. */
 		caps = gst_caps_make_writable(caps);
-		gst_libcamera_configure_stream_from_caps(stream_cfg, caps);
+		dmabuf[i] = gst_libcamera_configure_stream_from_caps(stream_cfg, caps);
+
+		/* Override the default number of buffers if requested. */
+		if (buffer_count)
+			stream_cfg.bufferCount = buffer_count;
 	}
 
 	if (flow_ret != GST_FLOW_OK)
@@ -416,7 +578,9 @@ gst_libcamera_src_task_enter(GstTask *task, [[maybe_unused]] GThread *thread,
 		GstPad *srcpad = state->srcpads_[i];
 		const StreamConfiguration &stream_cfg = state->config_->at(i);
 
-		g_autoptr(GstCaps) caps = gst_libcamera_stream_configuration_to_caps(stream_cfg);
+		g_autoptr(GstCaps) caps = gst_libcamera_stream_configuration_to_caps(stream_cfg,
+										     dmabuf[i]);
+		GST_DEBUG_OBJECT(self, "Negotiated caps %" GST_PTR_FORMAT, caps);
 		if (!gst_pad_push_event(srcpad, gst_event_new_caps(caps))) {
 			flow_ret = GST_FLOW_NOT_NEGOTIATED;
 			break;
@@ -447,6 +611,7 @@ gst_libcamera_src_task_enter(GstTask *task, [[maybe_unused]] GThread *thread,
 	}
 
 	self->flow_combiner = gst_flow_combiner_new();
+	guint num_requests = G_MAXUINT;
 	for (gsize i = 0; i < state->srcpads_.size(); i++) {
 		GstPad *srcpad = state->srcpads_[i];
 		const StreamConfiguration &stream_cfg = state->config_->at(i);
@@ -457,6 +622,41 @@ gst_libcamera_src_task_enter(GstTask *task, [[maybe_unused]] GThread *thread,
 
 		gst_libcamera_pad_set_pool(srcpad, pool);
 		gst_flow_combiner_add_pad(self->flow_combiner, srcpad);
+
+		num_requests = std::min<guint>(num_requests,
+					       gst_libcamera_allocator_get_pool_size(self->allocator,
+										     stream_cfg.stream()));
+	}
+
+	/*
+	 * There can't be more requests in flight than buffers in the pools. In
+	 * low-latency mode, keep the minimum number of requests the camera
+	 * needs to fill its pipeline, plus one queued after them, so that each
+	 * frame is delivered as soon as possible instead of waiting behind the
+	 * other requests. Cameras that don't report their pipeline depth are
+	 * assumed to capture frames directly, with a single request in flight.
+	 */
+	if (low_latency) {
+		guint min_requests = 1;
+
+		const ControlInfoMap &info = state->cam_->controls();
+		auto depth = info.find(&controls::draft::PipelineDepth);
+		if (depth != info.end())
+			min_requests = std::max(depth->second.min().get<int32_t>(), 1);
+
+		num_requests = std::min(num_requests, min_requests + 1);
+	}
+
+	GST_DEBUG_OBJECT(self, "Using %u requests", num_requests);
+
+	ret = state->allocateRequests(num_requests);
+	if (ret) {
+		GST_ELEMENT_ERROR(self, RESOURCE, NO_SPACE_LEFT,
+				  ("Failed to allocate requests for camera '%s'.",
+				   state->cam_->id().c_str()),
+				  ("libcamera::Camera::createRequest() failed"));
+		gst_task_stop(task);
+		return;
 	}
 
 	ret = state->cam_->start();
@@ -490,6 +690,12 @@ gst_libcamera_src_task_leave([[maybe_unused]] GstTask *task,
 	GST_DEBUG_OBJECT(self, "Streaming thread is about to stop");
 
 	state->cam_->stop();
+	state->freeRequests();
+
+	{
+		GLibLocker lock(GST_OBJECT(self));
+		state->pendingControls_.clear();
+	}
 
 	for (GstPad *srcpad : state->srcpads_)
 		gst_libcamera_pad_set_pool(srcpad, nullptr);
@@ -516,7 +722,10 @@ gst_libcamera_src_close(GstLibcameraSrc *self)
 				    ("libcamera::Camera.release() failed: %s", g_strerror(-ret)));
 	}
 
-	state->cam_.reset();
+	{
+		GLibLocker lock(GST_OBJECT(self));
+		state->cam_.reset();
+	}
 	state->cm_.reset();
 }
 
@@ -532,6 +741,12 @@ gst_libcamera_src_set_property(GObject *object, guint prop_id,
 		g_free(self->camera_name);
 		self->camera_name = g_value_dup_string(value);
 		break;
+	case PROP_BUFFER_COUNT:
+		self->buffer_count = g_value_get_uint(value);
+		break;
+	case PROP_LOW_LATENCY:
+		self->low_latency = g_value_get_boolean(value);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 		break;
@@ -549,6 +764,12 @@ gst_libcamera_src_get_property(GObject *object, guint prop_id, GValue *value,
 	case PROP_CAMERA_NAME:
 		g_value_set_string(value, self->camera_name);
 		break;
+	case PROP_BUFFER_COUNT:
+		g_value_set_uint(value, self->buffer_count);
+		break;
+	case PROP_LOW_LATENCY:
+		g_value_set_boolean(value, self->low_latency);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
 		break;
@@ -613,6 +834,7 @@ gst_libcamera_src_finalize(GObject *object)
 	g_rec_mutex_clear(&self->stream_lock);
 	g_clear_object(&self->task);
 	g_free(self->camera_name);
+	gst_atomic_queue_unref(self->state->completedRequests_);
 	delete self->state;
 
 	return klass->finalize(object);
@@ -630,7 +852,10 @@ gst_libcamera_src_init(GstLibcameraSrc *self)
 	gst_task_set_leave_callback(self->task, gst_libcamera_src_task_leave, self, nullptr);
 	gst_task_set_lock(self->task, &self->stream_lock);
 
+	state->completedRequests_ = gst_atomic_queue_new(4);
+
 	state->srcpads_.push_back(gst_pad_new_from_template(templ, "src"));
+	gst_pad_set_event_function(state->srcpads_[0], gst_libcamera_src_src_event);
 	gst_element_add_pad(GST_ELEMENT(self), state->srcpads_[0]);
 
 	/* C-style friend. */
@@ -649,6 +874,7 @@ gst_libcamera_src_request_new_pad(GstElement *element, GstPadTemplate *templ,
 
 	pad = gst_pad_new_from_template(templ, name);
 	g_object_ref_sink(pad);
+	gst_pad_set_event_function(pad, gst_libcamera_src_src_event);
 
 	if (gst_element_add_pad(element, pad)) {
 		GLibLocker lock(GST_OBJECT(self));
@@ -717,4 +943,22 @@ gst_libcamera_src_class_init(GstLibcameraSrcClass *klass)
 							     | G_PARAM_READWRITE
 							     | G_PARAM_STATIC_STRINGS));
 	g_object_class_install_property(object_class, PROP_CAMERA_NAME, spec);
+
+	spec = g_param_spec_uint("buffer-count", "Buffer Count",
+				 "Number of buffers to allocate per stream, 0 selects the camera default",
+				 0, G_MAXUINT, 0,
+				 (GParamFlags)(GST_PARAM_MUTABLE_READY
+					       | G_PARAM_CONSTRUCT
+					       | G_PARAM_READWRITE
+					       | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(object_class, PROP_BUFFER_COUNT, spec);
+
+	spec = g_param_spec_boolean("low-latency", "Low Latency",
+				    "Limit the number of requests in flight to minimize latency",
+				    FALSE,
+				    (GParamFlags)(GST_PARAM_MUTABLE_READY
+						  | G_PARAM_CONSTRUCT
+						  | G_PARAM_READWRITE
+						  | G_PARAM_STATIC_STRINGS));
+	g_object_class_install_property(object_class, PROP_LOW_LATENCY, spec);
 }
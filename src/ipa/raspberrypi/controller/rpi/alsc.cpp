@@ -10,6 +10,7 @@
 
 #include <libcamera/base/log.h>
 #include <libcamera/base/span.h>
+#include <libcamera/base/thread.h>
 
 #include "../awb_status.h"
 #include "alsc.hpp"
@@ -372,6 +373,8 @@ void Alsc::Process(StatisticsPtr &stats, Metadata *image_metadata)
 
 void Alsc::asyncFunc()
 {
+	Thread::configureCurrent("RPi-ALSC");
+
 	while (true) {
 		{
 			std::unique_lock<std::mutex> lock(mutex_);
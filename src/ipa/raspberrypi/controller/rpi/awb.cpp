@@ -6,6 +6,7 @@
  */
 
 #include <libcamera/base/log.h>
+#include <libcamera/base/thread.h>
 
 #include "../lux_status.h"
 
@@ -335,6 +336,8 @@ void Awb::Process(StatisticsPtr &stats, Metadata *image_metadata)
 
 void Awb::asyncFunc()
 {
+	Thread::configureCurrent("RPi-AWB");
+
 	while (true) {
 		{
 			std::unique_lock<std::mutex> lock(mutex_);
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <chrono>
+
 #include <libcamera/libcamera.h>
 
 class Environment
@@ -19,9 +21,13 @@ public:
 	const std::string &cameraId() const { return cameraId_; }
 	libcamera::CameraManager *cm() const { return cm_; }
 
+	void setCaptureDuration(std::chrono::milliseconds duration) { captureDuration_ = duration; }
+	std::chrono::milliseconds captureDuration() const { return captureDuration_; }
+
 private:
 	Environment() = default;
 
 	std::string cameraId_;
 	libcamera::CameraManager *cm_;
+	std::chrono::milliseconds captureDuration_ = std::chrono::seconds(5);
 };
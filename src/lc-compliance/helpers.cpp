@@ -0,0 +1,35 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * helpers.cpp - Helpers shared by the tests
+ */
+
+#include "helpers.h"
+
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+using namespace libcamera;
+
+/* Name a stream role, to compose test names and result properties. */
+std::string roleName(StreamRole role)
+{
+	static const std::map<StreamRole, std::string> rolesMap = {
+		{ Raw, "Raw" },
+		{ StillCapture, "StillCapture" },
+		{ VideoRecording, "VideoRecording" },
+		{ Viewfinder, "Viewfinder" },
+	};
+
+	return rolesMap.at(role);
+}
+
+/* Format a measurement with a fixed precision, to record it as a property. */
+std::string formatValue(double value)
+{
+	std::ostringstream ss;
+	ss << std::fixed << std::setprecision(3) << value;
+	return ss.str();
+}
@@ -0,0 +1,15 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * helpers.h - Helpers shared by the tests
+ */
+
+#pragma once
+
+#include <string>
+
+#include <libcamera/libcamera.h>
+
+std::string roleName(libcamera::StreamRole role);
+std::string formatValue(double value);
@@ -21,6 +21,7 @@ using namespace libcamera;
 
 enum {
 	OptCamera = 'c',
+	OptDuration = 'd',
 	OptList = 'l',
 	OptFilter = 'f',
 	OptHelp = 'h',
@@ -72,7 +73,19 @@ static int initCamera(CameraManager *cm, OptionsParser::Options options)
 		return -ENODEV;
 	}
 
-	Environment::get()->setup(cm, cameraId);
+	Environment *env = Environment::get();
+	env->setup(cm, cameraId);
+
+	if (options.isSet(OptDuration)) {
+		int duration = options[OptDuration].toInteger();
+		if (duration <= 0) {
+			std::cout << "Invalid capture duration " << duration
+				  << std::endl;
+			return -EINVAL;
+		}
+
+		env->setCaptureDuration(std::chrono::seconds(duration));
+	}
 
 	std::cout << "Using camera " << cameraId << std::endl;
 
@@ -141,6 +154,9 @@ static int parseOptions(int argc, char **argv, OptionsParser::Options *options)
 	parser.addOption(OptCamera, OptionString,
 			 "Specify which camera to operate on, by id", "camera",
 			 ArgumentRequired, "camera");
+	parser.addOption(OptDuration, OptionInteger,
+			 "Set the duration of the performance tests, in seconds",
+			 "duration", ArgumentRequired, "seconds");
 	parser.addOption(OptList, OptionNone, "List all tests and exit", "list");
 	parser.addOption(OptFilter, OptionString,
 			 "Specify which tests to run", "filter",
@@ -0,0 +1,184 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * multi_camera_test.cpp - Test concurrent capture from multiple cameras
+ */
+
+#include <functional>
+#include <iostream>
+#include <limits>
+
+#include <gtest/gtest.h>
+
+#include "environment.h"
+#include "helpers.h"
+#include "simple_capture.h"
+
+using namespace libcamera;
+
+namespace {
+
+/* Number of requests completed by each camera. */
+constexpr unsigned int kNumRequests = 20;
+
+/* Number of start/stop cycles of the cameras streaming intermittently. */
+constexpr unsigned int kNumCycles = 5;
+
+} /* namespace */
+
+class MultiCamera : public testing::Test
+{
+protected:
+	void SetUp() override;
+	void TearDown() override;
+
+	void waitFor(const std::function<bool()> &condition);
+	void recordResults(unsigned int index);
+
+	std::vector<std::shared_ptr<Camera>> cameras_;
+	std::vector<std::unique_ptr<SimpleCaptureMultiStream>> captures_;
+
+	std::unique_ptr<EventLoop> loop_;
+};
+
+void MultiCamera::SetUp()
+{
+	std::vector<std::shared_ptr<Camera>> cameras = Environment::get()->cm()->cameras();
+	if (cameras.size() < 2) {
+		std::cout << "At least two cameras are needed" << std::endl;
+		GTEST_SKIP();
+	}
+
+	for (const std::shared_ptr<Camera> &camera : cameras) {
+		ASSERT_EQ(camera->acquire(), 0) << "Failed to acquire " << camera->id();
+		cameras_.push_back(camera);
+	}
+
+	for (const std::shared_ptr<Camera> &camera : cameras_) {
+		captures_.push_back(std::make_unique<SimpleCaptureMultiStream>(camera));
+		ASSERT_NO_FATAL_FAILURE(captures_.back()->configure(Viewfinder));
+		if (IsSkipped())
+			return;
+	}
+
+	loop_ = std::make_unique<EventLoop>();
+}
+
+void MultiCamera::TearDown()
+{
+	for (std::unique_ptr<SimpleCaptureMultiStream> &capture : captures_)
+		capture->stop();
+	captures_.clear();
+
+	loop_.reset();
+
+	for (std::shared_ptr<Camera> &camera : cameras_)
+		camera->release();
+	cameras_.clear();
+}
+
+/*
+ * The event loop is shared by all captures, each of them exits the loop when it
+ * finishes. Run the loop until the condition is met.
+ */
+void MultiCamera::waitFor(const std::function<bool()> &condition)
+{
+	while (!condition())
+		loop_->exec();
+}
+
+void MultiCamera::recordResults(unsigned int index)
+{
+	const SimpleCaptureMultiStream &capture = *captures_[index];
+	const SimpleCapture::Timings &timings = capture.timings();
+	std::string name = "camera" + std::to_string(index);
+
+	for (const SimpleCaptureMultiStream::StreamResults &result : capture.results()) {
+		RecordProperty(name + "_frames", result.frames);
+		RecordProperty(name + "_fps", formatValue(result.fps));
+
+		std::cout << cameras_[index]->id() << ": " << result.frames
+			  << " frames at " << formatValue(result.fps) << " fps"
+			  << std::endl;
+	}
+
+	RecordProperty(name + "_configure_ms", formatValue(timings.configure.count()));
+	RecordProperty(name + "_start_ms", formatValue(timings.start.count()));
+	RecordProperty(name + "_stop_ms", formatValue(timings.stop.count()));
+}
+
+/*
+ * Test concurrent capture
+ *
+ * Makes sure all cameras can capture at the same time, and reports the
+ * throughput of each of them and the time taken to configure, start and stop
+ * them. Example failure is a pipeline handler that shares hardware resources
+ * between cameras without arbitrating their use.
+ */
+TEST_F(MultiCamera, ConcurrentCapture)
+{
+	for (std::unique_ptr<SimpleCaptureMultiStream> &capture : captures_)
+		ASSERT_NO_FATAL_FAILURE(capture->start(kNumRequests, loop_.get()));
+
+	waitFor([this]() {
+		for (const std::unique_ptr<SimpleCaptureMultiStream> &capture : captures_) {
+			if (!capture->finished())
+				return false;
+		}
+		return true;
+	});
+
+	for (std::unique_ptr<SimpleCaptureMultiStream> &capture : captures_)
+		capture->stop();
+
+	for (unsigned int i = 0; i < captures_.size(); ++i) {
+		EXPECT_EQ(captures_[i]->status(), 0)
+			<< "Capture failed on " << cameras_[i]->id();
+		recordResults(i);
+	}
+}
+
+/*
+ * Test start/stop cycles while streaming
+ *
+ * Makes sure cameras can be started and stopped repeatedly while the first
+ * camera keeps streaming, without disturbing it. Example failure is a pipeline
+ * handler that resets shared hardware when one of its cameras is stopped.
+ */
+TEST_F(MultiCamera, StartStopWhileStreaming)
+{
+	SimpleCaptureMultiStream &streaming = *captures_[0];
+
+	/* Stream continuously from the first camera. */
+	ASSERT_NO_FATAL_FAILURE(streaming.start(std::numeric_limits<unsigned int>::max(),
+						loop_.get()));
+
+	for (unsigned int cycle = 0; cycle < kNumCycles; ++cycle) {
+		for (unsigned int i = 1; i < captures_.size(); ++i)
+			ASSERT_NO_FATAL_FAILURE(captures_[i]->start(kNumRequests, loop_.get()));
+
+		waitFor([this]() {
+			for (unsigned int i = 1; i < captures_.size(); ++i) {
+				if (!captures_[i]->finished())
+					return false;
+			}
+			return true;
+		});
+
+		for (unsigned int i = 1; i < captures_.size(); ++i) {
+			captures_[i]->stop();
+
+			ASSERT_EQ(captures_[i]->status(), 0)
+				<< "Capture failed on " << cameras_[i]->id();
+		}
+
+		ASSERT_EQ(streaming.status(), 0)
+			<< "Streaming interrupted on " << cameras_[0]->id();
+	}
+
+	streaming.stop();
+
+	for (unsigned int i = 0; i < captures_.size(); ++i)
+		recordResults(i);
+}
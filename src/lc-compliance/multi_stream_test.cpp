@@ -0,0 +1,246 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * multi_stream_test.cpp - Test multi-stream capture and stress scenarios
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+#include <gtest/gtest.h>
+
+#include "environment.h"
+#include "helpers.h"
+#include "simple_capture.h"
+
+using namespace libcamera;
+
+namespace {
+
+const std::vector<StreamRoles> ROLE_SETS = {
+	{ Viewfinder, VideoRecording },
+	{ Viewfinder, StillCapture },
+	{ Viewfinder, Raw },
+	{ Viewfinder, VideoRecording, StillCapture },
+};
+
+const std::vector<int> NUMREQUESTS = { 10, 50 };
+
+/* Number of iterations of the start/stop and reconfiguration loops. */
+constexpr unsigned int kNumCycles = 10;
+
+/* Number of requests completed in each iteration of the loops. */
+constexpr unsigned int kCycleRequests = 5;
+
+std::string rolesName(const StreamRoles &roles)
+{
+	std::string name;
+
+	for (StreamRole role : roles)
+		name += (name.empty() ? "" : "_") + roleName(role);
+
+	return name;
+}
+
+/* Record the mean and maximum of a list of durations, in milliseconds. */
+void recordTimings(const std::string &name, const std::vector<double> &values)
+{
+	double mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+	double max = *std::max_element(values.begin(), values.end());
+
+	testing::Test::RecordProperty(name + "_mean_ms", formatValue(mean));
+	testing::Test::RecordProperty(name + "_max_ms", formatValue(max));
+
+	std::cout << name << ": mean " << formatValue(mean) << " ms, max "
+		  << formatValue(max) << " ms" << std::endl;
+}
+
+void recordResults(const SimpleCaptureMultiStream &capture)
+{
+	for (const SimpleCaptureMultiStream::StreamResults &result : capture.results()) {
+		std::string name = roleName(result.role);
+
+		testing::Test::RecordProperty(name + "_frames", result.frames);
+		testing::Test::RecordProperty(name + "_fps", formatValue(result.fps));
+
+		std::cout << name << ": " << result.frames << " frames at "
+			  << formatValue(result.fps) << " fps" << std::endl;
+	}
+}
+
+} /* namespace */
+
+class MultiStream : public testing::TestWithParam<std::tuple<StreamRoles, int>>
+{
+public:
+	static std::string nameParameters(const testing::TestParamInfo<MultiStream::ParamType> &info);
+
+protected:
+	void SetUp() override;
+	void TearDown() override;
+
+	std::shared_ptr<Camera> camera_;
+};
+
+void MultiStream::SetUp()
+{
+	Environment *env = Environment::get();
+
+	camera_ = env->cm()->get(env->cameraId());
+
+	ASSERT_EQ(camera_->acquire(), 0);
+}
+
+void MultiStream::TearDown()
+{
+	if (!camera_)
+		return;
+
+	camera_->release();
+	camera_.reset();
+}
+
+std::string MultiStream::nameParameters(const testing::TestParamInfo<MultiStream::ParamType> &info)
+{
+	return rolesName(std::get<0>(info.param)) + "_" +
+	       std::to_string(std::get<1>(info.param));
+}
+
+/*
+ * The start/stop and reconfiguration cycles complete a fixed number of
+ * requests in each iteration, and are thus parametrized by roles only.
+ */
+class MultiStreamCycles : public testing::TestWithParam<StreamRoles>
+{
+public:
+	static std::string nameParameters(const testing::TestParamInfo<MultiStreamCycles::ParamType> &info);
+
+protected:
+	void SetUp() override;
+	void TearDown() override;
+
+	std::shared_ptr<Camera> camera_;
+};
+
+void MultiStreamCycles::SetUp()
+{
+	Environment *env = Environment::get();
+
+	camera_ = env->cm()->get(env->cameraId());
+
+	ASSERT_EQ(camera_->acquire(), 0);
+}
+
+void MultiStreamCycles::TearDown()
+{
+	if (!camera_)
+		return;
+
+	camera_->release();
+	camera_.reset();
+}
+
+std::string MultiStreamCycles::nameParameters(const testing::TestParamInfo<MultiStreamCycles::ParamType> &info)
+{
+	return rolesName(info.param);
+}
+
+/*
+ * Test multi-stream capture
+ *
+ * Makes sure the camera completes the requests queued when capturing from
+ * multiple streams concurrently, and reports the throughput of each stream and
+ * the time taken to configure, start and stop the camera. Example failure is a
+ * pipeline handler that fails to complete requests when all of its streams are
+ * in use.
+ */
+TEST_P(MultiStream, Capture)
+{
+	auto [roles, numRequests] = GetParam();
+
+	SimpleCaptureMultiStream capture(camera_);
+
+	ASSERT_NO_FATAL_FAILURE(capture.configure(roles));
+	if (IsSkipped())
+		return;
+
+	ASSERT_NO_FATAL_FAILURE(capture.capture(numRequests));
+
+	recordResults(capture);
+	recordTimings("configure", { capture.timings().configure.count() });
+	recordTimings("start", { capture.timings().start.count() });
+	recordTimings("stop", { capture.timings().stop.count() });
+}
+
+/*
+ * Test start/stop cycles under load
+ *
+ * Makes sure the camera supports repeated start/stop cycles while all its
+ * streams have requests in flight, and reports the time taken by start() and
+ * stop(). Example failure is a pipeline handler that leaks buffers when
+ * stopped with multiple streams active.
+ */
+TEST_P(MultiStreamCycles, StartStopUnderLoad)
+{
+	const StreamRoles &roles = GetParam();
+	std::vector<double> startTimes;
+	std::vector<double> stopTimes;
+
+	SimpleCaptureMultiStream capture(camera_);
+
+	ASSERT_NO_FATAL_FAILURE(capture.configure(roles));
+	if (IsSkipped())
+		return;
+
+	for (unsigned int i = 0; i < kNumCycles; i++) {
+		ASSERT_NO_FATAL_FAILURE(capture.capture(kCycleRequests));
+
+		startTimes.push_back(capture.timings().start.count());
+		stopTimes.push_back(capture.timings().stop.count());
+	}
+
+	recordTimings("start", startTimes);
+	recordTimings("stop", stopTimes);
+}
+
+/*
+ * Test reconfiguration cycles
+ *
+ * Makes sure the camera can be repeatedly reconfigured between single-stream
+ * and multi-stream configurations, capturing in each of them, and reports the
+ * time taken by configure(). Example failure is a pipeline handler that
+ * doesn't reset the routing of its internal pipeline when reconfigured.
+ */
+TEST_P(MultiStreamCycles, Reconfigure)
+{
+	const StreamRoles &roles = GetParam();
+	const StreamRoles configurations[] = { roles, { roles[0] } };
+	std::vector<double> configureTimes;
+
+	SimpleCaptureMultiStream capture(camera_);
+
+	for (unsigned int i = 0; i < kNumCycles; i++) {
+		ASSERT_NO_FATAL_FAILURE(capture.configure(configurations[i % 2]));
+		if (IsSkipped())
+			return;
+
+		ASSERT_NO_FATAL_FAILURE(capture.capture(kCycleRequests));
+
+		configureTimes.push_back(capture.timings().configure.count());
+	}
+
+	recordTimings("configure", configureTimes);
+}
+
+INSTANTIATE_TEST_SUITE_P(MultiStreamTests,
+			 MultiStream,
+			 testing::Combine(testing::ValuesIn(ROLE_SETS),
+					  testing::ValuesIn(NUMREQUESTS)),
+			 MultiStream::nameParameters);
+
+INSTANTIATE_TEST_SUITE_P(MultiStreamTests,
+			 MultiStreamCycles,
+			 testing::ValuesIn(ROLE_SETS),
+			 MultiStreamCycles::nameParameters);
@@ -0,0 +1,125 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * performance_test.cpp - Test camera capture performance
+ */
+
+#include <iostream>
+
+#include <gtest/gtest.h>
+
+#include "environment.h"
+#include "helpers.h"
+#include "simple_capture.h"
+
+using namespace libcamera;
+
+namespace {
+
+const std::vector<StreamRole> ROLES = { Raw, StillCapture, VideoRecording, Viewfinder };
+
+/*
+ * Minimum ratio of the frame rate achieved by the camera to the maximum frame
+ * rate it reports through the FrameDurationLimits control.
+ */
+constexpr double kMinFpsRatio = 0.95;
+
+} /* namespace */
+
+class Performance : public testing::TestWithParam<StreamRole>
+{
+public:
+	static std::string nameParameters(const testing::TestParamInfo<Performance::ParamType> &info);
+
+protected:
+	void SetUp() override;
+	void TearDown() override;
+
+	std::shared_ptr<Camera> camera_;
+};
+
+void Performance::SetUp()
+{
+	Environment *env = Environment::get();
+
+	camera_ = env->cm()->get(env->cameraId());
+
+	ASSERT_EQ(camera_->acquire(), 0);
+}
+
+void Performance::TearDown()
+{
+	if (!camera_)
+		return;
+
+	camera_->release();
+	camera_.reset();
+}
+
+std::string Performance::nameParameters(const testing::TestParamInfo<Performance::ParamType> &info)
+{
+	return roleName(info.param);
+}
+
+/*
+ * Test sustained capture performance
+ *
+ * Captures continuously for the duration set with the --duration option, and
+ * measures the frame rate, the request latency (from queueing a request to its
+ * completion), the jitter of the frame intervals computed from the buffer
+ * timestamps, and the number of frames dropped, detected from gaps in the
+ * buffer sequence numbers.
+ *
+ * The test fails if frames are dropped, or if the camera reports its frame
+ * rate range through the FrameDurationLimits control and fails to sustain the
+ * maximum frame rate.
+ *
+ * The measurements are recorded as test properties, and can be retrieved in
+ * machine-readable form with the Googletest GTEST_OUTPUT environment variable,
+ * for instance GTEST_OUTPUT=json:results.json.
+ */
+TEST_P(Performance, SustainedCapture)
+{
+	StreamRole role = GetParam();
+
+	SimpleCapturePerformance capture(camera_);
+
+	ASSERT_NO_FATAL_FAILURE(capture.configure(role));
+	if (IsSkipped())
+		return;
+
+	ASSERT_NO_FATAL_FAILURE(capture.capture(Environment::get()->captureDuration()));
+
+	const SimpleCapturePerformance::Results &results = capture.results();
+
+	RecordProperty("frames", results.frames);
+	RecordProperty("dropped_frames", results.droppedFrames);
+	RecordProperty("fps", formatValue(results.fps));
+	RecordProperty("expected_fps", formatValue(results.expectedFps));
+	RecordProperty("latency_mean_ms", formatValue(results.latencyMean));
+	RecordProperty("latency_p99_ms", formatValue(results.latencyP99));
+	RecordProperty("latency_max_ms", formatValue(results.latencyMax));
+	RecordProperty("frame_interval_mean_ms", formatValue(results.frameIntervalMean));
+	RecordProperty("frame_interval_max_ms", formatValue(results.frameIntervalMax));
+	RecordProperty("jitter_ms", formatValue(results.jitter));
+
+	std::cout << results.frames << " frames at " << formatValue(results.fps)
+		  << " fps, " << results.droppedFrames << " dropped, latency "
+		  << formatValue(results.latencyMean) << "/"
+		  << formatValue(results.latencyP99) << "/"
+		  << formatValue(results.latencyMax) << " ms (mean/p99/max), jitter "
+		  << formatValue(results.jitter) << " ms" << std::endl;
+
+	EXPECT_EQ(results.droppedFrames, 0U) << "Frames dropped";
+
+	if (results.expectedFps > 0) {
+		EXPECT_GE(results.fps, results.expectedFps * kMinFpsRatio)
+			<< "Frame rate below the FrameDurationLimits maximum";
+	}
+}
+
+INSTANTIATE_TEST_SUITE_P(PerformanceTests,
+			 Performance,
+			 testing::ValuesIn(ROLES),
+			 Performance::nameParameters);
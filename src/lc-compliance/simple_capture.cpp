@@ -5,8 +5,15 @@
  * simple_capture.cpp - Simple capture helper
  */
 
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdint.h>
+
 #include <gtest/gtest.h>
 
+#include <libcamera/control_ids.h>
+
 #include "simple_capture.h"
 
 using namespace libcamera;
@@ -24,35 +31,62 @@ SimpleCapture::~SimpleCapture()
 
 void SimpleCapture::configure(StreamRole role)
 {
-	config_ = camera_->generateConfiguration({ role });
+	configure(StreamRoles{ role });
+}
+
+void SimpleCapture::configure(const StreamRoles &roles)
+{
+	roles_ = roles;
+	config_ = camera_->generateConfiguration(roles);
 
 	if (!config_) {
 		std::cout << "Role not supported by camera" << std::endl;
 		GTEST_SKIP();
 	}
 
-	if (config_->validate() != CameraConfiguration::Valid) {
+	CameraConfiguration::Status status = config_->validate();
+
+	/*
+	 * Cameras that can't capture all the requested roles concurrently
+	 * adjust the number of streams, skip the test in that case.
+	 */
+	if (roles.size() > 1 && status != CameraConfiguration::Valid) {
+		config_.reset();
+		std::cout << "Roles not supported concurrently by camera" << std::endl;
+		GTEST_SKIP();
+	}
+
+	if (status != CameraConfiguration::Valid) {
 		config_.reset();
 		FAIL() << "Configuration not valid";
 	}
 
-	if (camera_->configure(config_.get())) {
+	clock::time_point begin = clock::now();
+	int ret = camera_->configure(config_.get());
+	timings_.configure = clock::now() - begin;
+
+	if (ret) {
 		config_.reset();
 		FAIL() << "Failed to configure camera";
 	}
 }
 
-void SimpleCapture::start()
+void SimpleCapture::start(const ControlList *controls)
 {
-	Stream *stream = config_->at(0).stream();
-	int count = allocator_->allocate(stream);
+	for (const StreamConfiguration &cfg : *config_) {
+		int count = allocator_->allocate(cfg.stream());
 
-	ASSERT_GE(count, 0) << "Failed to allocate buffers";
-	EXPECT_EQ(count, config_->at(0).bufferCount) << "Allocated less buffers than expected";
+		ASSERT_GE(count, 0) << "Failed to allocate buffers";
+		EXPECT_EQ(count, cfg.bufferCount) << "Allocated less buffers than expected";
+	}
 
 	camera_->requestCompleted.connect(this, &SimpleCapture::requestComplete);
 
-	ASSERT_EQ(camera_->start(), 0) << "Failed to start camera";
+	clock::time_point begin = clock::now();
+	int ret = camera_->start(controls);
+	timings_.start = clock::now() - begin;
+
+	ASSERT_EQ(ret, 0) << "Failed to start camera";
 }
 
 void SimpleCapture::stop()
@@ -60,12 +94,14 @@ void SimpleCapture::stop()
 	if (!config_ || !allocator_->allocated())
 		return;
 
+	clock::time_point begin = clock::now();
 	camera_->stop();
+	timings_.stop = clock::now() - begin;
 
 	camera_->requestCompleted.disconnect(this);
 
-	Stream *stream = config_->at(0).stream();
-	allocator_->free(stream);
+	for (const StreamConfiguration &cfg : *config_)
+		allocator_->free(cfg.stream());
 }
 
 /* SimpleCaptureBalanced */
@@ -189,3 +225,297 @@ void SimpleCaptureUnbalanced::requestComplete(Request *request)
 	if (camera_->queueRequest(request))
 		loop_->exit(-EINVAL);
 }
+
+/* SimpleCapturePerformance */
+
+SimpleCapturePerformance::SimpleCapturePerformance(std::shared_ptr<Camera> camera)
+	: SimpleCapture(camera), results_({})
+{
+}
+
+void SimpleCapturePerformance::capture(std::chrono::milliseconds duration)
+{
+	/*
+	 * Run at the highest frame rate supported by the camera, if it can be
+	 * controlled, to measure the maximum sustained throughput.
+	 */
+	ControlList startControls(controls::controls);
+	int64_t minFrameDuration = 0;
+
+	const ControlInfoMap &info = camera_->controls();
+	const auto iter = info.find(&controls::FrameDurationLimits);
+	if (iter != info.end()) {
+		minFrameDuration = iter->second.min().get<int64_t>();
+		if (minFrameDuration > 0)
+			startControls.set(controls::FrameDurationLimits,
+					  { minFrameDuration, minFrameDuration });
+	}
+
+	start(&startControls);
+
+	Stream *stream = config_->at(0).stream();
+	const std::vector<std::unique_ptr<FrameBuffer>> &buffers = allocator_->buffers(stream);
+
+	duration_ = duration;
+	stopping_ = false;
+
+	/*
+	 * Size the queue times before queueing the first request, as they are
+	 * updated from the camera manager thread when requeueing requests.
+	 */
+	queueTimes_.assign(buffers.size(), {});
+	latencies_.clear();
+	timestamps_.clear();
+	droppedFrames_ = 0;
+	startTime_ = clock::now();
+
+	std::vector<std::unique_ptr<libcamera::Request>> requests;
+	for (unsigned int i = 0; i < buffers.size(); ++i) {
+		std::unique_ptr<Request> request = camera_->createRequest(i);
+		ASSERT_TRUE(request) << "Can't create request";
+
+		ASSERT_EQ(request->addBuffer(stream, buffers[i].get()), 0) << "Can't set buffer for request";
+
+		ASSERT_EQ(queueRequest(request.get()), 0) << "Failed to queue request";
+
+		requests.push_back(std::move(request));
+	}
+
+	/* Run capture session. */
+	loop_ = new EventLoop();
+	int status = loop_->exec();
+	stop();
+	delete loop_;
+
+	ASSERT_EQ(status, 0) << "Capture failed";
+	ASSERT_GE(timestamps_.size(), 2U) << "Not enough frames captured";
+
+	computeResults();
+
+	if (minFrameDuration > 0)
+		results_.expectedFps = 1e6 / minFrameDuration;
+}
+
+int SimpleCapturePerformance::queueRequest(Request *request)
+{
+	queueTimes_[request->cookie()] = clock::now();
+
+	return camera_->queueRequest(request);
+}
+
+void SimpleCapturePerformance::requestComplete(Request *request)
+{
+	if (stopping_)
+		return;
+
+	clock::time_point now = clock::now();
+
+	if (request->status() != Request::RequestComplete) {
+		stopping_ = true;
+		loop_->exit(-EINVAL);
+		return;
+	}
+
+	std::chrono::duration<double, std::milli> latency = now - queueTimes_[request->cookie()];
+	latencies_.push_back(latency.count());
+
+	const FrameMetadata &metadata =
+		request->findBuffer(config_->at(0).stream())->metadata();
+
+	if (!timestamps_.empty() && metadata.sequence > lastSequence_ + 1)
+		droppedFrames_ += metadata.sequence - lastSequence_ - 1;
+
+	lastSequence_ = metadata.sequence;
+	timestamps_.push_back(metadata.timestamp);
+
+	if (now - startTime_ >= duration_) {
+		stopping_ = true;
+		loop_->exit(0);
+		return;
+	}
+
+	request->reuse(Request::ReuseBuffers);
+	if (queueRequest(request)) {
+		stopping_ = true;
+		loop_->exit(-EINVAL);
+	}
+}
+
+void SimpleCapturePerformance::computeResults()
+{
+	Results &results = results_;
+	results = {};
+
+	results.frames = timestamps_.size();
+	results.droppedFrames = droppedFrames_;
+
+	/* Frame rate and intervals, from the sensor timestamps in ms. */
+	std::vector<double> intervals;
+	for (unsigned int i = 1; i < timestamps_.size(); ++i)
+		intervals.push_back((timestamps_[i] - timestamps_[i - 1]) / 1e6);
+
+	double total = std::accumulate(intervals.begin(), intervals.end(), 0.0);
+	results.fps = intervals.size() * 1e3 / total;
+	results.frameIntervalMean = total / intervals.size();
+	results.frameIntervalMax = *std::max_element(intervals.begin(), intervals.end());
+
+	double variance = 0.0;
+	for (double interval : intervals)
+		variance += std::pow(interval - results.frameIntervalMean, 2);
+	results.jitter = std::sqrt(variance / intervals.size());
+
+	/* Request latencies, in ms. */
+	std::sort(latencies_.begin(), latencies_.end());
+	results.latencyMean = std::accumulate(latencies_.begin(), latencies_.end(), 0.0)
+			    / latencies_.size();
+	results.latencyP99 = latencies_[(latencies_.size() - 1) * 99 / 100];
+	results.latencyMax = latencies_.back();
+}
+
+/* SimpleCaptureMultiStream */
+
+SimpleCaptureMultiStream::SimpleCaptureMultiStream(std::shared_ptr<Camera> camera)
+	: SimpleCapture(camera), stopping_(false), finished_(false), status_(0)
+{
+}
+
+SimpleCaptureMultiStream::~SimpleCaptureMultiStream()
+{
+	/* Stop the camera before destroying the requests. */
+	stop();
+}
+
+void SimpleCaptureMultiStream::capture(unsigned int numRequests)
+{
+	EventLoop loop;
+
+	start(numRequests, &loop);
+	if (testing::Test::HasFatalFailure()) {
+		stop();
+		return;
+	}
+
+	/* Run capture session. */
+	loop.exec();
+	stop();
+
+	ASSERT_EQ(status(), 0) << "Capture failed";
+	ASSERT_GE(captureCount_, captureLimit_);
+}
+
+void SimpleCaptureMultiStream::start(unsigned int numRequests, EventLoop *loop)
+{
+	loop_ = loop;
+
+	SimpleCapture::start();
+
+	captureCount_ = 0;
+	captureLimit_ = numRequests;
+	stopping_ = false;
+	finished_ = false;
+	status_ = 0;
+
+	stats_.clear();
+	requests_.clear();
+
+	/* Each request captures one buffer for every stream. */
+	size_t numBuffers = SIZE_MAX;
+	for (const StreamConfiguration &cfg : *config_) {
+		numBuffers = std::min(numBuffers, allocator_->buffers(cfg.stream()).size());
+		stats_[cfg.stream()] = {};
+	}
+
+	for (size_t i = 0; i < numBuffers; ++i) {
+		std::unique_ptr<Request> request = camera_->createRequest();
+		ASSERT_TRUE(request) << "Can't create request";
+
+		for (const StreamConfiguration &cfg : *config_) {
+			Stream *stream = cfg.stream();
+			ASSERT_EQ(request->addBuffer(stream, allocator_->buffers(stream)[i].get()), 0)
+				<< "Can't set buffer for request";
+		}
+
+		requests_.push_back(std::move(request));
+	}
+
+	for (const std::unique_ptr<Request> &request : requests_)
+		ASSERT_EQ(camera_->queueRequest(request.get()), 0) << "Failed to queue request";
+}
+
+void SimpleCaptureMultiStream::stop()
+{
+	stopping_ = true;
+
+	SimpleCapture::stop();
+
+	requests_.clear();
+}
+
+std::vector<SimpleCaptureMultiStream::StreamResults> SimpleCaptureMultiStream::results() const
+{
+	std::vector<StreamResults> results;
+
+	for (unsigned int i = 0; i < config_->size(); ++i) {
+		const StreamStats &stats = stats_.at(config_->at(i).stream());
+		double fps = 0.0;
+
+		if (stats.frames > 1)
+			fps = (stats.frames - 1) * 1e9
+			    / (stats.lastTimestamp - stats.firstTimestamp);
+
+		results.push_back({ roles_[i], stats.frames, fps });
+	}
+
+	return results;
+}
+
+/*
+ * Mark the capture as finished and exit the event loop. The exit is deferred to
+ * the event loop to avoid losing it when the loop isn't running yet, or when it
+ * is shared between multiple captures.
+ */
+void SimpleCaptureMultiStream::finish(int status)
+{
+	if (status)
+		status_ = status;
+
+	if (finished_.exchange(true))
+		return;
+
+	EventLoop *loop = loop_;
+	loop->callLater([loop]() { loop->exit(0); });
+}
+
+void SimpleCaptureMultiStream::requestComplete(Request *request)
+{
+	if (stopping_)
+		return;
+
+	if (request->status() != Request::RequestComplete) {
+		finish(-EINVAL);
+		return;
+	}
+
+	for (const auto &[stream, buffer] : request->buffers()) {
+		const FrameMetadata &metadata = buffer->metadata();
+		if (metadata.status != FrameMetadata::FrameSuccess)
+			continue;
+
+		StreamStats &stats = stats_[stream];
+		if (!stats.frames)
+			stats.firstTimestamp = metadata.timestamp;
+		stats.lastTimestamp = metadata.timestamp;
+		stats.frames++;
+	}
+
+	if (++captureCount_ >= captureLimit_)
+		finish(0);
+
+	/*
+	 * Keep requeuing requests until the capture is stopped, to stop the
+	 * camera under load.
+	 */
+	request->reuse(Request::ReuseBuffers);
+	if (camera_->queueRequest(request))
+		finish(-EINVAL);
+}
@@ -7,7 +7,11 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <map>
 #include <memory>
+#include <vector>
 
 #include <libcamera/libcamera.h>
 
@@ -16,13 +20,24 @@
 class SimpleCapture
 {
 public:
+	using clock = std::chrono::steady_clock;
+
+	struct Timings {
+		std::chrono::duration<double, std::milli> configure;
+		std::chrono::duration<double, std::milli> start;
+		std::chrono::duration<double, std::milli> stop;
+	};
+
 	void configure(libcamera::StreamRole role);
+	void configure(const libcamera::StreamRoles &roles);
+
+	const Timings &timings() const { return timings_; }
 
 protected:
 	SimpleCapture(std::shared_ptr<libcamera::Camera> camera);
 	virtual ~SimpleCapture();
 
-	void start();
+	void start(const libcamera::ControlList *controls = nullptr);
 	void stop();
 
 	virtual void requestComplete(libcamera::Request *request) = 0;
@@ -31,7 +46,10 @@ protected:
 
 	std::shared_ptr<libcamera::Camera> camera_;
 	std::unique_ptr<libcamera::FrameBufferAllocator> allocator_;
+	libcamera::StreamRoles roles_;
 	std::unique_ptr<libcamera::CameraConfiguration> config_;
+
+	Timings timings_;
 };
 
 class SimpleCaptureBalanced : public SimpleCapture
@@ -63,3 +81,87 @@ private:
 	unsigned int captureCount_;
 	unsigned int captureLimit_;
 };
+
+class SimpleCapturePerformance : public SimpleCapture
+{
+public:
+	struct Results {
+		unsigned int frames;
+		unsigned int droppedFrames;
+
+		double expectedFps;
+		double fps;
+
+		double latencyMean;
+		double latencyP99;
+		double latencyMax;
+
+		double frameIntervalMean;
+		double jitter;
+		double frameIntervalMax;
+	};
+
+	SimpleCapturePerformance(std::shared_ptr<libcamera::Camera> camera);
+
+	void capture(std::chrono::milliseconds duration);
+
+	const Results &results() const { return results_; }
+
+private:
+	int queueRequest(libcamera::Request *request);
+	void requestComplete(libcamera::Request *request) override;
+	void computeResults();
+
+	std::chrono::milliseconds duration_;
+	clock::time_point startTime_;
+	bool stopping_;
+
+	std::vector<clock::time_point> queueTimes_;
+	std::vector<double> latencies_;
+	std::vector<uint64_t> timestamps_;
+	unsigned int lastSequence_;
+	unsigned int droppedFrames_;
+
+	Results results_;
+};
+
+class SimpleCaptureMultiStream : public SimpleCapture
+{
+public:
+	struct StreamResults {
+		libcamera::StreamRole role;
+		unsigned int frames;
+		double fps;
+	};
+
+	SimpleCaptureMultiStream(std::shared_ptr<libcamera::Camera> camera);
+	~SimpleCaptureMultiStream();
+
+	void capture(unsigned int numRequests);
+
+	void start(unsigned int numRequests, EventLoop *loop);
+	void stop();
+	bool finished() const { return finished_; }
+	int status() const { return status_; }
+
+	std::vector<StreamResults> results() const;
+
+private:
+	struct StreamStats {
+		unsigned int frames;
+		uint64_t firstTimestamp;
+		uint64_t lastTimestamp;
+	};
+
+	void finish(int status);
+	void requestComplete(libcamera::Request *request) override;
+
+	std::vector<std::unique_ptr<libcamera::Request>> requests_;
+	std::map<const libcamera::Stream *, StreamStats> stats_;
+
+	unsigned int captureCount_;
+	unsigned int captureLimit_;
+	std::atomic<bool> stopping_;
+	std::atomic<bool> finished_;
+	std::atomic<int> status_;
+};
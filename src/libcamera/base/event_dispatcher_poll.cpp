@@ -22,6 +22,8 @@
 #include <libcamera/base/timer.h>
 #include <libcamera/base/utils.h>
 
+#include "libcamera/base/internal/tracepoints.h"
+
 /**
  * \file base/event_dispatcher_poll.h
  */
@@ -156,10 +158,15 @@ void EventDispatcherPoll::processEvents()
 	pollfds.push_back({ eventfd_.get(), POLLIN, 0 });
 
 	/* Wait for events and process notifiers and timers. */
+	LIBCAMERA_BASE_TRACEPOINT(event_dispatcher_sleep, pollfds.size());
+
 	do {
 		ret = poll(&pollfds);
 	} while (ret == -1 && errno == EINTR);
 
+	LIBCAMERA_BASE_TRACEPOINT(event_dispatcher_wakeup, ret,
+				  ret > 0 && (pollfds.back().revents & POLLIN));
+
 	if (ret < 0) {
 		ret = -errno;
 		LOG(Event, Warning) << "poll() failed with " << strerror(-ret);
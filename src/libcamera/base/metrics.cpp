@@ -0,0 +1,540 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * metrics.cpp - Latency metrics registry
+ */
+
+#include <libcamera/base/metrics.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+/**
+ * \file base/metrics.h
+ * \brief Latency metrics registry
+ *
+ * The metrics facility records counters and latency distributions in the
+ * libcamera core, in a way that is cheap enough to be always enabled. Unlike
+ * tracepoints, it requires no external tooling: the collected data can be
+ * retrieved at any time through the MetricsRegistry.
+ *
+ * Metrics are identified by a name, formatted as a dot-separated hierarchy
+ * such as "request.queue_to_device" or "ipa.ipu3.fillParamsBuffer". Durations
+ * are recorded in nanoseconds.
+ */
+
+namespace libcamera {
+
+/**
+ * \class MetricHistogram
+ * \brief A lock-free log-linear histogram
+ *
+ * The MetricHistogram class records the distribution of values, typically
+ * durations in nanoseconds. Values are accumulated in log-linear buckets: each
+ * power of two range is split into kSubBuckets linear buckets, bounding the
+ * relative error of the reported percentiles to 1 / kSubBuckets (12.5%) over
+ * the whole 64-bit range. Values smaller than kSubBuckets are recorded
+ * exactly.
+ *
+ * Recording a value only involves relaxed atomic operations, and can thus be
+ * performed concurrently from multiple threads without locking. Reading the
+ * histogram while values are being recorded returns a consistent enough view
+ * for monitoring purposes, but counts may be momentarily off by the number of
+ * concurrent writers.
+ *
+ * Histograms register themselves with the MetricsRegistry when constructed
+ * and unregister when destroyed. They are usually declared as static objects
+ * in the source file that records them.
+ */
+
+/**
+ * \brief Construct a histogram and register it with the MetricsRegistry
+ * \param[in] name The histogram name
+ */
+MetricHistogram::MetricHistogram(const std::string &name)
+	: name_(name)
+{
+	reset();
+
+	MetricsRegistry::instance()->registerHistogram(this);
+}
+
+MetricHistogram::~MetricHistogram()
+{
+	MetricsRegistry::instance()->unregisterHistogram(this);
+}
+
+/**
+ * \fn MetricHistogram::name()
+ * \brief Retrieve the histogram name
+ * \return The histogram name
+ */
+
+/**
+ * \brief Record a value in the histogram
+ * \param[in] value The value
+ *
+ * \context This function is \threadsafe.
+ */
+void MetricHistogram::record(uint64_t value)
+{
+	buckets_[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+	count_.fetch_add(1, std::memory_order_relaxed);
+	sum_.fetch_add(value, std::memory_order_relaxed);
+
+	uint64_t min = min_.load(std::memory_order_relaxed);
+	while (value < min &&
+	       !min_.compare_exchange_weak(min, value, std::memory_order_relaxed))
+		;
+
+	uint64_t max = max_.load(std::memory_order_relaxed);
+	while (value > max &&
+	       !max_.compare_exchange_weak(max, value, std::memory_order_relaxed))
+		;
+}
+
+/**
+ * \fn MetricHistogram::record(utils::duration duration)
+ * \brief Record a duration in the histogram, in nanoseconds
+ * \param[in] duration The duration
+ *
+ * \context This function is \threadsafe.
+ */
+
+/**
+ * \brief Retrieve the number of values recorded in the histogram
+ * \return The number of values
+ */
+uint64_t MetricHistogram::count() const
+{
+	return count_.load(std::memory_order_relaxed);
+}
+
+/**
+ * \brief Retrieve the sum of the values recorded in the histogram
+ * \return The sum of the values
+ */
+uint64_t MetricHistogram::sum() const
+{
+	return sum_.load(std::memory_order_relaxed);
+}
+
+/**
+ * \brief Retrieve the smallest value recorded in the histogram
+ * \return The smallest value, or 0 if the histogram is empty
+ */
+uint64_t MetricHistogram::min() const
+{
+	return count() ? min_.load(std::memory_order_relaxed) : 0;
+}
+
+/**
+ * \brief Retrieve the largest value recorded in the histogram
+ * \return The largest value
+ */
+uint64_t MetricHistogram::max() const
+{
+	return max_.load(std::memory_order_relaxed);
+}
+
+/**
+ * \brief Estimate a percentile of the recorded values
+ * \param[in] percent The percentile, in the [0, 100] range
+ *
+ * The percentile is estimated as the middle of the bucket that contains it,
+ * clamped to the range of recorded values. The 0th and 100th percentiles are
+ * the exact minimum and maximum values.
+ *
+ * \return The estimated percentile, or 0 if the histogram is empty
+ */
+uint64_t MetricHistogram::percentile(double percent) const
+{
+	uint64_t total = 0;
+	uint64_t counts[kBuckets];
+
+	for (unsigned int i = 0; i < kBuckets; ++i) {
+		counts[i] = buckets_[i].load(std::memory_order_relaxed);
+		total += counts[i];
+	}
+
+	if (!total)
+		return 0;
+
+	if (percent <= 0.0)
+		return min();
+	if (percent >= 100.0)
+		return max();
+
+	uint64_t target = std::max<uint64_t>(std::ceil(percent / 100.0 * total), 1);
+	uint64_t cumulated = 0;
+
+	for (unsigned int i = 0; i < kBuckets; ++i) {
+		cumulated += counts[i];
+		if (cumulated < target)
+			continue;
+
+		uint64_t lower = bucketLowerBound(i);
+		uint64_t upper = i + 1 < kBuckets ? bucketLowerBound(i + 1) - 1
+						  : std::numeric_limits<uint64_t>::max();
+		uint64_t value = lower + (upper - lower) / 2;
+
+		return std::clamp(value, min(), max());
+	}
+
+	return max();
+}
+
+/**
+ * \brief Reset the histogram
+ *
+ * \context This function is \threadsafe, but values recorded concurrently may
+ * be partly accounted for.
+ */
+void MetricHistogram::reset()
+{
+	for (std::atomic<uint64_t> &bucket : buckets_)
+		bucket.store(0, std::memory_order_relaxed);
+
+	count_.store(0, std::memory_order_relaxed);
+	sum_.store(0, std::memory_order_relaxed);
+	min_.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+	max_.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * \class MetricHistogram::Timer
+ * \brief Record the lifetime of a scope in a histogram
+ *
+ * The Timer class measures the time elapsed between its construction and
+ * destruction, and records it in the histogram passed to the constructor.
+ */
+
+/**
+ * \fn MetricHistogram::Timer::Timer(MetricHistogram &histogram)
+ * \brief Start measuring a duration
+ * \param[in] histogram The histogram to record the duration in
+ */
+
+/**
+ * \fn MetricHistogram::Timer::~Timer()
+ * \brief Stop measuring the duration and record it
+ */
+
+/**
+ * \var MetricHistogram::kSubBucketBits
+ * \brief Number of bits of the linear part of the bucket index
+ */
+
+/**
+ * \var MetricHistogram::kSubBuckets
+ * \brief Number of linear buckets per power of two
+ */
+
+/**
+ * \var MetricHistogram::kBuckets
+ * \brief Total number of buckets
+ */
+
+/**
+ * \brief Compute the index of the bucket that contains a value
+ * \param[in] value The value
+ * \return The bucket index
+ */
+unsigned int MetricHistogram::bucketIndex(uint64_t value)
+{
+	if (value < kSubBuckets)
+		return value;
+
+	unsigned int exponent = 63 - __builtin_clzll(value);
+	unsigned int sub = (value >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+
+	return (exponent - kSubBucketBits + 1) * kSubBuckets + sub;
+}
+
+/**
+ * \brief Compute the smallest value contained in a bucket
+ * \param[in] index The bucket index
+ * \return The smallest value contained in the bucket
+ */
+uint64_t MetricHistogram::bucketLowerBound(unsigned int index)
+{
+	if (index < kSubBuckets)
+		return index;
+
+	unsigned int exponent = index / kSubBuckets + kSubBucketBits - 1;
+	uint64_t sub = index % kSubBuckets;
+
+	return (kSubBuckets + sub) << (exponent - kSubBucketBits);
+}
+
+/**
+ * \class MetricCounter
+ * \brief A lock-free event counter
+ *
+ * The MetricCounter class counts events. Like MetricHistogram, it registers
+ * itself with the MetricsRegistry, and can be updated concurrently from
+ * multiple threads.
+ */
+
+/**
+ * \brief Construct a counter and register it with the MetricsRegistry
+ * \param[in] name The counter name
+ */
+MetricCounter::MetricCounter(const std::string &name)
+	: name_(name), value_(0)
+{
+	MetricsRegistry::instance()->registerCounter(this);
+}
+
+MetricCounter::~MetricCounter()
+{
+	MetricsRegistry::instance()->unregisterCounter(this);
+}
+
+/**
+ * \fn MetricCounter::name()
+ * \brief Retrieve the counter name
+ * \return The counter name
+ */
+
+/**
+ * \fn MetricCounter::add(uint64_t value)
+ * \brief Increment the counter
+ * \param[in] value The increment
+ *
+ * \context This function is \threadsafe.
+ */
+
+/**
+ * \fn MetricCounter::value()
+ * \brief Retrieve the counter value
+ * \return The counter value
+ */
+
+/**
+ * \fn MetricCounter::reset()
+ * \brief Reset the counter to zero
+ */
+
+/**
+ * \class MetricsRegistry
+ * \brief Registry of all the metrics
+ *
+ * The MetricsRegistry keeps track of all the MetricHistogram and MetricCounter
+ * instances, and provides access to their values. It is a global singleton,
+ * accessed through the instance() function.
+ *
+ * Multiple metrics may share the same name, for instance when multiple
+ * instances of a class each own a histogram. They are reported separately.
+ */
+
+/**
+ * \struct MetricsRegistry::HistogramStats
+ * \brief A snapshot of the statistics of a histogram
+ *
+ * \var MetricsRegistry::HistogramStats::name
+ * \brief The histogram name
+ * \var MetricsRegistry::HistogramStats::count
+ * \brief The number of recorded values
+ * \var MetricsRegistry::HistogramStats::sum
+ * \brief The sum of the recorded values
+ * \var MetricsRegistry::HistogramStats::min
+ * \brief The smallest recorded value
+ * \var MetricsRegistry::HistogramStats::max
+ * \brief The largest recorded value
+ * \var MetricsRegistry::HistogramStats::p50
+ * \brief The estimated median value
+ * \var MetricsRegistry::HistogramStats::p90
+ * \brief The estimated 90th percentile
+ * \var MetricsRegistry::HistogramStats::p99
+ * \brief The estimated 99th percentile
+ */
+
+/**
+ * \struct MetricsRegistry::CounterStats
+ * \brief A snapshot of the value of a counter
+ *
+ * \var MetricsRegistry::CounterStats::name
+ * \brief The counter name
+ * \var MetricsRegistry::CounterStats::value
+ * \brief The counter value
+ */
+
+MetricsRegistry::MetricsRegistry()
+{
+}
+
+MetricsRegistry::~MetricsRegistry()
+{
+}
+
+/**
+ * \brief Retrieve the metrics registry instance
+ * \context This function is \threadsafe.
+ * \return The metrics registry instance
+ */
+MetricsRegistry *MetricsRegistry::instance()
+{
+	static MetricsRegistry registry;
+	return &registry;
+}
+
+/**
+ * \brief Retrieve a snapshot of all histograms
+ *
+ * The histograms are sorted by name.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return The statistics of all the histograms
+ */
+std::vector<MetricsRegistry::HistogramStats> MetricsRegistry::histograms() const
+{
+	std::vector<HistogramStats> stats;
+
+	{
+		MutexLocker locker(mutex_);
+
+		for (const MetricHistogram *histogram : histograms_)
+			stats.push_back({ histogram->name(), histogram->count(),
+					  histogram->sum(), histogram->min(),
+					  histogram->max(), histogram->percentile(50),
+					  histogram->percentile(90),
+					  histogram->percentile(99) });
+	}
+
+	std::stable_sort(stats.begin(), stats.end(),
+			 [](const HistogramStats &a, const HistogramStats &b) {
+				 return a.name < b.name;
+			 });
+
+	return stats;
+}
+
+/**
+ * \brief Retrieve a snapshot of all counters
+ *
+ * The counters are sorted by name.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return The values of all the counters
+ */
+std::vector<MetricsRegistry::CounterStats> MetricsRegistry::counters() const
+{
+	std::vector<CounterStats> stats;
+
+	{
+		MutexLocker locker(mutex_);
+
+		for (const MetricCounter *counter : counters_)
+			stats.push_back({ counter->name(), counter->value() });
+	}
+
+	std::stable_sort(stats.begin(), stats.end(),
+			 [](const CounterStats &a, const CounterStats &b) {
+				 return a.name < b.name;
+			 });
+
+	return stats;
+}
+
+/**
+ * \brief Write a human-readable summary of all metrics to an output stream
+ * \param[in] out The output stream
+ *
+ * Histograms that haven't recorded any value are skipped. Durations are
+ * reported in microseconds.
+ *
+ * \context This function is \threadsafe.
+ */
+void MetricsRegistry::dump(std::ostream &out) const
+{
+	std::vector<HistogramStats> histograms = this->histograms();
+	std::vector<CounterStats> counters = this->counters();
+
+	/*
+	 * Format into a local stream to leave the flags and precision of the
+	 * caller's stream untouched, and write the table in one go.
+	 */
+	std::ostringstream ss;
+
+	ss << std::left << std::setw(48) << "Histogram (us)" << std::right
+	   << std::setw(10) << "count" << std::setw(12) << "mean"
+	   << std::setw(12) << "p50" << std::setw(12) << "p90"
+	   << std::setw(12) << "p99" << std::setw(12) << "max" << std::endl;
+
+	ss << std::fixed << std::setprecision(1);
+
+	for (const HistogramStats &stats : histograms) {
+		if (!stats.count)
+			continue;
+
+		ss << std::left << std::setw(48) << stats.name << std::right
+		   << std::setw(10) << stats.count
+		   << std::setw(12) << stats.sum / stats.count / 1000.0
+		   << std::setw(12) << stats.p50 / 1000.0
+		   << std::setw(12) << stats.p90 / 1000.0
+		   << std::setw(12) << stats.p99 / 1000.0
+		   << std::setw(12) << stats.max / 1000.0 << std::endl;
+	}
+
+	ss << std::endl;
+	ss << std::left << std::setw(48) << "Counter" << std::right
+	   << std::setw(10) << "value" << std::endl;
+
+	for (const CounterStats &stats : counters)
+		ss << std::left << std::setw(48) << stats.name << std::right
+		   << std::setw(10) << stats.value << std::endl;
+
+	out << ss.str();
+}
+
+/**
+ * \brief Reset all metrics
+ *
+ * \context This function is \threadsafe.
+ */
+void MetricsRegistry::reset()
+{
+	MutexLocker locker(mutex_);
+
+	for (MetricHistogram *histogram : histograms_)
+		histogram->reset();
+
+	for (MetricCounter *counter : counters_)
+		counter->reset();
+}
+
+void MetricsRegistry::registerHistogram(MetricHistogram *histogram)
+{
+	MutexLocker locker(mutex_);
+	histograms_.push_back(histogram);
+}
+
+void MetricsRegistry::unregisterHistogram(MetricHistogram *histogram)
+{
+	MutexLocker locker(mutex_);
+	histograms_.erase(std::remove(histograms_.begin(), histograms_.end(),
+				      histogram),
+			  histograms_.end());
+}
+
+void MetricsRegistry::registerCounter(MetricCounter *counter)
+{
+	MutexLocker locker(mutex_);
+	counters_.push_back(counter);
+}
+
+void MetricsRegistry::unregisterCounter(MetricCounter *counter)
+{
+	MutexLocker locker(mutex_);
+	counters_.erase(std::remove(counters_.begin(), counters_.end(), counter),
+			counters_.end());
+}
+
+} /* namespace libcamera */
@@ -8,7 +8,13 @@
 #include <libcamera/base/thread.h>
 
 #include <atomic>
+#include <errno.h>
 #include <list>
+#include <memory>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -17,7 +23,11 @@
 #include <libcamera/base/event_dispatcher_poll.h>
 #include <libcamera/base/log.h>
 #include <libcamera/base/message.h>
+#include <libcamera/base/metrics.h>
 #include <libcamera/base/mutex.h>
+#include <libcamera/base/trace_recorder.h>
+
+#include "libcamera/base/internal/tracepoints.h"
 
 /**
  * \page thread Thread Support
@@ -99,6 +109,31 @@
  * Most classes are reentrant but not thread-safe, as making them fully
  * thread-safe would incur locking costs considered prohibitive for the
  * expected use cases.
+ *
+ * \section thread-scheduling Thread Names and Scheduling
+ *
+ * Threads created by libcamera are named after their role, such as
+ * "CameraManager" for the camera manager thread or "IPA-<module>" for IPA
+ * threads and processes. The names are visible to profiling and debugging
+ * tools.
+ *
+ * The scheduling policy, priority and CPU affinity of libcamera threads can be
+ * configured through the LIBCAMERA_THREAD_CONFIG environment variable, which
+ * maps thread names to scheduling parameters. The variable contains a list of
+ * entries separated by semicolons, each of them formatted as
+ * name=policy[:priority][@cpus]. The name can end with a '*' to match all
+ * threads whose name starts with the given prefix, the policy is one of
+ * "other", "fifo" or "rr", and the CPUs are specified as a comma-separated
+ * list of CPU numbers or ranges. For instance
+ *
+ * \code{.unparsed}
+ * LIBCAMERA_THREAD_CONFIG="CameraManager=fifo:20@2-3;IPA-*=other@0,1"
+ * \endcode
+ *
+ * runs the camera manager thread with the SCHED_FIFO policy at priority 20 on
+ * CPUs 2 and 3, and all IPA threads with the default policy on CPUs 0 and 1.
+ * The configuration takes precedence over the parameters set by libcamera with
+ * Thread::setPriority() and Thread::setAffinity().
  */
 
 /**
@@ -112,6 +147,216 @@ LOG_DEFINE_CATEGORY(Thread)
 
 class ThreadMain;
 
+namespace {
+
+struct ThreadConfig {
+	std::string name;
+	bool prefix = false;
+
+	bool hasPolicy = false;
+	Thread::Policy policy = Thread::Policy::Other;
+	int priority = 0;
+
+	std::vector<unsigned int> cpus;
+};
+
+int schedulingPolicy(Thread::Policy policy)
+{
+	switch (policy) {
+	case Thread::Policy::Fifo:
+		return SCHED_FIFO;
+	case Thread::Policy::RoundRobin:
+		return SCHED_RR;
+	case Thread::Policy::Other:
+	default:
+		return SCHED_OTHER;
+	}
+}
+
+bool parseUnsigned(const std::string &str, unsigned int *value)
+{
+	if (str.empty())
+		return false;
+
+	char *end;
+	unsigned long val = strtoul(str.c_str(), &end, 10);
+	if (*end != '\0')
+		return false;
+
+	*value = val;
+	return true;
+}
+
+bool parseCpus(const std::string &str, std::vector<unsigned int> *cpus)
+{
+	for (const std::string &range : utils::split(str, ",")) {
+		std::string::size_type pos = range.find('-');
+		unsigned int first, last;
+
+		if (!parseUnsigned(range.substr(0, pos), &first))
+			return false;
+
+		last = first;
+		if (pos != std::string::npos &&
+		    !parseUnsigned(range.substr(pos + 1), &last))
+			return false;
+
+		if (last < first || last >= CPU_SETSIZE)
+			return false;
+
+		for (unsigned int cpu = first; cpu <= last; ++cpu)
+			cpus->push_back(cpu);
+	}
+
+	return !cpus->empty();
+}
+
+bool parseThreadConfig(const std::string &entry, ThreadConfig *config)
+{
+	std::string::size_type pos = entry.find('=');
+	if (pos == std::string::npos || pos == 0)
+		return false;
+
+	config->name = entry.substr(0, pos);
+	if (config->name.back() == '*') {
+		config->name.pop_back();
+		config->prefix = true;
+	}
+
+	std::string spec = entry.substr(pos + 1);
+
+	pos = spec.find('@');
+	if (pos != std::string::npos) {
+		if (!parseCpus(spec.substr(pos + 1), &config->cpus))
+			return false;
+
+		spec.erase(pos);
+	}
+
+	if (spec.empty())
+		return true;
+
+	pos = spec.find(':');
+	std::string policy = spec.substr(0, pos);
+
+	if (policy == "other")
+		config->policy = Thread::Policy::Other;
+	else if (policy == "fifo")
+		config->policy = Thread::Policy::Fifo;
+	else if (policy == "rr")
+		config->policy = Thread::Policy::RoundRobin;
+	else
+		return false;
+
+	if (pos != std::string::npos) {
+		unsigned int priority;
+		if (!parseUnsigned(spec.substr(pos + 1), &priority))
+			return false;
+
+		config->priority = priority;
+	}
+
+	config->hasPolicy = true;
+
+	return true;
+}
+
+/*
+ * Parse the LIBCAMERA_THREAD_CONFIG environment variable. This is done once,
+ * the first time a thread is started.
+ */
+const std::vector<ThreadConfig> &threadConfigs()
+{
+	static const std::vector<ThreadConfig> configs = []() {
+		std::vector<ThreadConfig> result;
+
+		const char *env = utils::secure_getenv("LIBCAMERA_THREAD_CONFIG");
+		if (!env)
+			return result;
+
+		for (const std::string &entry : utils::split(env, ";")) {
+			if (entry.empty())
+				continue;
+
+			ThreadConfig config;
+			if (!parseThreadConfig(entry, &config)) {
+				LOG(Thread, Warning)
+					<< "Invalid thread configuration '"
+					<< entry << "'";
+				continue;
+			}
+
+			result.push_back(std::move(config));
+		}
+
+		return result;
+	}();
+
+	return configs;
+}
+
+int setThreadPriority(pthread_t thread, Thread::Policy policy, int priority)
+{
+	struct sched_param param = {};
+	param.sched_priority = priority;
+
+	return -pthread_setschedparam(thread, schedulingPolicy(policy), &param);
+}
+
+int setThreadAffinity(pthread_t thread, const std::vector<unsigned int> &cpus)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	for (unsigned int cpu : cpus)
+		CPU_SET(cpu, &set);
+
+	return -pthread_setaffinity_np(thread, sizeof(set), &set);
+}
+
+void setThreadName(pthread_t thread, const std::string &name)
+{
+	/* Thread names are limited to 16 bytes including the terminating NUL. */
+	pthread_setname_np(thread, name.substr(0, 15).c_str());
+}
+
+/*
+ * Apply the configuration from the LIBCAMERA_THREAD_CONFIG environment
+ * variable to the current thread. The last matching entry wins.
+ */
+void applyThreadConfig(const std::string &name)
+{
+	const ThreadConfig *match = nullptr;
+
+	for (const ThreadConfig &config : threadConfigs()) {
+		if (config.prefix ? name.compare(0, config.name.size(), config.name) == 0
+				  : name == config.name)
+			match = &config;
+	}
+
+	if (!match)
+		return;
+
+	if (match->hasPolicy) {
+		int ret = setThreadPriority(pthread_self(), match->policy,
+					    match->priority);
+		if (ret < 0)
+			LOG(Thread, Warning)
+				<< "Failed to set scheduling policy of thread "
+				<< name << ": " << strerror(-ret);
+	}
+
+	if (!match->cpus.empty()) {
+		int ret = setThreadAffinity(pthread_self(), match->cpus);
+		if (ret < 0)
+			LOG(Thread, Warning)
+				<< "Failed to set CPU affinity of thread "
+				<< name << ": " << strerror(-ret);
+	}
+}
+
+} /* namespace */
+
 /**
  * \brief A queue of posted messages
  */
@@ -140,7 +385,8 @@ class ThreadData
 {
 public:
 	ThreadData()
-		: thread_(nullptr), running_(false), dispatcher_(nullptr)
+		: thread_(nullptr), running_(false), dispatcher_(nullptr),
+		  hasPolicy_(false), policy_(Thread::Policy::Other), priority_(0)
 	{
 	}
 
@@ -163,6 +409,12 @@ private:
 	int exitCode_;
 
 	MessageQueue messages_;
+	std::unique_ptr<MetricHistogram> messageWait_;
+
+	bool hasPolicy_;
+	Thread::Policy policy_;
+	int priority_;
+	std::vector<unsigned int> cpus_;
 };
 
 /**
@@ -172,6 +424,7 @@ class ThreadMain : public Thread
 {
 public:
 	ThreadMain()
+		: Thread("main")
 	{
 		data_->running_ = true;
 	}
@@ -259,13 +512,34 @@ ThreadData *ThreadData::current()
  * deleted without being processed when the Thread instance is destroyed.
  */
 
+/**
+ * \enum Thread::Policy
+ * \brief Thread scheduling policy
+ * \var Thread::Policy::Other
+ * \brief The default time-sharing policy (SCHED_OTHER)
+ * \var Thread::Policy::Fifo
+ * \brief The first-in first-out real-time policy (SCHED_FIFO)
+ * \var Thread::Policy::RoundRobin
+ * \brief The round-robin real-time policy (SCHED_RR)
+ */
+
 /**
  * \brief Create a thread
+ * \param[in] name The thread name
+ *
+ * The \a name identifies the role of the thread. It is set as the name of the
+ * underlying system thread when the thread starts, truncated to 15 characters,
+ * and selects the scheduling configuration from the LIBCAMERA_THREAD_CONFIG
+ * environment variable (see \ref thread-scheduling).
  */
-Thread::Thread()
+Thread::Thread(const std::string &name)
+	: name_(name)
 {
 	data_ = new ThreadData;
 	data_->thread_ = this;
+	data_->messageWait_ = std::make_unique<MetricHistogram>(
+		"thread." + (name.empty() ? std::string("unnamed") : name) +
+		".message_wait");
 }
 
 Thread::~Thread()
@@ -316,9 +590,47 @@ void Thread::startThread()
 	data_->tid_ = syscall(SYS_gettid);
 	currentThreadData = data_;
 
+	applySettings();
+
 	run();
 }
 
+/*
+ * Apply the thread name and scheduling parameters to the current thread, when
+ * the thread starts.
+ */
+void Thread::applySettings()
+{
+	pthread_t self = pthread_self();
+
+	if (!name_.empty())
+		setThreadName(self, name_);
+
+	{
+		MutexLocker locker(data_->mutex_);
+
+		if (data_->hasPolicy_) {
+			int ret = setThreadPriority(self, data_->policy_,
+						    data_->priority_);
+			if (ret < 0)
+				LOG(Thread, Warning)
+					<< "Failed to set scheduling policy of thread "
+					<< name_ << ": " << strerror(-ret);
+		}
+
+		if (!data_->cpus_.empty()) {
+			int ret = setThreadAffinity(self, data_->cpus_);
+			if (ret < 0)
+				LOG(Thread, Warning)
+					<< "Failed to set CPU affinity of thread "
+					<< name_ << ": " << strerror(-ret);
+		}
+	}
+
+	if (!name_.empty())
+		applyThreadConfig(name_);
+}
+
 /**
  * \brief Enter the event loop
  *
@@ -452,6 +764,90 @@ bool Thread::isRunning()
 	return data_->running_;
 }
 
+/**
+ * \fn Thread::name()
+ * \brief Retrieve the thread name
+ * \return The thread name
+ */
+
+/**
+ * \brief Set the scheduling policy and priority of the thread
+ * \param[in] policy The scheduling policy
+ * \param[in] priority The static scheduling priority
+ *
+ * The \a priority must be in the range of priorities supported by the
+ * \a policy, which is [1, 99] for the real-time policies on Linux, and 0 for
+ * the Policy::Other policy. Real-time policies require appropriate
+ * privileges.
+ *
+ * If the thread is running and this function is called from the thread itself
+ * or the thread has been started with start(), the parameters are applied
+ * immediately. They are also recorded and applied every time the thread is
+ * started.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -EINVAL The priority is out of range for the policy
+ * \retval -EPERM The caller doesn't have the privileges to set the policy
+ */
+int Thread::setPriority(Policy policy, int priority)
+{
+	int sched = schedulingPolicy(policy);
+	if (priority < sched_get_priority_min(sched) ||
+	    priority > sched_get_priority_max(sched))
+		return -EINVAL;
+
+	MutexLocker locker(data_->mutex_);
+
+	data_->hasPolicy_ = true;
+	data_->policy_ = policy;
+	data_->priority_ = priority;
+
+	if (thread_.joinable() && data_->running_)
+		return setThreadPriority(thread_.native_handle(), policy, priority);
+	if (Thread::current() == this)
+		return setThreadPriority(pthread_self(), policy, priority);
+
+	return 0;
+}
+
+/**
+ * \brief Set the CPU affinity of the thread
+ * \param[in] cpus The CPUs the thread is allowed to run on
+ *
+ * Restrict the thread to run on the \a cpus. An empty list resets the affinity
+ * to all CPUs available to the process when the thread is next started.
+ *
+ * The affinity is applied with the same rules as setPriority().
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return 0 on success or a negative error code otherwise
+ * \retval -EINVAL None of the \a cpus is available
+ */
+int Thread::setAffinity(const std::vector<unsigned int> &cpus)
+{
+	for (unsigned int cpu : cpus) {
+		if (cpu >= CPU_SETSIZE)
+			return -EINVAL;
+	}
+
+	MutexLocker locker(data_->mutex_);
+
+	data_->cpus_ = cpus;
+
+	if (cpus.empty())
+		return 0;
+
+	if (thread_.joinable() && data_->running_)
+		return setThreadAffinity(thread_.native_handle(), cpus);
+	if (Thread::current() == this)
+		return setThreadAffinity(pthread_self(), cpus);
+
+	return 0;
+}
+
 /**
  * \var Thread::finished
  * \brief Signal the end of thread execution
@@ -484,6 +880,23 @@ pid_t Thread::currentId()
 	return data->tid_;
 }
 
+/**
+ * \brief Name and configure the current thread
+ * \param[in] name The thread name
+ *
+ * This function sets the name of the current thread and applies the scheduling
+ * configuration from the LIBCAMERA_THREAD_CONFIG environment variable for the
+ * \a name. It is meant to be used by threads that are not managed by the
+ * Thread class, such as threads created with std::thread or the main thread of
+ * IPA proxy worker processes. Threads managed by the Thread class are
+ * configured automatically when started.
+ */
+void Thread::configureCurrent(const std::string &name)
+{
+	setThreadName(pthread_self(), name);
+	applyThreadConfig(name);
+}
+
 /**
  * \brief Retrieve the event dispatcher
  *
@@ -519,6 +932,9 @@ EventDispatcher *Thread::eventDispatcher()
  * When the thread is stopped, posted messages may not have all been processed.
  * See \ref thread-stop for additional information.
  *
+ * The time spent by messages in the queue is recorded in the
+ * "thread.<name>.message_wait" histogram of the MetricsRegistry.
+ *
  * If the \a receiver is not bound to this thread the behaviour is undefined.
  *
  * \context This function is \threadsafe.
@@ -528,9 +944,12 @@ EventDispatcher *Thread::eventDispatcher()
 void Thread::postMessage(std::unique_ptr<Message> msg, Object *receiver)
 {
 	msg->receiver_ = receiver;
+	msg->timestamp_ = utils::clock::now();
 
 	ASSERT(data_ == receiver->thread()->data_);
 
+	LIBCAMERA_BASE_TRACEPOINT(thread_message_post, this, msg.get());
+
 	MutexLocker locker(data_->messages_.mutex_);
 	data_->messages_.list_.push_back(std::move(msg));
 	receiver->pendingMessages_++;
@@ -624,7 +1043,14 @@ void Thread::dispatchMessages(Message::Type type)
 		receiver->pendingMessages_--;
 
 		locker.unlock();
-		receiver->message(message.get());
+		data_->messageWait_->record(utils::clock::now() - message->timestamp_);
+		LIBCAMERA_BASE_TRACEPOINT(thread_message_dispatch, this, message.get());
+
+		{
+			LIBCAMERA_TRACE_SCOPE("thread.message_dispatch");
+			receiver->message(message.get());
+		}
+
 		message.reset();
 		locker.lock();
 	}
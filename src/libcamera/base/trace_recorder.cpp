@@ -0,0 +1,566 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * trace_recorder.cpp - In-process trace event recorder
+ */
+
+#include <libcamera/base/trace_recorder.h>
+
+#include <errno.h>
+#include <fstream>
+#include <iomanip>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <libcamera/base/log.h>
+
+/**
+ * \file base/trace_recorder.h
+ * \brief In-process trace event recorder
+ *
+ * The trace recorder is an alternative tracing backend that doesn't depend on
+ * lttng. It records trace events in memory and writes them in the Chrome JSON
+ * trace event format, which can be visualized with Perfetto
+ * (https://ui.perfetto.dev) or chrome://tracing.
+ *
+ * The recorder is disabled by default, and is enabled at runtime by setting the
+ * LIBCAMERA_TRACE_FILE environment variable to the path of the output file.
+ * When disabled, recording an event only costs an atomic load.
+ */
+
+/**
+ * \def LIBCAMERA_TRACE_SCOPE
+ * \brief Record the duration of the enclosing scope in the trace recorder
+ * \param[in] name The event name, a string literal
+ *
+ * This macro creates a TraceRecorder::Scope object that records a duration
+ * event spanning until the end of the enclosing scope.
+ */
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(Trace)
+
+/*
+ * Each thread records events to its own buffer, allocated on the first event
+ * recorded by the thread, without any locking. Buffers are owned by the
+ * recorder and outlive their thread, to allow writing the trace at any time.
+ * When a buffer is full, further events from the thread are dropped. String
+ * arguments longer than the storage of an argument are truncated, and counted.
+ */
+struct TraceRecorder::Buffer {
+	pid_t tid;
+	char name[16];
+
+	std::unique_ptr<Event[]> events;
+	unsigned int capacity;
+	std::atomic<unsigned int> count;
+	std::atomic<uint64_t> dropped;
+	std::atomic<uint64_t> truncated;
+};
+
+/**
+ * \class TraceRecorder
+ * \brief Record trace events in memory and write them as Chrome JSON traces
+ *
+ * The TraceRecorder class records instant events, duration events and scoped
+ * events to per-thread buffers. Recording is lock-free: each thread appends
+ * events to its own preallocated buffer, and publishes them with an atomic
+ * store. The buffers are sized by the LIBCAMERA_TRACE_BUFFER_SIZE environment
+ * variable, in number of events, and default to 16384 events per thread.
+ *
+ * The recorder is a global singleton, accessed through the instance() function.
+ * It is enabled when the LIBCAMERA_TRACE_FILE environment variable is set, in
+ * which case the trace is written to the file when the CameraManager is
+ * stopped and when the process exits. It can also be controlled manually with
+ * the start(), stop() and write() functions.
+ *
+ * The names, categories and argument names of events are stored as pointers,
+ * and must thus be string literals or otherwise outlive the recorder.
+ *
+ * The LIBCAMERA_TRACEPOINT() macros record their events to the trace recorder
+ * when it is enabled, in addition to lttng when libcamera is compiled with
+ * tracing support.
+ */
+
+/**
+ * \var TraceRecorder::kMaxArgs
+ * \brief The maximum number of arguments of an event
+ */
+
+/**
+ * \struct TraceRecorder::Arg
+ * \brief An event argument
+ *
+ * \var TraceRecorder::Arg::type
+ * \brief The argument type
+ * \var TraceRecorder::Arg::i
+ * \brief The value of a signed integer argument
+ * \var TraceRecorder::Arg::u
+ * \brief The value of an unsigned integer or pointer argument
+ * \var TraceRecorder::Arg::d
+ * \brief The value of a floating point argument
+ * \var TraceRecorder::Arg::s
+ * \brief The value of a string argument, truncated to 15 characters
+ *
+ * String arguments are copied to the event to avoid lifetime issues, in a
+ * fixed-size field to keep recording allocation-free. Longer strings are
+ * truncated, a warning is logged the first time this happens, and the number
+ * of truncated arguments is reported in the trace metadata.
+ */
+
+/**
+ * \enum TraceRecorder::Arg::Type
+ * \brief The argument type
+ * \var TraceRecorder::Arg::Int
+ * \brief A signed integer or enumeration
+ * \var TraceRecorder::Arg::UInt
+ * \brief An unsigned integer
+ * \var TraceRecorder::Arg::Double
+ * \brief A floating point number
+ * \var TraceRecorder::Arg::Pointer
+ * \brief A pointer, reported as an hexadecimal value
+ * \var TraceRecorder::Arg::String
+ * \brief A string
+ */
+
+/**
+ * \struct TraceRecorder::Event
+ * \brief A recorded event
+ *
+ * \var TraceRecorder::Event::name
+ * \brief The event name
+ * \var TraceRecorder::Event::category
+ * \brief The event category
+ * \var TraceRecorder::Event::argNames
+ * \brief The argument names, or nullptr to use default names
+ * \var TraceRecorder::Event::timestamp
+ * \brief The event timestamp, in nanoseconds
+ * \var TraceRecorder::Event::value
+ * \brief The event duration in nanoseconds, for complete events
+ * \var TraceRecorder::Event::phase
+ * \brief The event type, as a Chrome trace event phase character
+ * \var TraceRecorder::Event::numArgs
+ * \brief The number of arguments
+ * \var TraceRecorder::Event::args
+ * \brief The event arguments
+ */
+
+/**
+ * \class TraceRecorder::Scope
+ * \brief Record the duration of a scope as a complete event
+ *
+ * The Scope class records a complete event spanning from its construction to
+ * its destruction, if the trace recorder is enabled at construction time. It
+ * is usually instantiated through the LIBCAMERA_TRACE_SCOPE() macro.
+ */
+
+/**
+ * \fn TraceRecorder::Scope::Scope(const char *name)
+ * \brief Start recording a scope
+ * \param[in] name The event name
+ */
+
+/**
+ * \fn TraceRecorder::Scope::~Scope()
+ * \brief Stop recording the scope and record the event
+ */
+
+std::atomic<bool> TraceRecorder::enabled_ = false;
+thread_local TraceRecorder::Buffer *TraceRecorder::currentBuffer_ = nullptr;
+
+namespace {
+
+/*
+ * Create the recorder when the library is loaded, to enable it from the
+ * environment before any event is recorded.
+ */
+[[maybe_unused]] const TraceRecorder *const recorder = TraceRecorder::instance();
+
+void writeString(std::ostream &out, const char *str)
+{
+	out << '"';
+
+	for (; *str; ++str) {
+		unsigned char c = *str;
+
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (c < 0x20)
+			out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+			    << static_cast<unsigned int>(c) << std::dec;
+		else
+			out << c;
+	}
+
+	out << '"';
+}
+
+} /* namespace */
+
+TraceRecorder::TraceRecorder()
+	: capacity_(16384)
+{
+	const char *size = utils::secure_getenv("LIBCAMERA_TRACE_BUFFER_SIZE");
+	if (size) {
+		unsigned long value = strtoul(size, nullptr, 10);
+		if (value)
+			capacity_ = value;
+	}
+
+	const char *path = utils::secure_getenv("LIBCAMERA_TRACE_FILE");
+	if (path && *path) {
+		path_ = path;
+		start();
+	}
+}
+
+TraceRecorder::~TraceRecorder()
+{
+	stop();
+
+	/*
+	 * The logger may already have been destroyed when the recorder is
+	 * destroyed at exit, write the trace without logging errors.
+	 */
+	if (!path_.empty()) {
+		std::ofstream file(path_);
+		if (file)
+			write(file);
+	}
+}
+
+/**
+ * \brief Retrieve the trace recorder instance
+ * \context This function is \threadsafe.
+ * \return The trace recorder instance
+ */
+TraceRecorder *TraceRecorder::instance()
+{
+	static TraceRecorder recorder;
+	return &recorder;
+}
+
+/**
+ * \fn TraceRecorder::enabled()
+ * \brief Check if the trace recorder is enabled
+ * \context This function is \threadsafe.
+ * \return True if events are being recorded, false otherwise
+ */
+
+/**
+ * \brief Start recording events
+ *
+ * \context This function is \threadsafe.
+ */
+void TraceRecorder::start()
+{
+	enabled_.store(true, std::memory_order_relaxed);
+}
+
+/**
+ * \brief Stop recording events
+ *
+ * Events recorded so far are retained and can be written with write().
+ *
+ * \context This function is \threadsafe.
+ */
+void TraceRecorder::stop()
+{
+	enabled_.store(false, std::memory_order_relaxed);
+}
+
+/**
+ * \fn TraceRecorder::record()
+ * \brief Record an instant event
+ * \param[in] category The event category
+ * \param[in] name The event name
+ * \param[in] argNames The names of the arguments, or nullptr
+ * \param[in] args The event arguments
+ *
+ * Record an instant event with up to kMaxArgs arguments. Arguments can be
+ * integers, enumerations, floating point numbers, pointers or strings. Strings
+ * are copied and truncated to 15 characters, see TraceRecorder::Arg::s.
+ *
+ * \context This function is \threadsafe.
+ */
+
+/**
+ * \brief Record the beginning of a duration event
+ * \param[in] category The event category
+ * \param[in] name The event name
+ *
+ * Duration events shall be ended with end() in the same thread, and shall be
+ * properly nested.
+ *
+ * \context This function is \threadsafe.
+ */
+void TraceRecorder::begin(const char *category, const char *name)
+{
+	Event *event = reserve();
+	if (!event)
+		return;
+
+	*event = { name, category, nullptr,
+		   timestamp(utils::clock::now()), 0, 'B', 0, {} };
+	commit();
+}
+
+/**
+ * \brief Record the end of a duration event
+ * \param[in] category The event category
+ * \param[in] name The event name
+ *
+ * \context This function is \threadsafe.
+ */
+void TraceRecorder::end(const char *category, const char *name)
+{
+	Event *event = reserve();
+	if (!event)
+		return;
+
+	*event = { name, category, nullptr,
+		   timestamp(utils::clock::now()), 0, 'E', 0, {} };
+	commit();
+}
+
+/**
+ * \brief Record a complete event
+ * \param[in] name The event name
+ * \param[in] start The event start time
+ * \param[in] end The event end time
+ *
+ * \context This function is \threadsafe.
+ */
+void TraceRecorder::complete(const char *name, utils::time_point start,
+			     utils::time_point end)
+{
+	Event *event = reserve();
+	if (!event)
+		return;
+
+	uint64_t begin = timestamp(start);
+	*event = { name, "libcamera", nullptr, begin,
+		   timestamp(end) - begin, 'X', 0, {} };
+	commit();
+}
+
+/**
+ * \brief Write the recorded events in the Chrome JSON trace event format
+ * \param[in] out The output stream
+ *
+ * Events may be recorded concurrently, in which case the trace contains a
+ * subset of them.
+ *
+ * \context This function is \threadsafe.
+ */
+void TraceRecorder::write(std::ostream &out) const
+{
+	MutexLocker locker(mutex_);
+
+	pid_t pid = getpid();
+	uint64_t dropped = 0;
+	uint64_t truncated = 0;
+	bool first = true;
+
+	std::ios_base::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	char fill = out.fill();
+	out << std::fixed << std::setprecision(3);
+
+	out << "{\"traceEvents\":[";
+
+	for (const std::unique_ptr<Buffer> &buffer : buffers_) {
+		out << (first ? "" : ",")
+		    << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+		    << ",\"tid\":" << buffer->tid << ",\"args\":{\"name\":";
+		writeString(out, buffer->name);
+		out << "}}";
+		first = false;
+
+		unsigned int count = buffer->count.load(std::memory_order_acquire);
+		dropped += buffer->dropped.load(std::memory_order_relaxed);
+		truncated += buffer->truncated.load(std::memory_order_relaxed);
+
+		for (unsigned int i = 0; i < count; ++i) {
+			const Event &event = buffer->events[i];
+
+			out << ",\n{\"name\":";
+			writeString(out, event.name);
+			out << ",\"cat\":";
+			writeString(out, event.category);
+			out << ",\"ph\":\"" << event.phase << "\",\"ts\":"
+			    << event.timestamp / 1000.0 << ",\"pid\":" << pid
+			    << ",\"tid\":" << buffer->tid;
+
+			if (event.phase == 'X')
+				out << ",\"dur\":" << event.value / 1000.0;
+			else if (event.phase == 'i')
+				out << ",\"s\":\"t\"";
+
+			if (event.numArgs) {
+				out << ",\"args\":{";
+
+				for (unsigned int j = 0; j < event.numArgs; ++j) {
+					const Arg &arg = event.args[j];
+
+					if (j)
+						out << ",";
+
+					if (event.argNames)
+						writeString(out, event.argNames[j]);
+					else
+						out << "\"arg" << j << "\"";
+					out << ":";
+
+					switch (arg.type) {
+					case Arg::Int:
+						out << arg.i;
+						break;
+					case Arg::UInt:
+						out << arg.u;
+						break;
+					case Arg::Double:
+						out << arg.d;
+						break;
+					case Arg::Pointer:
+						out << "\"0x" << std::hex << arg.u
+						    << std::dec << "\"";
+						break;
+					case Arg::String:
+						writeString(out, arg.s);
+						break;
+					}
+				}
+
+				out << "}";
+			}
+
+			out << "}";
+		}
+	}
+
+	out << "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{\"truncated_strings\":"
+	    << truncated << ",\"dropped_events\":" << dropped << "}}" << std::endl;
+
+	out.flags(flags);
+	out.precision(precision);
+	out.fill(fill);
+}
+
+/**
+ * \brief Write the recorded events to a file
+ * \param[in] path The file path
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return 0 on success or a negative error code otherwise
+ */
+int TraceRecorder::write(const std::string &path) const
+{
+	std::ofstream file(path);
+	if (!file) {
+		LOG(Trace, Error) << "Failed to open trace file " << path;
+		return -EIO;
+	}
+
+	write(file);
+
+	return file ? 0 : -EIO;
+}
+
+/**
+ * \brief Write the recorded events to the LIBCAMERA_TRACE_FILE file
+ *
+ * This function writes the trace to the file specified by the
+ * LIBCAMERA_TRACE_FILE environment variable, if set. It is a no-op otherwise.
+ *
+ * \context This function is \threadsafe.
+ */
+void TraceRecorder::flush() const
+{
+	if (!path_.empty())
+		write(path_);
+}
+
+TraceRecorder::Event *TraceRecorder::reserve()
+{
+	if (!enabled())
+		return nullptr;
+
+	Buffer *buffer = currentBuffer_;
+	if (!buffer)
+		buffer = createBuffer();
+
+	unsigned int count = buffer->count.load(std::memory_order_relaxed);
+	if (count >= buffer->capacity) {
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	return &buffer->events[count];
+}
+
+void TraceRecorder::commit()
+{
+	/* Publish the event written to the slot returned by reserve(). */
+	currentBuffer_->count.fetch_add(1, std::memory_order_release);
+}
+
+TraceRecorder::Buffer *TraceRecorder::createBuffer()
+{
+	std::unique_ptr<Buffer> buffer = std::make_unique<Buffer>();
+
+	buffer->tid = syscall(SYS_gettid);
+	memset(buffer->name, 0, sizeof(buffer->name));
+	prctl(PR_GET_NAME, buffer->name);
+
+	buffer->events = std::make_unique<Event[]>(capacity_);
+	buffer->capacity = capacity_;
+	buffer->count.store(0, std::memory_order_relaxed);
+	buffer->dropped.store(0, std::memory_order_relaxed);
+	buffer->truncated.store(0, std::memory_order_relaxed);
+
+	currentBuffer_ = buffer.get();
+
+	MutexLocker locker(mutex_);
+	buffers_.push_back(std::move(buffer));
+
+	return currentBuffer_;
+}
+
+uint64_t TraceRecorder::timestamp(utils::time_point time)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		time.time_since_epoch()).count();
+}
+
+void TraceRecorder::convertString(const char *value, Arg *arg)
+{
+	static std::atomic<bool> warned = false;
+
+	if (!value)
+		value = "";
+
+	strncpy(arg->s, value, sizeof(arg->s) - 1);
+	arg->s[sizeof(arg->s) - 1] = '\0';
+
+	if (strnlen(value, sizeof(arg->s)) < sizeof(arg->s))
+		return;
+
+	/* Called from record(), after reserve() has set the current buffer. */
+	currentBuffer_->truncated.fetch_add(1, std::memory_order_relaxed);
+
+	if (!warned.exchange(true, std::memory_order_relaxed))
+		LOG(Trace, Warning)
+			<< "Trace string argument '" << value
+			<< "' truncated to " << sizeof(arg->s) - 1
+			<< " characters, further truncations are only counted";
+}
+
+} /* namespace libcamera */
@@ -7,13 +7,16 @@
 
 #include <libcamera/camera_manager.h>
 
+#include <fstream>
 #include <map>
 
 #include <libcamera/camera.h>
 
 #include <libcamera/base/log.h>
+#include <libcamera/base/metrics.h>
 #include <libcamera/base/mutex.h>
 #include <libcamera/base/thread.h>
+#include <libcamera/base/trace_recorder.h>
 #include <libcamera/base/utils.h>
 
 #include "libcamera/internal/device_enumerator.h"
@@ -74,7 +77,7 @@ private:
 };
 
 CameraManager::Private::Private()
-	: initialized_(false)
+	: Thread("CameraManager"), initialized_(false)
 {
 }
 
@@ -309,12 +312,31 @@ int CameraManager::start()
  * After the manager has been stopped no resource provided by the camera
  * manager should be consider valid or functional even if they for one
  * reason or another have yet to be deleted.
+ *
+ * If the LIBCAMERA_METRICS_FILE environment variable is set, a summary of the
+ * MetricsRegistry content is written to the file it names. Similarly, events
+ * recorded by the TraceRecorder are flushed to the LIBCAMERA_TRACE_FILE file.
  */
 void CameraManager::stop()
 {
 	Private *const d = _d();
 	d->exit();
 	d->wait();
+
+	TraceRecorder::instance()->flush();
+
+	const char *metricsFile = utils::secure_getenv("LIBCAMERA_METRICS_FILE");
+	if (!metricsFile)
+		return;
+
+	std::ofstream file(metricsFile);
+	if (!file) {
+		LOG(Camera, Error)
+			<< "Failed to open metrics file " << metricsFile;
+		return;
+	}
+
+	MetricsRegistry::instance()->dump(file);
 }
 
 /**
@@ -11,6 +11,7 @@
 
 #include <libcamera/controls.h>
 
+#include "libcamera/internal/tracepoints.h"
 #include "libcamera/internal/v4l2_device.h"
 
 /**
@@ -182,6 +183,9 @@ bool DelayedControls::push(const ControlList &controls)
 			<< " at index " << queueCount_;
 	}
 
+	LIBCAMERA_TRACEPOINT(delayed_controls_push, this, queueCount_,
+			     controls.size());
+
 	queueCount_++;
 
 	return true;
@@ -287,6 +291,9 @@ void DelayedControls::applyControls(uint32_t sequence)
 		push({});
 	}
 
+	LIBCAMERA_TRACEPOINT(delayed_controls_apply, this, sequence, writeCount_,
+			     out.size());
+
 	device_->setControls(&out);
 }
 
@@ -194,6 +194,45 @@ FrameBuffer::Private::~Private()
  * indicate that the metadata is invalid.
  */
 
+/**
+ * \brief Retrieve a cached CPU mapping of the frame buffer
+ * \param[in] flags The mapping access mode
+ *
+ * Mapping a frame buffer to the CPU address space requires multiple system
+ * calls, and unmapping it invalidates the TLB of the CPUs. This function
+ * creates a mapping of the frame buffer with the access mode \a flags the
+ * first time it is called, and returns the same mapping on subsequent calls,
+ * avoiding the mapping cost for every frame. The mappings are destroyed with
+ * the frame buffer.
+ *
+ * CPU accesses to the mapped memory shall be bracketed with calls to
+ * MappedFrameBuffer::beginCpuAccess() and MappedFrameBuffer::endCpuAccess(),
+ * or with a MappedFrameBuffer::CpuAccess instance.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return The mapping, or nullptr if the frame buffer can't be mapped
+ */
+const MappedFrameBuffer *FrameBuffer::Private::map(MappedFrameBuffer::MapFlags flags) const
+{
+	unsigned int index = static_cast<MappedFrameBuffer::MapFlags::Type>(flags) - 1;
+	ASSERT(index < mappings_.size());
+
+	MutexLocker locker(mappingsMutex_);
+
+	std::unique_ptr<MappedFrameBuffer> &mapping = mappings_[index];
+	if (!mapping) {
+		auto mapped = std::make_unique<MappedFrameBuffer>(LIBCAMERA_O_PTR(),
+								  flags);
+		if (!mapped->isValid())
+			return nullptr;
+
+		mapping = std::move(mapped);
+	}
+
+	return mapping.get();
+}
+
 /**
  * \class FrameBuffer
  * \brief Frame buffer data and its associated dynamic metadata
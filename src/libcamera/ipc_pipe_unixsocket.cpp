@@ -17,6 +17,7 @@
 #include "libcamera/internal/ipc_pipe.h"
 #include "libcamera/internal/ipc_unixsocket.h"
 #include "libcamera/internal/process.h"
+#include "libcamera/internal/tracepoints.h"
 
 using namespace std::chrono_literals;
 
@@ -61,6 +62,9 @@ int IPCPipeUnixSocket::sendSync(const IPCMessage &in, IPCMessage *out)
 {
 	IPCUnixSocket::Payload response;
 
+	LIBCAMERA_TRACEPOINT(ipc_send_sync, in.header().cmd, in.header().cookie,
+			     in.data().size(), in.fds().size());
+
 	int ret = call(in.payload(), &response, in.header().cookie);
 	if (ret) {
 		LOG(IPCPipe, Error) << "Failed to call sync";
@@ -75,6 +79,10 @@ int IPCPipeUnixSocket::sendSync(const IPCMessage &in, IPCMessage *out)
 
 int IPCPipeUnixSocket::sendAsync(const IPCMessage &data)
 {
+	LIBCAMERA_TRACEPOINT(ipc_send_async, data.header().cmd,
+			     data.header().cookie, data.data().size(),
+			     data.fds().size());
+
 	int ret = socket_->send(data.payload());
 	if (ret) {
 		LOG(IPCPipe, Error) << "Failed to call async";
@@ -101,6 +109,10 @@ void IPCPipeUnixSocket::readyRead()
 
 	IPCMessage ipcMessage(payload);
 
+	LIBCAMERA_TRACEPOINT(ipc_receive, ipcMessage.header().cmd,
+			     ipcMessage.header().cookie, ipcMessage.data().size(),
+			     ipcMessage.fds().size());
+
 	auto callData = callData_.find(ipcMessage.header().cookie);
 	if (callData != callData_.end()) {
 		*callData->second.response = std::move(payload);
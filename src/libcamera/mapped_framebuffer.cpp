@@ -9,7 +9,9 @@
 
 #include <algorithm>
 #include <errno.h>
+#include <linux/dma-buf.h>
 #include <map>
+#include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
@@ -150,6 +152,39 @@ MappedBuffer::~MappedBuffer()
 /**
  * \class MappedFrameBuffer
  * \brief Map a FrameBuffer using the MappedBuffer interface
+ *
+ * Creating a MappedFrameBuffer maps the planes of the frame buffer to the CPU
+ * address space, and destroying it unmaps them. As these operations are
+ * costly, components that need CPU access to the same buffers repeatedly
+ * should use the mappings cached by the frame buffer, retrieved with
+ * FrameBuffer::Private::map(), instead of creating a MappedFrameBuffer for
+ * every frame.
+ *
+ * Accesses to the mapped memory by the CPU shall be bracketed with calls to
+ * beginCpuAccess() and endCpuAccess() to ensure cache coherency with the
+ * devices that access the buffer, or with a MappedFrameBuffer::CpuAccess
+ * instance.
+ */
+
+/**
+ * \class MappedFrameBuffer::CpuAccess
+ * \brief Bracket CPU accesses to a MappedFrameBuffer
+ *
+ * The CpuAccess class calls MappedFrameBuffer::beginCpuAccess() when
+ * constructed and MappedFrameBuffer::endCpuAccess() when destroyed, to ensure
+ * cache coherency of the CPU accesses to the buffer memory performed during
+ * its lifetime.
+ */
+
+/**
+ * \fn MappedFrameBuffer::CpuAccess::CpuAccess()
+ * \brief Begin CPU access to the \a buffer
+ * \param[in] buffer The mapped buffer
+ */
+
+/**
+ * \fn MappedFrameBuffer::CpuAccess::~CpuAccess()
+ * \brief End CPU access to the buffer
  */
 
 /**
@@ -178,6 +213,7 @@ MappedBuffer::~MappedBuffer()
  * the MapFlag flags accordingly.
  */
 MappedFrameBuffer::MappedFrameBuffer(const FrameBuffer *buffer, MapFlags flags)
+	: flags_(flags)
 {
 	ASSERT(!buffer->planes().empty());
 	planes_.reserve(buffer->planes().size());
@@ -234,10 +270,71 @@ MappedFrameBuffer::MappedFrameBuffer(const FrameBuffer *buffer, MapFlags flags)
 
 			info.address = static_cast<uint8_t *>(address);
 			maps_.emplace_back(info.address, info.mapLength);
+			fds_.push_back(plane.fd);
 		}
 
 		planes_.emplace_back(info.address + plane.offset, plane.length);
 	}
 }
 
+/**
+ * \brief Prepare the buffer memory for access by the CPU
+ *
+ * This function synchronizes the CPU caches with the memory of the dmabufs
+ * backing the frame buffer, for the access mode specified when creating the
+ * mapping. It shall be called before the CPU accesses the mapped memory, and
+ * be paired with a call to endCpuAccess().
+ *
+ * Frame buffers that are not backed by dmabufs don't need synchronization,
+ * this function is a no-op for them.
+ *
+ * \return 0 on success or a negative error code otherwise
+ */
+int MappedFrameBuffer::beginCpuAccess() const
+{
+	return sync(DMA_BUF_SYNC_START);
+}
+
+/**
+ * \brief Complete access to the buffer memory by the CPU
+ *
+ * This function completes the CPU access started by beginCpuAccess(), flushing
+ * the CPU caches if the buffer has been mapped for writing.
+ *
+ * \return 0 on success or a negative error code otherwise
+ */
+int MappedFrameBuffer::endCpuAccess() const
+{
+	return sync(DMA_BUF_SYNC_END);
+}
+
+int MappedFrameBuffer::sync(uint64_t flags) const
+{
+	struct dma_buf_sync sync = {};
+	sync.flags = flags;
+
+	if (flags_ & MapFlag::Read)
+		sync.flags |= DMA_BUF_SYNC_READ;
+	if (flags_ & MapFlag::Write)
+		sync.flags |= DMA_BUF_SYNC_WRITE;
+
+	for (const SharedFD &fd : fds_) {
+		int ret;
+
+		do {
+			ret = ioctl(fd.get(), DMA_BUF_IOCTL_SYNC, &sync);
+		} while (ret && (errno == EINTR || errno == EAGAIN));
+
+		/* Memory that isn't backed by a dmabuf needs no sync. */
+		if (ret && errno != ENOTTY) {
+			ret = -errno;
+			LOG(Buffer, Error) << "Failed to sync buffer: "
+					   << strerror(-ret);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
 } /* namespace libcamera */
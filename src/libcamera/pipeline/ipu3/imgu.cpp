@@ -53,13 +53,11 @@ const std::vector<float> gdcScalingFactors = {
 	14.25, 14.5, 14.75, 15, 15.25, 15.5, 15.75, 16,
 };
 
-std::vector<ImgUDevice::PipeConfig> pipeConfigs;
-
 struct FOV {
 	float w;
 	float h;
 
-	bool isLarger(const FOV &other)
+	bool isLarger(const FOV &other) const
 	{
 		if (w > other.w)
 			return true;
@@ -105,15 +103,17 @@ bool isSameRatio(const Size &in, const Size &out)
 	return true;
 }
 
-void calculateBDSHeight(ImgUDevice::Pipe *pipe, const Size &iif, const Size &gdc,
-			unsigned int bdsWidth, float bdsSF)
+void calculateBDSHeight(const ImgUDevice::Pipe &pipe, const Size &iif,
+			const Size &gdc, unsigned int bdsWidth, float bdsSF,
+			std::vector<ImgUDevice::PipeConfig> *pipeConfigs)
 {
-	unsigned int minIFHeight = iif.height - ImgUDevice::kIFMaxCropHeight;
+	unsigned int minIFHeight = iif.height > ImgUDevice::kIFMaxCropHeight
+				 ? iif.height - ImgUDevice::kIFMaxCropHeight : 0;
 	unsigned int minBDSHeight = gdc.height + ImgUDevice::kFilterHeight * 2;
 	unsigned int ifHeight;
 	float bdsHeight;
 
-	if (!isSameRatio(pipe->input, gdc)) {
+	if (!isSameRatio(pipe.input, gdc)) {
 		unsigned int foundIfHeight = 0;
 		float estIFHeight = (iif.width * gdc.height) /
 				    static_cast<float>(gdc.width);
@@ -158,8 +158,8 @@ void calculateBDSHeight(ImgUDevice::Pipe *pipe, const Size &iif, const Size &gdc
 		if (foundIfHeight) {
 			unsigned int bdsIntHeight = static_cast<unsigned int>(bdsHeight);
 
-			pipeConfigs.push_back({ bdsSF, { iif.width, foundIfHeight },
-						{ bdsWidth, bdsIntHeight }, gdc });
+			pipeConfigs->push_back({ bdsSF, { iif.width, foundIfHeight },
+						 { bdsWidth, bdsIntHeight }, gdc });
 			return;
 		}
 	} else {
@@ -172,8 +172,8 @@ void calculateBDSHeight(ImgUDevice::Pipe *pipe, const Size &iif, const Size &gdc
 
 				if (!(ifHeight % ImgUDevice::kIFAlignHeight) &&
 				    !(bdsIntHeight % ImgUDevice::kBDSAlignHeight)) {
-					pipeConfigs.push_back({ bdsSF, { iif.width, ifHeight },
-								{ bdsWidth, bdsIntHeight }, gdc });
+					pipeConfigs->push_back({ bdsSF, { iif.width, ifHeight },
+								 { bdsWidth, bdsIntHeight }, gdc });
 				}
 			}
 
@@ -182,51 +182,33 @@ void calculateBDSHeight(ImgUDevice::Pipe *pipe, const Size &iif, const Size &gdc
 	}
 }
 
-void calculateBDS(ImgUDevice::Pipe *pipe, const Size &iif, const Size &gdc, float bdsSF)
+bool calculateBDSWidth(const Size &iif, const Size &gdc, float bdsSF,
+		       unsigned int *bdsWidth)
 {
 	unsigned int minBDSWidth = gdc.width + ImgUDevice::kFilterWidth * 2;
 	unsigned int minBDSHeight = gdc.height + ImgUDevice::kFilterHeight * 2;
 
-	float sf = bdsSF;
-	while (sf <= ImgUDevice::kBDSSfMax && sf >= ImgUDevice::kBDSSfMin) {
-		float bdsWidth = static_cast<float>(iif.width) / sf;
-		float bdsHeight = static_cast<float>(iif.height) / sf;
-
-		if (std::fmod(bdsWidth, 1.0) == 0 &&
-		    std::fmod(bdsHeight, 1.0) == 0) {
-			unsigned int bdsIntWidth = static_cast<unsigned int>(bdsWidth);
-			unsigned int bdsIntHeight = static_cast<unsigned int>(bdsHeight);
-			if (!(bdsIntWidth % ImgUDevice::kBDSAlignWidth) && bdsWidth >= minBDSWidth &&
-			    !(bdsIntHeight % ImgUDevice::kBDSAlignHeight) && bdsHeight >= minBDSHeight)
-				calculateBDSHeight(pipe, iif, gdc, bdsIntWidth, sf);
-		}
+	float width = static_cast<float>(iif.width) / bdsSF;
+	float height = static_cast<float>(iif.height) / bdsSF;
 
-		sf += ImgUDevice::kBDSSfStep;
-	}
-
-	sf = bdsSF;
-	while (sf <= ImgUDevice::kBDSSfMax && sf >= ImgUDevice::kBDSSfMin) {
-		float bdsWidth = static_cast<float>(iif.width) / sf;
-		float bdsHeight = static_cast<float>(iif.height) / sf;
+	if (std::fmod(width, 1.0) != 0 || std::fmod(height, 1.0) != 0)
+		return false;
 
-		if (std::fmod(bdsWidth, 1.0) == 0 &&
-		    std::fmod(bdsHeight, 1.0) == 0) {
-			unsigned int bdsIntWidth = static_cast<unsigned int>(bdsWidth);
-			unsigned int bdsIntHeight = static_cast<unsigned int>(bdsHeight);
-			if (!(bdsIntWidth % ImgUDevice::kBDSAlignWidth) && bdsWidth >= minBDSWidth &&
-			    !(bdsIntHeight % ImgUDevice::kBDSAlignHeight) && bdsHeight >= minBDSHeight)
-				calculateBDSHeight(pipe, iif, gdc, bdsIntWidth, sf);
-		}
+	unsigned int bdsIntWidth = static_cast<unsigned int>(width);
+	unsigned int bdsIntHeight = static_cast<unsigned int>(height);
+	if (bdsIntWidth % ImgUDevice::kBDSAlignWidth || width < minBDSWidth ||
+	    bdsIntHeight % ImgUDevice::kBDSAlignHeight || height < minBDSHeight)
+		return false;
 
-		sf -= ImgUDevice::kBDSSfStep;
-	}
+	*bdsWidth = bdsIntWidth;
+	return true;
 }
 
-Size calculateGDC(ImgUDevice::Pipe *pipe)
+Size calculateGDC(const ImgUDevice::Pipe &pipe)
 {
-	const Size &in = pipe->input;
-	const Size &main = pipe->main;
-	const Size &vf = pipe->viewfinder;
+	const Size &in = pipe.input;
+	const Size &main = pipe.main;
+	const Size &vf = pipe.viewfinder;
 	Size gdc;
 
 	if (!vf.isNull()) {
@@ -271,6 +253,130 @@ FOV calcFOV(const Size &in, const ImgUDevice::PipeConfig &pipe)
 	return fov;
 }
 
+/*
+ * Search the pipe configuration with the largest field of view.
+ *
+ * The reference procedure collects all the configurations obtained by cropping
+ * the IF height and width in alignment steps, and by sweeping the BDS scaling
+ * factors upwards and then downwards from the one closest to the input to GDC
+ * ratio. The first configuration with the largest field of view is selected.
+ *
+ * As the IF width is scaled by the BDS without any crop, the horizontal field
+ * of view of a configuration only depends on its BDS scaling factor. The
+ * scaling factors are thus visited from the largest to the smallest one, and
+ * the search stops as soon as the remaining factors can't reach the field of
+ * view of the best configuration found so far. Configurations with the same
+ * field of view are ranked by their position in the reference sweep, in order
+ * to select the same configuration as the exhaustive search.
+ */
+ImgUDevice::PipeConfig searchPipeConfig(const ImgUDevice::Pipe &pipe)
+{
+	const Size &in = pipe.input;
+
+	/*
+	 * \todo Filter out all resolutions < IF_CROP_MAX.
+	 * See https://bugs.libcamera.org/show_bug.cgi?id=32
+	 */
+	if (in.width < ImgUDevice::kIFMaxCropWidth || in.height < ImgUDevice::kIFMaxCropHeight) {
+		LOG(IPU3, Error) << "Input resolution " << in << " not supported";
+		return {};
+	}
+
+	Size gdc = calculateGDC(pipe);
+
+	float bdsSF = static_cast<float>(in.width) / gdc.width;
+	float sf = findScaleFactor(bdsSF, bdsScalingFactors, true);
+	unsigned int sfIndex = std::find(bdsScalingFactors.begin(),
+					 bdsScalingFactors.end(), sf)
+			     - bdsScalingFactors.begin();
+
+	/*
+	 * Collect the IF sizes by scaling the height first, then the width.
+	 * The largest IF size is shared by the two sweeps.
+	 *
+	 * \todo This procedure is probably broken:
+	 * https://github.com/intel/intel-ipu3-pipecfg/issues/2
+	 */
+	unsigned int ifWidth = utils::alignUp(in.width, ImgUDevice::kIFAlignWidth);
+	unsigned int ifHeight = utils::alignUp(in.height, ImgUDevice::kIFAlignHeight);
+	unsigned int minIfWidth = in.width - ImgUDevice::kIFMaxCropWidth;
+	unsigned int minIfHeight = in.height - ImgUDevice::kIFMaxCropHeight;
+
+	std::vector<Size> ifSizes;
+	unsigned int heightSteps = (ifHeight - minIfHeight) / ImgUDevice::kIFAlignHeight;
+	unsigned int widthSteps = (ifWidth - minIfWidth) / ImgUDevice::kIFAlignWidth;
+	ifSizes.reserve(heightSteps + widthSteps + 1);
+
+	for (unsigned int i = 0; i <= heightSteps; ++i)
+		ifSizes.push_back({ ifWidth, ifHeight - i * ImgUDevice::kIFAlignHeight });
+	for (unsigned int i = 1; i <= widthSteps; ++i)
+		ifSizes.push_back({ ifWidth - i * ImgUDevice::kIFAlignWidth, ifHeight });
+
+	/*
+	 * Position of a scaling factor in the reference sweep, which visits
+	 * the factors upwards from sfIndex and then downwards.
+	 */
+	const unsigned int numFactors = bdsScalingFactors.size();
+	auto sweepPosition = [&](unsigned int index) {
+		return index >= sfIndex ? index - sfIndex : numFactors - index;
+	};
+
+	std::vector<ImgUDevice::PipeConfig> pipeConfigs;
+	ImgUDevice::PipeConfig bestConfig{};
+	FOV bestFov{};
+	unsigned int bestPosition = 0;
+	bool found = false;
+
+	for (unsigned int i = numFactors; i-- > 0;) {
+		sf = bdsScalingFactors[i];
+
+		/*
+		 * The horizontal field of view is proportional to the scaling
+		 * factor, with a margin to account for rounding errors.
+		 */
+		if (found) {
+			float maxFovWidth = gdc.width * (sf + ImgUDevice::kBDSSfStep / 2)
+					  / in.width;
+			if (bestFov.w > maxFovWidth)
+				break;
+		}
+
+		/* Skip factors that scale the largest IF size below the GDC. */
+		if (ifWidth / sf < gdc.width + ImgUDevice::kFilterWidth * 2 ||
+		    ifHeight / sf < gdc.height + ImgUDevice::kFilterHeight * 2)
+			continue;
+
+		for (unsigned int j = 0; j < ifSizes.size(); ++j) {
+			const Size &iif = ifSizes[j];
+			unsigned int bdsWidth;
+
+			if (!calculateBDSWidth(iif, gdc, sf, &bdsWidth))
+				continue;
+
+			pipeConfigs.clear();
+			calculateBDSHeight(pipe, iif, gdc, bdsWidth, sf, &pipeConfigs);
+
+			unsigned int position = j * (numFactors + 1) + sweepPosition(i);
+			for (const ImgUDevice::PipeConfig &pipeConfig : pipeConfigs) {
+				FOV fov = calcFOV(in, pipeConfig);
+				if (found && !fov.isLarger(bestFov) &&
+				    (bestFov.isLarger(fov) || position >= bestPosition))
+					continue;
+
+				bestConfig = pipeConfig;
+				bestFov = fov;
+				bestPosition = position;
+				found = true;
+			}
+		}
+	}
+
+	if (!found)
+		LOG(IPU3, Error) << "Failed to calculate pipe configuration";
+
+	return bestConfig;
+}
+
 } /* namespace */
 
 /**
@@ -378,92 +484,57 @@ int ImgUDevice::init(MediaDevice *media, unsigned int index)
 /**
  * \brief Calculate the ImgU pipe configuration parameters
  * \param[in] pipe The requested ImgU configuration
+ *
+ * The pipe configuration only depends on the requested sizes. Results are
+ * cached, and the calculation is only performed the first time a given
+ * combination of input, main output and viewfinder sizes is requested.
+ *
+ * \context This function is \threadsafe.
+ *
  * \return An ImgUDevice::PipeConfig instance on success, an empty configuration
  * otherwise
  */
 ImgUDevice::PipeConfig ImgUDevice::calculatePipeConfig(Pipe *pipe)
 {
-	pipeConfigs.clear();
-
 	LOG(IPU3, Debug) << "Calculating pipe configuration for: ";
 	LOG(IPU3, Debug) << "input: " << pipe->input;
 	LOG(IPU3, Debug) << "main: " << pipe->main;
 	LOG(IPU3, Debug) << "vf: " << pipe->viewfinder;
 
-	const Size &in = pipe->input;
-
-	/*
-	 * \todo Filter out all resolutions < IF_CROP_MAX.
-	 * See https://bugs.libcamera.org/show_bug.cgi?id=32
-	 */
-	if (in.width < ImgUDevice::kIFMaxCropWidth || in.height < ImgUDevice::kIFMaxCropHeight) {
-		LOG(IPU3, Error) << "Input resolution " << in << " not supported";
-		return {};
-	}
-
-	Size gdc = calculateGDC(pipe);
-
-	float bdsSF = static_cast<float>(in.width) / gdc.width;
-	float sf = findScaleFactor(bdsSF, bdsScalingFactors, true);
+	const auto key = std::make_tuple(pipe->input, pipe->main, pipe->viewfinder);
+	PipeConfig pipeConfig;
+	bool cached;
 
-	/* Populate the configurations vector by scaling width and height. */
-	unsigned int ifWidth = utils::alignUp(in.width, ImgUDevice::kIFAlignWidth);
-	unsigned int ifHeight = utils::alignUp(in.height, ImgUDevice::kIFAlignHeight);
-	unsigned int minIfWidth = in.width - ImgUDevice::kIFMaxCropWidth;
-	unsigned int minIfHeight = in.height - ImgUDevice::kIFMaxCropHeight;
-	while (ifWidth >= minIfWidth) {
-		while (ifHeight >= minIfHeight) {
-			Size iif{ ifWidth, ifHeight };
-			calculateBDS(pipe, iif, gdc, sf);
-			ifHeight -= ImgUDevice::kIFAlignHeight;
-		}
+	{
+		MutexLocker locker(pipeConfigsMutex_);
 
-		ifWidth -= ImgUDevice::kIFAlignWidth;
+		auto iter = pipeConfigs_.find(key);
+		cached = iter != pipeConfigs_.end();
+		if (cached)
+			pipeConfig = iter->second;
 	}
 
-	/* Repeat search by scaling width first. */
-	ifWidth = utils::alignUp(in.width, ImgUDevice::kIFAlignWidth);
-	ifHeight = utils::alignUp(in.height, ImgUDevice::kIFAlignHeight);
-	minIfWidth = in.width - ImgUDevice::kIFMaxCropWidth;
-	minIfHeight = in.height - ImgUDevice::kIFMaxCropHeight;
-	while (ifHeight >= minIfHeight) {
-		/*
-		 * \todo This procedure is probably broken:
-		 * https://github.com/intel/intel-ipu3-pipecfg/issues/2
-		 */
-		while (ifWidth >= minIfWidth) {
-			Size iif{ ifWidth, ifHeight };
-			calculateBDS(pipe, iif, gdc, sf);
-			ifWidth -= ImgUDevice::kIFAlignWidth;
-		}
+	if (cached) {
+		LOG(IPU3, Debug) << "Using cached pipe configuration";
+	} else {
+		pipeConfig = searchPipeConfig(*pipe);
 
-		ifHeight -= ImgUDevice::kIFAlignHeight;
-	}
+		MutexLocker locker(pipeConfigsMutex_);
 
-	if (pipeConfigs.size() == 0) {
-		LOG(IPU3, Error) << "Failed to calculate pipe configuration";
-		return {};
+		if (pipeConfigs_.size() >= kMaxCachedPipeConfigs)
+			pipeConfigs_.clear();
+		pipeConfigs_[key] = pipeConfig;
 	}
 
-	FOV bestFov = calcFOV(pipe->input, pipeConfigs[0]);
-	unsigned int bestIndex = 0;
-	unsigned int p = 0;
-	for (auto pipeConfig : pipeConfigs) {
-		FOV fov = calcFOV(pipe->input, pipeConfig);
-		if (fov.isLarger(bestFov)) {
-			bestFov = fov;
-			bestIndex = p;
-		}
-
-		++p;
-	}
+	if (pipeConfig.isNull())
+		return {};
 
 	LOG(IPU3, Debug) << "Computed pipe configuration: ";
-	LOG(IPU3, Debug) << "IF: " << pipeConfigs[bestIndex].iif;
-	LOG(IPU3, Debug) << "BDS: " << pipeConfigs[bestIndex].bds;
-	LOG(IPU3, Debug) << "GDC: " << pipeConfigs[bestIndex].gdc;
+	LOG(IPU3, Debug) << "IF: " << pipeConfig.iif;
+	LOG(IPU3, Debug) << "BDS: " << pipeConfig.bds;
+	LOG(IPU3, Debug) << "GDC: " << pipeConfig.gdc;
 
-	return pipeConfigs[bestIndex];
+	return pipeConfig;
 }
 
 /**
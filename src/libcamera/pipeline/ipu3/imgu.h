@@ -7,8 +7,15 @@
 
 #pragma once
 
+#include <map>
 #include <memory>
 #include <string>
+#include <tuple>
+
+#include <libcamera/base/mutex.h>
+#include <libcamera/base/thread_annotations.h>
+
+#include <libcamera/geometry.h>
 
 #include "libcamera/internal/v4l2_subdevice.h"
 #include "libcamera/internal/v4l2_videodevice.h"
@@ -17,7 +24,6 @@ namespace libcamera {
 
 class FrameBuffer;
 class MediaDevice;
-class Size;
 struct StreamConfiguration;
 
 class ImgUDevice
@@ -109,6 +115,8 @@ private:
 	static constexpr unsigned int PAD_VF = 3;
 	static constexpr unsigned int PAD_STAT = 4;
 
+	static constexpr unsigned int kMaxCachedPipeConfigs = 32;
+
 	int linkSetup(const std::string &source, unsigned int sourcePad,
 		      const std::string &sink, unsigned int sinkPad,
 		      bool enable);
@@ -119,6 +127,10 @@ private:
 
 	std::string name_;
 	MediaDevice *media_;
+
+	Mutex pipeConfigsMutex_;
+	std::map<std::tuple<Size, Size, Size>, PipeConfig> pipeConfigs_
+		LIBCAMERA_TSA_GUARDED_BY(pipeConfigsMutex_);
 };
 
 } /* namespace libcamera */
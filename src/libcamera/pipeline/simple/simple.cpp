@@ -15,6 +15,7 @@
 #include <set>
 #include <string>
 #include <string.h>
+#include <tuple>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -22,6 +23,8 @@
 #include <linux/media-bus-format.h>
 
 #include <libcamera/base/log.h>
+#include <libcamera/base/mutex.h>
+#include <libcamera/base/thread_annotations.h>
 
 #include <libcamera/camera.h>
 #include <libcamera/control_ids.h>
@@ -135,6 +138,13 @@ LOG_DEFINE_CATEGORY(SimplePipeline)
  * the SimpleCameraData::Configuration structure, stored in the
  * SimpleCameraData::configs_ vector.
  *
+ * As the result of the format propagation only depends on the hardware, the
+ * capture size and pixel formats obtained for each media bus format and size
+ * are cached, for each camera sensor and pipeline, across camera lifetimes.
+ * When the pipeline handler matches the same device again, for instance after
+ * the camera manager is restarted, the pipeline configurations are created
+ * without reconfiguring the pipeline.
+ *
  * Format Conversion and Scaling
  * -----------------------------
  *
@@ -260,10 +270,36 @@ public:
 	std::queue<std::map<unsigned int, FrameBuffer *>> converterQueue_;
 
 private:
-	void tryPipeline(unsigned int code, const Size &size);
+	/*
+	 * The capture size and pixel formats obtained by propagating a sensor
+	 * media bus code and size through the pipeline, empty if the pipeline
+	 * doesn't support the sensor format.
+	 */
+	struct CaptureFormats {
+		Size size;
+		std::vector<PixelFormat> formats;
+	};
+
+	using CaptureFormatsKey = std::tuple<std::string, unsigned int, Size>;
+
+	int tryPipeline(unsigned int code, const Size &size);
+	int captureFormats(unsigned int code, const Size &size,
+			   CaptureFormats *capture);
 
 	void converterInputDone(FrameBuffer *buffer);
 	void converterOutputDone(FrameBuffer *buffer);
+
+	std::string route_;
+	bool linksConfigured_;
+
+	/*
+	 * Capture formats, indexed by pipeline route and sensor format, shared
+	 * by all cameras. Entries are never invalidated while the process runs,
+	 * as they only depend on the hardware.
+	 */
+	static Mutex captureFormatsMutex_;
+	static std::map<CaptureFormatsKey, CaptureFormats> captureFormats_
+		LIBCAMERA_TSA_GUARDED_BY(captureFormatsMutex_);
 };
 
 class SimpleCameraConfiguration : public CameraConfiguration
@@ -349,7 +385,7 @@ private:
 SimpleCameraData::SimpleCameraData(SimplePipelineHandler *pipe,
 				   unsigned int numStreams,
 				   MediaEntity *sensor)
-	: Camera::Private(pipe), streams_(numStreams)
+	: Camera::Private(pipe), streams_(numStreams), linksConfigured_(false)
 {
 	int ret;
 
@@ -427,21 +463,28 @@ SimpleCameraData::SimpleCameraData(SimplePipelineHandler *pipe,
 		return;
 	}
 
-	LOG(SimplePipeline, Debug)
-		<< "Found pipeline: "
-		<< utils::join(entities_, " -> ",
-			       [](const Entity &e) {
-				       std::string s = "[";
-				       if (e.sink)
-					       s += std::to_string(e.sink->index()) + "|";
-				       s += e.entity->name();
-				       if (e.source)
-					       s += "|" + std::to_string(e.source->index());
-				       s += "]";
-				       return s;
-			       });
+	std::string route = utils::join(entities_, " -> ",
+					[](const Entity &e) {
+						std::string s = "[";
+						if (e.sink)
+							s += std::to_string(e.sink->index()) + "|";
+						s += e.entity->name();
+						if (e.source)
+							s += "|" + std::to_string(e.source->index());
+						s += "]";
+						return s;
+					});
+
+	LOG(SimplePipeline, Debug) << "Found pipeline: " << route;
+
+	/* Identify the pipeline in the capture formats cache. */
+	route_ = sensor_->id() + ": " + route;
 }
 
+Mutex SimpleCameraData::captureFormatsMutex_;
+std::map<SimpleCameraData::CaptureFormatsKey, SimpleCameraData::CaptureFormats>
+	SimpleCameraData::captureFormats_;
+
 SimplePipelineHandler *SimpleCameraData::pipe()
 {
 	return static_cast<SimplePipelineHandler *>(Camera::Private::pipe());
@@ -469,21 +512,16 @@ int SimpleCameraData::init()
 	video_ = pipe->video(entities_.back().entity);
 	ASSERT(video_);
 
-	/*
-	 * Setup links first as some subdev drivers take active links into
-	 * account to propagate TRY formats. Such is life :-(
-	 */
-	ret = setupLinks();
-	if (ret < 0)
-		return ret;
-
 	/*
 	 * Generate the list of possible pipeline configurations by trying each
 	 * media bus format and size supported by the sensor.
 	 */
 	for (unsigned int code : sensor_->mbusCodes()) {
-		for (const Size &size : sensor_->sizes(code))
-			tryPipeline(code, size);
+		for (const Size &size : sensor_->sizes(code)) {
+			ret = tryPipeline(code, size);
+			if (ret < 0)
+				return ret;
+		}
 	}
 
 	if (configs_.empty()) {
@@ -508,64 +546,126 @@ int SimpleCameraData::init()
  * Generate a list of supported pipeline configurations for a sensor media bus
  * code and size.
  *
- * First propagate the media bus code and size through the pipeline from the
- * camera sensor to the video node. Then, query the video node for all supported
- * pixel formats compatible with the media bus code. For each pixel format, store
- * a full pipeline configuration in the configs_ vector.
+ * First retrieve the capture size and the pixel formats supported by the video
+ * node for the media bus code and size. Then, for each pixel format, store a
+ * full pipeline configuration in the configs_ vector.
  */
-void SimpleCameraData::tryPipeline(unsigned int code, const Size &size)
+int SimpleCameraData::tryPipeline(unsigned int code, const Size &size)
 {
-	/*
-	 * Propagate the format through the pipeline, and enumerate the
-	 * corresponding possible V4L2 pixel formats on the video node.
-	 */
-	V4L2SubdeviceFormat format{};
-	format.mbus_code = code;
-	format.size = size;
+	CaptureFormats capture;
+	int ret = captureFormats(code, size, &capture);
+	if (ret < 0)
+		return ret;
 
-	int ret = setupFormats(&format, V4L2Subdevice::TryFormat);
-	if (ret < 0) {
+	if (capture.formats.empty()) {
 		/* Pipeline configuration failed, skip this configuration. */
+		V4L2SubdeviceFormat format{};
 		format.mbus_code = code;
 		format.size = size;
 		LOG(SimplePipeline, Debug)
 			<< "Sensor format " << format
 			<< " not supported for this pipeline";
-		return;
+		return 0;
 	}
 
-	V4L2VideoDevice::Formats videoFormats = video_->formats(format.mbus_code);
-
 	LOG(SimplePipeline, Debug)
-		<< "Adding configuration for " << format.size
+		<< "Adding configuration for " << capture.size
 		<< " in pixel formats [ "
-		<< utils::join(videoFormats, ", ",
-			       [](const auto &f) {
-				       return f.first.toString();
+		<< utils::join(capture.formats, ", ",
+			       [](const PixelFormat &f) {
+				       return f.toString();
 			       })
 		<< " ]";
 
-	for (const auto &videoFormat : videoFormats) {
-		PixelFormat pixelFormat = videoFormat.first.toPixelFormat();
-		if (!pixelFormat)
-			continue;
-
+	for (const PixelFormat &pixelFormat : capture.formats) {
 		Configuration config;
 		config.code = code;
 		config.sensorSize = size;
 		config.captureFormat = pixelFormat;
-		config.captureSize = format.size;
+		config.captureSize = capture.size;
 
 		if (!converter_) {
 			config.outputFormats = { pixelFormat };
 			config.outputSizes = config.captureSize;
 		} else {
 			config.outputFormats = converter_->formats(pixelFormat);
-			config.outputSizes = converter_->sizes(format.size);
+			config.outputSizes = converter_->sizes(capture.size);
 		}
 
 		configs_.push_back(config);
 	}
+
+	return 0;
+}
+
+/*
+ * Retrieve the capture size and pixel formats for a sensor media bus code and
+ * size.
+ *
+ * Propagate the media bus code and size through the pipeline from the camera
+ * sensor to the video node, and query the video node for all supported pixel
+ * formats compatible with the resulting media bus code. The result only
+ * depends on the hardware and is cached for the lifetime of the process,
+ * across camera lifetimes, without ever being invalidated. The pipeline is only
+ * configured when the code and size haven't been tried before.
+ *
+ * Return 0 on success, including when the pipeline doesn't support the sensor
+ * format, or a negative error code if the links can't be configured.
+ */
+int SimpleCameraData::captureFormats(unsigned int code, const Size &size,
+				     CaptureFormats *capture)
+{
+	const CaptureFormatsKey key{ route_, code, size };
+
+	{
+		MutexLocker locker(captureFormatsMutex_);
+
+		auto iter = captureFormats_.find(key);
+		if (iter != captureFormats_.end()) {
+			*capture = iter->second;
+			return 0;
+		}
+	}
+
+	/*
+	 * Setup links first as some subdev drivers take active links into
+	 * account to propagate TRY formats. Such is life :-(
+	 */
+	if (!linksConfigured_) {
+		int ret = setupLinks();
+		if (ret < 0)
+			return ret;
+
+		linksConfigured_ = true;
+	}
+
+	/*
+	 * Propagate the format through the pipeline, and enumerate the
+	 * corresponding possible V4L2 pixel formats on the video node.
+	 */
+	V4L2SubdeviceFormat format{};
+	format.mbus_code = code;
+	format.size = size;
+
+	*capture = {};
+
+	int ret = setupFormats(&format, V4L2Subdevice::TryFormat);
+	if (ret == 0) {
+		V4L2VideoDevice::Formats videoFormats = video_->formats(format.mbus_code);
+
+		for (const auto &videoFormat : videoFormats) {
+			PixelFormat pixelFormat = videoFormat.first.toPixelFormat();
+			if (pixelFormat)
+				capture->formats.push_back(pixelFormat);
+		}
+
+		capture->size = format.size;
+	}
+
+	MutexLocker locker(captureFormatsMutex_);
+	captureFormats_[key] = *capture;
+
+	return 0;
 }
 
 int SimpleCameraData::setupLinks()
@@ -575,17 +675,28 @@ int SimpleCameraData::setupLinks()
 	/*
 	 * Configure all links along the pipeline. Some entities may not allow
 	 * multiple sink links to be enabled together, even on different sink
-	 * pads. We must thus start by disabling all sink links (but the one we
-	 * want to enable) before enabling the pipeline link.
+	 * pads. We must thus start by disabling all links of the pipeline
+	 * entities (but the ones we want to enable) before enabling the
+	 * pipeline links.
+	 *
+	 * The MediaLink instances track the state of the links. Only change the
+	 * links whose state differs from the desired topology, without
+	 * disabling and re-enabling the pipeline links on every configuration.
 	 */
-	for (SimpleCameraData::Entity &e : entities_) {
+	std::vector<MediaLink *> pipelineLinks;
+	for (const SimpleCameraData::Entity &e : entities_) {
 		if (!e.sourceLink)
 			break;
 
-		MediaEntity *remote = e.sourceLink->sink()->entity();
+		pipelineLinks.push_back(e.sourceLink);
+	}
+
+	for (MediaLink *pipelineLink : pipelineLinks) {
+		MediaEntity *remote = pipelineLink->sink()->entity();
 		for (MediaPad *pad : remote->pads()) {
 			for (MediaLink *link : pad->links()) {
-				if (link == e.sourceLink)
+				if (std::find(pipelineLinks.begin(), pipelineLinks.end(),
+					      link) != pipelineLinks.end())
 					continue;
 
 				if ((link->flags() & MEDIA_LNK_FL_ENABLED) &&
@@ -596,9 +707,11 @@ int SimpleCameraData::setupLinks()
 				}
 			}
 		}
+	}
 
-		if (!(e.sourceLink->flags() & MEDIA_LNK_FL_ENABLED)) {
-			ret = e.sourceLink->setEnabled(true);
+	for (MediaLink *link : pipelineLinks) {
+		if (!(link->flags() & MEDIA_LNK_FL_ENABLED)) {
+			ret = link->setEnabled(true);
 			if (ret < 0)
 				return ret;
 		}
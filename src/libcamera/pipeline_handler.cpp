@@ -11,7 +11,9 @@
 #include <sys/sysmacros.h>
 
 #include <libcamera/base/log.h>
+#include <libcamera/base/metrics.h>
 #include <libcamera/base/mutex.h>
+#include <libcamera/base/trace_recorder.h>
 #include <libcamera/base/utils.h>
 
 #include <libcamera/camera.h>
@@ -45,6 +47,23 @@ namespace libcamera {
 
 LOG_DEFINE_CATEGORY(Pipeline)
 
+namespace {
+
+/*
+ * Request latency metrics, recorded for all cameras. The stages are measured
+ * from queueRequest() to the request being queued to the device, to each
+ * buffer completing, and to the request being returned to the application.
+ * Cancelled requests are only counted.
+ */
+MetricHistogram requestQueueToDevice("request.queue_to_device");
+MetricHistogram requestDeviceToBuffer("request.device_to_buffer");
+MetricHistogram requestBufferToComplete("request.buffer_to_complete");
+MetricHistogram requestQueueToComplete("request.queue_to_complete");
+MetricCounter requestsCompleted("request.completed");
+MetricCounter requestsCancelled("request.cancelled");
+
+} /* namespace */
+
 /**
  * \class PipelineHandler
  * \brief Create and manage cameras based on a set of media devices
@@ -381,6 +400,9 @@ void PipelineHandler::queueRequest(Request *request)
 {
 	LIBCAMERA_TRACEPOINT(request_queue, request);
 
+	request->_d()->queueTime_ = utils::clock::now();
+	request->_d()->bufferTime_ = {};
+
 	waitingRequests_.push(request);
 
 	request->_d()->prepare(300ms);
@@ -404,6 +426,10 @@ void PipelineHandler::doQueueRequest(Request *request)
 		return;
 	}
 
+	request->_d()->deviceQueueTime_ = utils::clock::now();
+	requestQueueToDevice.record(request->_d()->deviceQueueTime_ -
+				    request->_d()->queueTime_);
+
 	int ret = queueRequestDevice(camera, request);
 	if (ret) {
 		request->_d()->cancel();
@@ -465,9 +491,16 @@ void PipelineHandler::doQueueRequests()
  */
 bool PipelineHandler::completeBuffer(Request *request, FrameBuffer *buffer)
 {
-	Camera *camera = request->_d()->camera();
+	Request::Private *d = request->_d();
+
+	if (buffer->metadata().status != FrameMetadata::FrameCancelled) {
+		d->bufferTime_ = utils::clock::now();
+		requestDeviceToBuffer.record(d->bufferTime_ - d->deviceQueueTime_);
+	}
+
+	Camera *camera = d->camera();
 	camera->bufferCompleted.emit(request, buffer);
-	return request->_d()->completeBuffer(buffer);
+	return d->completeBuffer(buffer);
 }
 
 /**
@@ -486,6 +519,8 @@ bool PipelineHandler::completeBuffer(Request *request, FrameBuffer *buffer)
  */
 void PipelineHandler::completeRequest(Request *request)
 {
+	LIBCAMERA_TRACE_SCOPE("pipeline.complete_request");
+
 	Camera *camera = request->_d()->camera();
 
 	request->_d()->complete();
@@ -499,6 +534,19 @@ void PipelineHandler::completeRequest(Request *request)
 
 		ASSERT(!req->hasPendingBuffers());
 		data->queuedRequests_.pop_front();
+
+		if (req->status() == Request::RequestComplete) {
+			Request::Private *d = req->_d();
+			utils::time_point now = utils::clock::now();
+
+			if (d->bufferTime_ != utils::time_point())
+				requestBufferToComplete.record(now - d->bufferTime_);
+			requestQueueToComplete.record(now - d->queueTime_);
+			requestsCompleted.add();
+		} else {
+			requestsCancelled.add();
+		}
+
 		camera->requestComplete(req);
 	}
 }
@@ -7,6 +7,7 @@
 
 #include "libcamera/internal/request.h"
 
+#include <algorithm>
 #include <map>
 #include <sstream>
 
@@ -41,6 +42,13 @@ LOG_DEFINE_CATEGORY(Request)
  * Request data from the public API, and exposes utility functions to
  * internal users of the request (namely the PipelineHandler class and its
  * subclasses).
+ *
+ * As requests are meant to be reused, the bookkeeping data is stored in
+ * containers that are sized for the number of streams of the camera at
+ * construction time, and whose storage is retained across reuse() calls. The
+ * fence timeout timer is similarly created once and recycled. A request reused
+ * with the same buffers thus doesn't perform any memory allocation for its
+ * bookkeeping, unless fences are used.
  */
 
 /**
@@ -50,6 +58,10 @@ LOG_DEFINE_CATEGORY(Request)
 Request::Private::Private(Camera *camera)
 	: camera_(camera), cancelled_(false)
 {
+	std::size_t streams = camera->streams().size();
+
+	pending_.reserve(streams);
+	notifiers_.reserve(streams);
 }
 
 Request::Private::~Private()
@@ -79,8 +91,8 @@ bool Request::Private::hasPendingBuffers() const
  * \brief Complete a buffer for the request
  * \param[in] buffer The buffer that has completed
  *
- * A request tracks the status of all buffers it contains through a set of
- * pending buffers. This function removes the \a buffer from the set to mark it
+ * A request tracks the status of all buffers it contains through a list of
+ * pending buffers. This function removes the \a buffer from the list to mark it
  * as complete. All buffers associate with the request shall be marked as
  * complete by calling this function once and once only before reporting the
  * request as complete with the complete() function.
@@ -92,8 +104,12 @@ bool Request::Private::completeBuffer(FrameBuffer *buffer)
 {
 	LIBCAMERA_TRACEPOINT(request_complete_buffer, this, buffer);
 
-	int ret = pending_.erase(buffer);
-	ASSERT(ret == 1);
+	auto it = std::find(pending_.begin(), pending_.end(), buffer);
+	ASSERT(it != pending_.end());
+
+	/* The order of pending buffers doesn't matter, avoid moving elements. */
+	*it = pending_.back();
+	pending_.pop_back();
 
 	buffer->_d()->setRequest(nullptr);
 
@@ -136,7 +152,8 @@ void Request::Private::doCancelRequest()
 	cancelled_ = true;
 	pending_.clear();
 	notifiers_.clear();
-	timer_.reset();
+	if (timer_)
+		timer_->stop();
 }
 
 /**
@@ -167,7 +184,6 @@ void Request::Private::reuse()
 	prepared_ = false;
 	pending_.clear();
 	notifiers_.clear();
-	timer_.reset();
 }
 
 /*
@@ -226,7 +242,7 @@ void Request::Private::prepare(std::chrono::milliseconds timeout)
 							notifierActivated(buffer);
 					    });
 
-		notifiers_[buffer] = std::move(notifier);
+		notifiers_.emplace_back(buffer, std::move(notifier));
 	}
 
 	if (notifiers_.empty()) {
@@ -238,11 +254,15 @@ void Request::Private::prepare(std::chrono::milliseconds timeout)
 	 * In case a timeout is specified, create a timer and set it up.
 	 *
 	 * The timer must be created here instead of in the Request constructor,
-	 * in order to be bound to the pipeline handler thread.
+	 * in order to be bound to the pipeline handler thread. It is then kept
+	 * and reused when the request is prepared again.
 	 */
 	if (timeout != 0ms) {
-		timer_ = std::make_unique<Timer>();
-		timer_->timeout.connect(this, &Request::Private::timeout);
+		if (!timer_) {
+			timer_ = std::make_unique<Timer>();
+			timer_->timeout.connect(this, &Request::Private::timeout);
+		}
+
 		timer_->start(timeout);
 	}
 }
@@ -266,8 +286,11 @@ void Request::Private::notifierActivated(FrameBuffer *buffer)
 	ASSERT(buffer);
 	buffer->releaseFence();
 
-	/* Remove the entry from the map and check if other fences are pending. */
-	auto it = notifiers_.find(buffer);
+	/* Remove the entry from the list and check if other fences are pending. */
+	auto it = std::find_if(notifiers_.begin(), notifiers_.end(),
+			       [buffer](const auto &entry) {
+				       return entry.first == buffer;
+			       });
 	ASSERT(it != notifiers_.end());
 	notifiers_.erase(it);
 
@@ -279,8 +302,10 @@ void Request::Private::notifierActivated(FrameBuffer *buffer)
 	if (!notifiers_.empty())
 		return;
 
-	/* All fences completed, delete the timer and emit the prepared signal. */
-	timer_.reset();
+	/* All fences completed, stop the timer and emit the prepared signal. */
+	if (timer_)
+		timer_->stop();
+
 	emitPrepareCompleted();
 }
 
@@ -386,7 +411,7 @@ void Request::reuse(ReuseFlag flags)
 		for (auto pair : bufferMap_) {
 			FrameBuffer *buffer = pair.second;
 			buffer->_d()->setRequest(this);
-			_d()->pending_.insert(buffer);
+			_d()->pending_.push_back(buffer);
 		}
 	} else {
 		bufferMap_.clear();
@@ -471,7 +496,7 @@ int Request::addBuffer(const Stream *stream, FrameBuffer *buffer,
 	}
 
 	buffer->_d()->setRequest(this);
-	_d()->pending_.insert(buffer);
+	_d()->pending_.push_back(buffer);
 	bufferMap_[stream] = buffer;
 
 	/*
@@ -25,6 +25,7 @@
 #include <libcamera/base/utils.h>
 
 #include "libcamera/internal/sysfs.h"
+#include "libcamera/internal/tracepoints.h"
 
 /**
  * \file v4l2_device.h
@@ -341,6 +342,10 @@ int V4L2Device::setControls(ControlList *ctrls)
 	v4l2ExtCtrls.count = v4l2Ctrls.size();
 
 	int ret = ioctl(VIDIOC_S_EXT_CTRLS, &v4l2ExtCtrls);
+
+	LIBCAMERA_TRACEPOINT(v4l2_set_controls, deviceNode_.c_str(),
+			     v4l2ExtCtrls.count, ret);
+
 	if (ret) {
 		unsigned int errorIdx = v4l2ExtCtrls.error_idx;
 
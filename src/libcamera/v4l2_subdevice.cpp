@@ -21,6 +21,7 @@
 #include <libcamera/geometry.h>
 
 #include <libcamera/base/log.h>
+#include <libcamera/base/metrics.h>
 #include <libcamera/base/utils.h>
 
 #include "libcamera/internal/media_device.h"
@@ -131,6 +132,15 @@ const std::map<uint32_t, V4L2SubdeviceFormatInfo> formatInfoMap = {
 	{ MEDIA_BUS_FMT_AHSV8888_1X32, { 32, "AHSV8888_1X32" } },
 };
 
+/*
+ * Format enumeration counters, to profile the ioctls issued when initializing
+ * cameras.
+ */
+MetricCounter enumMbusCodeIoctls("v4l2.subdev.enum_mbus_code");
+MetricCounter enumFrameSizeIoctls("v4l2.subdev.enum_frame_size");
+MetricCounter formatsCacheHits("v4l2.subdev.formats_cached");
+MetricCounter tryFormatIoctls("v4l2.subdev.try_format");
+
 } /* namespace */
 
 /**
@@ -284,6 +294,8 @@ V4L2Subdevice::~V4L2Subdevice()
  */
 int V4L2Subdevice::open()
 {
+	invalidateFormats();
+
 	return V4L2Device::open(O_RDWR);
 }
 
@@ -354,6 +366,8 @@ int V4L2Subdevice::setSelection(unsigned int pad, unsigned int target,
 	sel.r.width = rect->width;
 	sel.r.height = rect->height;
 
+	invalidateFormats();
+
 	int ret = ioctl(VIDIOC_SUBDEV_S_SELECTION, &sel);
 	if (ret < 0) {
 		LOG(V4L2, Error)
@@ -372,13 +386,22 @@ int V4L2Subdevice::setSelection(unsigned int pad, unsigned int target,
 /**
  * \brief Enumerate all media bus codes and frame sizes on a \a pad
  * \param[in] pad The 0-indexed pad number to enumerate formats on
+ * \param[in] whence The formats to enumerate, \ref V4L2Subdevice::ActiveFormat
+ * "ActiveFormat" or \ref V4L2Subdevice::TryFormat "TryFormat"
  *
  * Enumerate all media bus codes and frame sizes supported by the subdevice on
  * a \a pad.
  *
+ * The enumeration requires one ioctl per media bus code and per frame size. Its
+ * result is cached per pad and \a whence, and subsequent calls return the
+ * cached formats until the cache is invalidated. The cache is invalidated when
+ * the subdevice is opened, when a format or selection rectangle is set, as the
+ * formats supported on a pad may depend on the configuration of the other
+ * pads, and by calling invalidateFormats().
+ *
  * \return A list of the supported device formats
  */
-V4L2Subdevice::Formats V4L2Subdevice::formats(unsigned int pad)
+V4L2Subdevice::Formats V4L2Subdevice::formats(unsigned int pad, Whence whence)
 {
 	Formats formats;
 
@@ -387,8 +410,14 @@ V4L2Subdevice::Formats V4L2Subdevice::formats(unsigned int pad)
 		return {};
 	}
 
-	for (unsigned int code : enumPadCodes(pad)) {
-		std::vector<SizeRange> sizes = enumPadSizes(pad, code);
+	auto iter = formats_.find({ pad, whence });
+	if (iter != formats_.end()) {
+		formatsCacheHits.add();
+		return iter->second;
+	}
+
+	for (unsigned int code : enumPadCodes(pad, whence)) {
+		std::vector<SizeRange> sizes = enumPadSizes(pad, code, whence);
 		if (sizes.empty())
 			return {};
 
@@ -401,9 +430,26 @@ V4L2Subdevice::Formats V4L2Subdevice::formats(unsigned int pad)
 		}
 	}
 
+	/* Don't cache enumeration errors. */
+	if (!formats.empty())
+		formats_[{ pad, whence }] = formats;
+
 	return formats;
 }
 
+/**
+ * \brief Invalidate the cached formats
+ *
+ * Drop the formats cached by formats() for all pads. This function shall be
+ * called when the formats supported by the subdevice may have changed for
+ * reasons not known to the V4L2Subdevice, for instance when links of the
+ * corresponding media entity are modified.
+ */
+void V4L2Subdevice::invalidateFormats()
+{
+	formats_.clear();
+}
+
 /**
  * \brief Retrieve the image format set on one of the V4L2 subdevice pads
  * \param[in] pad The 0-indexed pad number the format is to be retrieved from
@@ -461,6 +507,11 @@ int V4L2Subdevice::setFormat(unsigned int pad, V4L2SubdeviceFormat *format,
 	subdevFmt.format.field = V4L2_FIELD_NONE;
 	fromColorSpace(format->colorSpace, subdevFmt.format);
 
+	invalidateFormats();
+
+	if (whence == TryFormat)
+		tryFormatIoctls.add();
+
 	int ret = ioctl(VIDIOC_SUBDEV_S_FMT, &subdevFmt);
 	if (ret) {
 		LOG(V4L2, Error)
@@ -553,7 +604,8 @@ std::string V4L2Subdevice::logPrefix() const
 	return "'" + entity_->name() + "'";
 }
 
-std::vector<unsigned int> V4L2Subdevice::enumPadCodes(unsigned int pad)
+std::vector<unsigned int> V4L2Subdevice::enumPadCodes(unsigned int pad,
+						      Whence whence)
 {
 	std::vector<unsigned int> codes;
 	int ret;
@@ -562,8 +614,10 @@ std::vector<unsigned int> V4L2Subdevice::enumPadCodes(unsigned int pad)
 		struct v4l2_subdev_mbus_code_enum mbusEnum = {};
 		mbusEnum.pad = pad;
 		mbusEnum.index = index;
-		mbusEnum.which = V4L2_SUBDEV_FORMAT_ACTIVE;
+		mbusEnum.which = whence == ActiveFormat ? V4L2_SUBDEV_FORMAT_ACTIVE
+			       : V4L2_SUBDEV_FORMAT_TRY;
 
+		enumMbusCodeIoctls.add();
 		ret = ioctl(VIDIOC_SUBDEV_ENUM_MBUS_CODE, &mbusEnum);
 		if (ret)
 			break;
@@ -582,7 +636,8 @@ std::vector<unsigned int> V4L2Subdevice::enumPadCodes(unsigned int pad)
 }
 
 std::vector<SizeRange> V4L2Subdevice::enumPadSizes(unsigned int pad,
-						   unsigned int code)
+						   unsigned int code,
+						   Whence whence)
 {
 	std::vector<SizeRange> sizes;
 	int ret;
@@ -592,8 +647,10 @@ std::vector<SizeRange> V4L2Subdevice::enumPadSizes(unsigned int pad,
 		sizeEnum.index = index;
 		sizeEnum.pad = pad;
 		sizeEnum.code = code;
-		sizeEnum.which = V4L2_SUBDEV_FORMAT_ACTIVE;
+		sizeEnum.which = whence == ActiveFormat ? V4L2_SUBDEV_FORMAT_ACTIVE
+			       : V4L2_SUBDEV_FORMAT_TRY;
 
+		enumFrameSizeIoctls.add();
 		ret = ioctl(VIDIOC_SUBDEV_ENUM_FRAME_SIZE, &sizeEnum);
 		if (ret)
 			break;
@@ -24,6 +24,7 @@
 #include <libcamera/base/event_notifier.h>
 #include <libcamera/base/log.h>
 #include <libcamera/base/shared_fd.h>
+#include <libcamera/base/trace_recorder.h>
 #include <libcamera/base/unique_fd.h>
 #include <libcamera/base/utils.h>
 
@@ -31,6 +32,7 @@
 #include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/media_object.h"
+#include "libcamera/internal/tracepoints.h"
 
 /**
  * \file v4l2_videodevice.h
@@ -1654,6 +1656,9 @@ int V4L2VideoDevice::queueBuffer(FrameBuffer *buffer)
 
 	LOG(V4L2, Debug) << "Queueing buffer " << buf.index;
 
+	LIBCAMERA_TRACEPOINT(v4l2_queue_buffer, deviceNode().c_str(), buffer,
+			     buf.index);
+
 	ret = ioctl(VIDIOC_QBUF, &buf);
 	if (ret < 0) {
 		LOG(V4L2, Error)
@@ -1684,6 +1689,8 @@ int V4L2VideoDevice::queueBuffer(FrameBuffer *buffer)
  */
 void V4L2VideoDevice::bufferAvailable()
 {
+	LIBCAMERA_TRACE_SCOPE("v4l2.buffer_available");
+
 	FrameBuffer *buffer = dequeueBuffer();
 	if (!buffer)
 		return;
@@ -1768,6 +1775,10 @@ FrameBuffer *V4L2VideoDevice::dequeueBuffer()
 	buffer->metadata_.timestamp = buf.timestamp.tv_sec * 1000000000ULL
 				    + buf.timestamp.tv_usec * 1000ULL;
 
+	LIBCAMERA_TRACEPOINT(v4l2_dequeue_buffer, deviceNode().c_str(), buffer,
+			     buf.index, buf.sequence, buffer->metadata_.timestamp,
+			     buffer->metadata_.status);
+
 	if (V4L2_TYPE_IS_OUTPUT(buf.type))
 		return buffer;
 
@@ -7,10 +7,14 @@
 
 #include "libcamera/internal/yaml_parser.h"
 
+#include <algorithm>
+#include <charconv>
 #include <cstdlib>
 #include <errno.h>
 #include <functional>
 #include <limits>
+#include <unordered_set>
+#include <vector>
 
 #include <libcamera/base/file.h>
 #include <libcamera/base/log.h>
@@ -37,6 +41,41 @@ void setOk(bool *ok, bool result)
 		*ok = result;
 }
 
+/*
+ * Parse a numerical value with std::from_chars(), which, unlike the strto*()
+ * functions, doesn't depend on the locale, skip whitespace or accept a minus
+ * sign for unsigned types, and doesn't need to report errors through errno.
+ */
+template<typename T>
+bool parseNumber(std::string_view str, T &value)
+{
+	const char *end = str.data() + str.size();
+	auto [ptr, ec] = std::from_chars(str.data(), end, value);
+
+	return ec == std::errc() && ptr == end && ptr != str.data();
+}
+
+#if !defined(__cpp_lib_to_chars)
+/*
+ * Fall back to strtod() for standard libraries that don't implement
+ * std::from_chars() for floating point types. The values are guaranteed to be
+ * NUL-terminated.
+ */
+template<>
+bool parseNumber(std::string_view str, double &value)
+{
+	if (str.empty())
+		return false;
+
+	char *end;
+
+	errno = 0;
+	value = std::strtod(str.data(), &end);
+
+	return end == str.data() + str.size() && errno != ERANGE;
+}
+#endif
+
 } /* namespace */
 
 /**
@@ -46,8 +85,25 @@ void setOk(bool *ok, bool result)
  * The YamlObject class represents the tree structure of YAML content. A
  * YamlObject can be a dictionary or list of YamlObjects or a value if a tree
  * leaf.
+ *
+ * All the objects of a tree, their values and the dictionary keys are stored
+ * in a few contiguous arrays owned by the root object. Dictionaries are
+ * stored as arrays of entries sorted by key, with the keys interned. The
+ * objects of a tree are thus only valid as long as the root object exists.
  */
 
+#ifndef __DOXYGEN__
+
+struct YamlObject::Storage {
+	std::unique_ptr<YamlObject[]> objects;
+	std::vector<const YamlObject *> listEntries;
+	std::vector<DictEntry> dictEntries;
+	std::string values;
+	std::unordered_set<std::string> keys;
+};
+
+#endif /* __DOXYGEN__ */
+
 YamlObject::YamlObject()
 	: type_(Type::Value)
 {
@@ -152,7 +208,7 @@ int16_t YamlObject::get(const int16_t &defaultValue, bool *ok) const
 	char *end;
 
 	errno = 0;
-	int16_t value = std::strtol(value_.c_str(), &end, 10);
+	int16_t value = std::strtol(value_.data(), &end, 10);
 
 	if ('\0' != *end || errno == ERANGE ||
 	    value < std::numeric_limits<int16_t>::min() ||
@@ -188,7 +244,7 @@ uint16_t YamlObject::get(const uint16_t &defaultValue, bool *ok) const
 	char *end;
 
 	errno = 0;
-	uint16_t value = std::strtoul(value_.c_str(), &end, 10);
+	uint16_t value = std::strtoul(value_.data(), &end, 10);
 
 	if ('\0' != *end || errno == ERANGE ||
 	    value < std::numeric_limits<uint16_t>::min() ||
@@ -213,7 +269,7 @@ int32_t YamlObject::get(const int32_t &defaultValue, bool *ok) const
 	char *end;
 
 	errno = 0;
-	long value = std::strtol(value_.c_str(), &end, 10);
+	long value = std::strtol(value_.data(), &end, 10);
 
 	if ('\0' != *end || errno == ERANGE ||
 	    value < std::numeric_limits<int32_t>::min() ||
@@ -249,7 +305,7 @@ uint32_t YamlObject::get(const uint32_t &defaultValue, bool *ok) const
 	char *end;
 
 	errno = 0;
-	unsigned long value = std::strtoul(value_.c_str(), &end, 10);
+	unsigned long value = std::strtoul(value_.data(), &end, 10);
 
 	if ('\0' != *end || errno == ERANGE ||
 	    value < std::numeric_limits<uint32_t>::min() ||
@@ -274,7 +330,7 @@ double YamlObject::get(const double &defaultValue, bool *ok) const
 	char *end;
 
 	errno = 0;
-	double value = std::strtod(value_.c_str(), &end);
+	double value = std::strtod(value_.data(), &end);
 
 	if ('\0' != *end || errno == ERANGE)
 		return defaultValue;
@@ -292,7 +348,7 @@ std::string YamlObject::get(const std::string &defaultValue, bool *ok) const
 		return defaultValue;
 
 	setOk(ok, true);
-	return value_;
+	return std::string(value_);
 }
 
 template<>
@@ -325,6 +381,108 @@ Size YamlObject::get(const Size &defaultValue, bool *ok) const
 
 #endif /* __DOXYGEN__ */
 
+/**
+ * \fn template<typename T> YamlObject::getList<T>(Span<T> values) const
+ * \brief Parse the YamlObject as a list of \a T values
+ * \param[out] values The parsed values
+ *
+ * This function parses the YamlObject as a list of numerical values, and
+ * stores them in the caller-provided \a values. The YamlObject must be a list
+ * of exactly values.size() values, all of which must be convertible to \a T.
+ * This is the preferred way to retrieve numerical tables, as it avoids the
+ * overhead of calling get() on each element.
+ *
+ * Values are parsed strictly, leading and trailing whitespace as well as a
+ * leading plus sign are not accepted.
+ *
+ * When parsing fails, the content of \a values is undefined.
+ *
+ * \return True if the list has been parsed successfully, false otherwise
+ */
+template<typename T,
+	 typename std::enable_if_t<
+		 std::is_same_v<double, T> ||
+		 std::is_same_v<int16_t, T> ||
+		 std::is_same_v<uint16_t, T> ||
+		 std::is_same_v<int32_t, T> ||
+		 std::is_same_v<uint32_t, T>> *>
+bool YamlObject::getList(Span<T> values) const
+{
+	if (type_ != Type::List || list_.size() != values.size())
+		return false;
+
+	for (std::size_t i = 0; i < values.size(); ++i) {
+		const YamlObject *obj = list_[i];
+
+		if (obj->type_ != Type::Value ||
+		    !parseNumber(obj->value_, values[i]))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * \fn template<typename T> YamlObject::getTable<T>(Span<T> values,
+ *	std::size_t rows, std::size_t columns) const
+ * \brief Parse the YamlObject as a two-dimensional table of \a T values
+ * \param[out] values The parsed values, in row-major order
+ * \param[in] rows The number of rows of the table
+ * \param[in] columns The number of columns of the table
+ *
+ * This function parses the YamlObject as a list of \a rows lists, each of
+ * them containing \a columns numerical values, and stores the values in row
+ * major order in the caller-provided \a values. The size of \a values must
+ * be equal to \a rows multiplied by \a columns.
+ *
+ * Values are parsed with the same rules as getList(). When parsing fails, the
+ * content of \a values is undefined.
+ *
+ * \return True if the table has been parsed successfully, false otherwise
+ */
+template<typename T,
+	 typename std::enable_if_t<
+		 std::is_same_v<double, T> ||
+		 std::is_same_v<int16_t, T> ||
+		 std::is_same_v<uint16_t, T> ||
+		 std::is_same_v<int32_t, T> ||
+		 std::is_same_v<uint32_t, T>> *>
+bool YamlObject::getTable(Span<T> values, std::size_t rows,
+			  std::size_t columns) const
+{
+	if (type_ != Type::List || list_.size() != rows ||
+	    values.size() != rows * columns)
+		return false;
+
+	for (std::size_t i = 0; i < rows; ++i) {
+		if (!list_[i]->getList(values.subspan(i * columns, columns)))
+			return false;
+	}
+
+	return true;
+}
+
+#ifndef __DOXYGEN__
+
+template bool YamlObject::getList(Span<double> values) const;
+template bool YamlObject::getList(Span<int16_t> values) const;
+template bool YamlObject::getList(Span<uint16_t> values) const;
+template bool YamlObject::getList(Span<int32_t> values) const;
+template bool YamlObject::getList(Span<uint32_t> values) const;
+
+template bool YamlObject::getTable(Span<double> values, std::size_t rows,
+				   std::size_t columns) const;
+template bool YamlObject::getTable(Span<int16_t> values, std::size_t rows,
+				   std::size_t columns) const;
+template bool YamlObject::getTable(Span<uint16_t> values, std::size_t rows,
+				   std::size_t columns) const;
+template bool YamlObject::getTable(Span<int32_t> values, std::size_t rows,
+				   std::size_t columns) const;
+template bool YamlObject::getTable(Span<uint32_t> values, std::size_t rows,
+				   std::size_t columns) const;
+
+#endif /* __DOXYGEN__ */
+
 /**
  * \fn YamlObject::asDict() const
  * \brief Wrap a dictionary YamlObject in an adapter that exposes iterators
@@ -382,6 +540,18 @@ const YamlObject &YamlObject::operator[](std::size_t index) const
 	return *list_[index];
 }
 
+namespace {
+
+struct DictEntryLess {
+	template<typename Entry>
+	bool operator()(const Entry &entry, const std::string &key) const
+	{
+		return *entry.key < key;
+	}
+};
+
+} /* namespace */
+
 /**
  * \fn YamlObject::contains()
  * \brief Check if an element of a dictionary exists
@@ -395,10 +565,10 @@ const YamlObject &YamlObject::operator[](std::size_t index) const
  */
 bool YamlObject::contains(const std::string &key) const
 {
-	if (dictionary_.find(key) == dictionary_.end())
-		return false;
+	auto iter = std::lower_bound(dictionary_.begin(), dictionary_.end(),
+				     key, DictEntryLess());
 
-	return true;
+	return iter != dictionary_.end() && *iter->key == key;
 }
 
 /**
@@ -414,11 +584,15 @@ bool YamlObject::contains(const std::string &key) const
  */
 const YamlObject &YamlObject::operator[](const std::string &key) const
 {
-	if (type_ != Type::Dictionary || !contains(key))
+	if (type_ != Type::Dictionary)
+		return empty;
+
+	auto iter = std::lower_bound(dictionary_.begin(), dictionary_.end(),
+				     key, DictEntryLess());
+	if (iter == dictionary_.end() || *iter->key != key)
 		return empty;
 
-	auto iter = dictionary_.find(key);
-	return *iter->second;
+	return *iter->value;
 }
 
 #ifndef __DOXYGEN__
@@ -442,18 +616,44 @@ private:
 	};
 	using EventPtr = std::unique_ptr<yaml_event_t, EventDeleter>;
 
+	/*
+	 * Flat description of a parsed object. Values are stored as offsets in
+	 * the values_ string, and children as a range of the children_ array.
+	 */
+	struct Node {
+		YamlObject::Type type;
+		std::size_t offset;
+		std::size_t size;
+	};
+
+	struct Child {
+		const std::string *key;
+		std::size_t node;
+	};
+
 	static int yamlRead(void *data, unsigned char *buffer, size_t size,
 			    size_t *sizeRead);
 
 	EventPtr nextEvent();
 
-	void readValue(std::string &value, EventPtr event);
+	void readValue(std::size_t node, EventPtr event);
+	const std::string *readKey(EventPtr event);
 	int parseDictionaryOrList(YamlObject::Type type,
 				  const std::function<int(EventPtr event)> &parseItem);
-	int parseNextYamlObject(YamlObject &yamlObject, EventPtr event);
+	int parseNextYamlObject(std::size_t node, EventPtr event);
+	void buildTree(YamlObject &root);
 
 	bool parserValid_;
 	yaml_parser_t parser_;
+
+	File *file_;
+	Span<uint8_t> data_;
+
+	std::vector<Node> nodes_;
+	std::vector<Child> children_;
+	std::vector<Child> pending_;
+	std::string values_;
+	std::unordered_set<std::string> keys_;
 };
 
 /**
@@ -462,9 +662,14 @@ private:
  *
  * The YamlParserContext class stores the internal yaml_parser_t and provides
  * helper functions to do event-based parsing for YAML files.
+ *
+ * Parsing is performed in two passes. The YAML events are first recorded in
+ * flat arrays of nodes, children, values and interned keys. The YamlObject
+ * tree is then built in one go from those arrays, with all objects allocated
+ * in a single array owned by the root object.
  */
 YamlParserContext::YamlParserContext()
-	: parserValid_(false)
+	: parserValid_(false), file_(nullptr)
 {
 }
 
@@ -478,6 +683,9 @@ YamlParserContext::~YamlParserContext()
 		yaml_parser_delete(&parser_);
 		parserValid_ = false;
 	}
+
+	if (!data_.empty())
+		file_->unmap(data_.data());
 }
 
 /**
@@ -489,6 +697,9 @@ YamlParserContext::~YamlParserContext()
  * with a file to create an internal parser. The file needs to stay valid until
  * parsing completes.
  *
+ * The file is memory-mapped when possible to let the parser read its content
+ * directly. Files that can't be mapped are read through the File API instead.
+ *
  * \return 0 on success or a negative error code otherwise
  * \retval -EINVAL The parser has failed to initialize
  */
@@ -500,7 +711,25 @@ int YamlParserContext::init(File &file)
 		return -EINVAL;
 	}
 	parserValid_ = true;
-	yaml_parser_set_input(&parser_, &YamlParserContext::yamlRead, &file);
+
+	file_ = &file;
+	data_ = file.map();
+	if (data_.empty()) {
+		yaml_parser_set_input(&parser_, &YamlParserContext::yamlRead, &file);
+		return 0;
+	}
+
+	yaml_parser_set_input_string(&parser_, data_.data(), data_.size());
+
+	/*
+	 * Every scalar takes at least two bytes in the file, including its
+	 * separator, which bounds the storage needed for the values and nodes.
+	 * Reserving it upfront avoids copies when growing the arrays, and is
+	 * cheap as memory that is reserved but not used is never touched.
+	 */
+	values_.reserve(data_.size() + 1);
+	nodes_.reserve(data_.size() / 2 + 1);
+	children_.reserve(data_.size() / 2 + 1);
 
 	return 0;
 }
@@ -563,7 +792,8 @@ int YamlParserContext::parseContent(YamlObject &yamlObject)
 
 	/* Parse the root object. */
 	event = nextEvent();
-	if (parseNextYamlObject(yamlObject, std::move(event)))
+	nodes_.push_back({ YamlObject::Type::Value, 0, 0 });
+	if (parseNextYamlObject(0, std::move(event)))
 		return -EINVAL;
 
 	/* Check end of the YAML file. */
@@ -575,21 +805,48 @@ int YamlParserContext::parseContent(YamlObject &yamlObject)
 	if (!event || event->type != YAML_STREAM_END_EVENT)
 		return -EINVAL;
 
+	buildTree(yamlObject);
+
 	return 0;
 }
 
 /**
  * \fn YamlParserContext::readValue()
- * \brief Parse event scalar and fill its content into a string
- * \param[in] value The string reference to fill value
+ * \brief Parse event scalar and store its content as the value of a node
+ * \param[in] node The index of the node
  *
  * A helper function to parse a scalar event as string. The caller needs to
- * guarantee the event is of scaler type.
+ * guarantee the event is of scaler type. The value is appended to the values
+ * storage with a terminating NUL character, to allow parsing it with the C
+ * library string to number conversion functions.
  */
-void YamlParserContext::readValue(std::string &value, EventPtr event)
+void YamlParserContext::readValue(std::size_t node, EventPtr event)
 {
-	value.assign(reinterpret_cast<char *>(event->data.scalar.value),
-		     event->data.scalar.length);
+	const char *value = reinterpret_cast<char *>(event->data.scalar.value);
+	std::size_t length = event->data.scalar.length;
+
+	nodes_[node].offset = values_.size();
+	nodes_[node].size = length;
+
+	values_.append(value, length);
+	values_.push_back('\0');
+}
+
+/**
+ * \fn YamlParserContext::readKey()
+ * \brief Parse event scalar as a dictionary key
+ *
+ * Keys are interned, as the same keys are typically repeated many times in
+ * tuning files.
+ *
+ * \return A pointer to the interned key
+ */
+const std::string *YamlParserContext::readKey(EventPtr event)
+{
+	std::string key(reinterpret_cast<char *>(event->data.scalar.value),
+			event->data.scalar.length);
+
+	return &*keys_.insert(std::move(key)).first;
 }
 
 /**
@@ -643,40 +900,56 @@ int YamlParserContext::parseDictionaryOrList(YamlObject::Type type,
 
 /**
  * \fn YamlParserContext::parseNextYamlObject()
- * \brief Parse next YAML event and read it as a YamlObject
- * \param[in] yamlObject The result of YamlObject
+ * \brief Parse next YAML event and read it as a node
+ * \param[in] node The index of the node to fill
  * \param[in] event The leading event of the object
  *
- * Parse next YAML object separately as a value, list or dictionary.
+ * Parse next YAML object separately as a value, list or dictionary. The
+ * children of lists and dictionaries are accumulated on a pending stack while
+ * parsing, and moved to the children array when the container ends, in order
+ * to store the children of each container contiguously.
  *
  * \return 0 on success or a negative error code otherwise
  * \retval -EINVAL Fail to parse the YAML file.
  */
-int YamlParserContext::parseNextYamlObject(YamlObject &yamlObject, EventPtr event)
+int YamlParserContext::parseNextYamlObject(std::size_t node, EventPtr event)
 {
 	if (!event)
 		return -EINVAL;
 
 	switch (event->type) {
 	case YAML_SCALAR_EVENT:
-		yamlObject.type_ = YamlObject::Type::Value;
-		readValue(yamlObject.value_, std::move(event));
+		nodes_[node].type = YamlObject::Type::Value;
+		readValue(node, std::move(event));
 		return 0;
 
-	case YAML_SEQUENCE_START_EVENT: {
-		yamlObject.type_ = YamlObject::Type::List;
-		auto &list = yamlObject.list_;
-		auto handler = [this, &list](EventPtr evt) {
-			list.emplace_back(new YamlObject());
-			return parseNextYamlObject(*list.back(), std::move(evt));
-		};
-		return parseDictionaryOrList(YamlObject::Type::List, handler);
+	case YAML_SEQUENCE_START_EVENT:
+	case YAML_MAPPING_START_EVENT:
+		break;
+
+	default:
+		LOG(YamlParser, Error) << "Invalid YAML file";
+		return -EINVAL;
 	}
 
-	case YAML_MAPPING_START_EVENT: {
-		yamlObject.type_ = YamlObject::Type::Dictionary;
-		auto &dictionary = yamlObject.dictionary_;
-		auto handler = [this, &dictionary](EventPtr evtKey) {
+	YamlObject::Type type = event->type == YAML_SEQUENCE_START_EVENT
+			      ? YamlObject::Type::List
+			      : YamlObject::Type::Dictionary;
+	nodes_[node].type = type;
+
+	std::size_t first = pending_.size();
+	int ret;
+
+	if (type == YamlObject::Type::List) {
+		auto handler = [this](EventPtr evt) {
+			std::size_t child = nodes_.size();
+			nodes_.push_back({ YamlObject::Type::Value, 0, 0 });
+			pending_.push_back({ nullptr, child });
+			return parseNextYamlObject(child, std::move(evt));
+		};
+		ret = parseDictionaryOrList(type, handler);
+	} else {
+		auto handler = [this](EventPtr evtKey) {
 			/* Parse key */
 			if (evtKey->type != YAML_SCALAR_EVENT) {
 				LOG(YamlParser, Error) << "Expect key at line: "
@@ -686,24 +959,115 @@ int YamlParserContext::parseNextYamlObject(YamlObject &yamlObject, EventPtr even
 				return -EINVAL;
 			}
 
-			std::string key;
-			readValue(key, std::move(evtKey));
+			const std::string *key = readKey(std::move(evtKey));
 
 			/* Parse value */
 			EventPtr evtValue = nextEvent();
 			if (!evtValue)
 				return -EINVAL;
 
-			auto elem = dictionary.emplace(key, std::make_unique<YamlObject>());
-			return parseNextYamlObject(*elem.first->second.get(), std::move(evtValue));
+			std::size_t child = nodes_.size();
+			nodes_.push_back({ YamlObject::Type::Value, 0, 0 });
+			pending_.push_back({ key, child });
+			return parseNextYamlObject(child, std::move(evtValue));
 		};
-		return parseDictionaryOrList(YamlObject::Type::Dictionary, handler);
+		ret = parseDictionaryOrList(type, handler);
 	}
 
-	default:
-		LOG(YamlParser, Error) << "Invalid YAML file";
-		return -EINVAL;
+	if (ret)
+		return ret;
+
+	nodes_[node].offset = children_.size();
+	nodes_[node].size = pending_.size() - first;
+
+	children_.insert(children_.end(), pending_.begin() + first,
+			 pending_.end());
+	pending_.resize(first);
+
+	return 0;
+}
+
+/**
+ * \fn YamlParserContext::buildTree()
+ * \brief Build the YamlObject tree from the parsed nodes
+ * \param[in] root The root YamlObject
+ *
+ * Allocate all the objects of the tree in a single array, and move the parsed
+ * values and keys to a storage owned by the root object. Dictionary entries
+ * are sorted by key to allow binary searches. As with the previous
+ * std::map-based storage, the first occurrence of a duplicated key wins.
+ */
+void YamlParserContext::buildTree(YamlObject &root)
+{
+	auto storage = std::make_unique<YamlObject::Storage>();
+
+	/* Node 0 is the root, which is allocated by the caller. */
+	storage->objects.reset(new YamlObject[nodes_.size() - 1]);
+	storage->values = std::move(values_);
+	storage->keys = std::move(keys_);
+
+	/*
+	 * Reserve the entries upfront, the lists and dictionaries reference
+	 * them and they must thus not be reallocated.
+	 */
+	storage->listEntries.reserve(children_.size());
+	storage->dictEntries.reserve(children_.size());
+
+	auto object = [&](std::size_t index) -> YamlObject & {
+		return index ? storage->objects[index - 1] : root;
+	};
+
+	for (std::size_t i = 0; i < nodes_.size(); ++i) {
+		const Node &node = nodes_[i];
+		YamlObject &obj = object(i);
+
+		obj.type_ = node.type;
+
+		switch (node.type) {
+		case YamlObject::Type::Value:
+			obj.value_ = std::string_view(storage->values.data() + node.offset,
+						      node.size);
+			break;
+
+		case YamlObject::Type::List: {
+			auto &entries = storage->listEntries;
+			std::size_t first = entries.size();
+
+			for (std::size_t j = 0; j < node.size; ++j)
+				entries.push_back(&object(children_[node.offset + j].node));
+
+			obj.list_ = { entries.data() + first, node.size };
+			break;
+		}
+
+		case YamlObject::Type::Dictionary: {
+			auto &entries = storage->dictEntries;
+			std::size_t first = entries.size();
+
+			for (std::size_t j = 0; j < node.size; ++j) {
+				const Child &child = children_[node.offset + j];
+				entries.push_back({ child.key, &object(child.node) });
+			}
+
+			auto begin = entries.begin() + first;
+			std::stable_sort(begin, entries.end(),
+					 [](const auto &a, const auto &b) {
+						 return *a.key < *b.key;
+					 });
+			auto end = std::unique(begin, entries.end(),
+					       [](const auto &a, const auto &b) {
+						       return a.key == b.key;
+					       });
+			entries.erase(end, entries.end());
+
+			obj.dictionary_ = { entries.data() + first,
+					    entries.size() - first };
+			break;
+		}
+		}
 	}
+
+	root.storage_ = std::move(storage);
 }
 
 #endif /* __DOXYGEN__ */
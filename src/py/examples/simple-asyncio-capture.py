@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+
+# SPDX-License-Identifier: BSD-3-Clause
+# Copyright (C) 2022, Google Inc.
+
+# A simple capture example using asyncio:
+# - Capture frames from a camera with libcamera.utils.RequestWaiter
+# - Measure the CPU time spent per frame
+# - Compare with the selectors based event loop used by cam.py, with the
+#   --selectors argument
+
+import argparse
+import asyncio
+import libcamera as libcam
+import libcamera.utils
+import selectors
+import sys
+import time
+
+
+class Capture:
+    def __init__(self, cm, cam, num_frames):
+        self.cm = cm
+        self.cam = cam
+        self.num_frames = num_frames
+        self.frames = 0
+        self.wakeups = 0
+
+        cam_config = cam.generate_configuration([libcam.StreamRole.Viewfinder])
+        stream_config = cam_config.at(0)
+
+        ret = cam.configure(cam_config)
+        assert ret == 0
+
+        stream = stream_config.stream
+
+        self.allocator = libcam.FrameBufferAllocator(cam)
+        ret = self.allocator.allocate(stream)
+        assert ret > 0
+
+        self.reqs = []
+
+        for i, buffer in enumerate(self.allocator.buffers(stream)):
+            req = cam.create_request(i)
+            ret = req.add_buffer(stream, buffer)
+            assert ret == 0
+
+            self.reqs.append(req)
+
+        print(f'Capturing {num_frames} frames with {stream_config}')
+
+    def start(self):
+        ret = self.cam.start()
+        assert ret == 0
+
+        for req in self.reqs:
+            ret = self.cam.queue_request(req)
+            assert ret == 0
+
+    def stop(self):
+        ret = self.cam.stop()
+        assert ret == 0
+
+    # Return True when enough frames have been captured
+    def handle_requests(self, reqs):
+        self.wakeups += 1
+
+        for req in reqs:
+            self.frames += 1
+            if self.frames >= self.num_frames:
+                return True
+
+            req.reuse()
+            self.cam.queue_request(req)
+
+        return False
+
+    def run_selectors(self):
+        sel = selectors.DefaultSelector()
+        sel.register(self.cm.event_fd, selectors.EVENT_READ)
+
+        while True:
+            sel.select()
+            if self.handle_requests(self.cm.get_ready_requests()):
+                break
+
+    async def run_asyncio(self):
+        async with libcamera.utils.RequestWaiter(self.cm) as waiter:
+            async for reqs in waiter:
+                if self.handle_requests(reqs):
+                    break
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('-c', '--camera', type=int, default=0,
+                        help='Index of the camera to use')
+    parser.add_argument('-n', '--frames', type=int, default=300,
+                        help='Number of frames to capture')
+    parser.add_argument('--selectors', action='store_true',
+                        help='Use a selectors based event loop instead of asyncio')
+    args = parser.parse_args()
+
+    cm = libcam.CameraManager.singleton()
+    cam = cm.cameras[args.camera]
+
+    ret = cam.acquire()
+    assert ret == 0
+
+    capture = Capture(cm, cam, args.frames)
+
+    start_cpu = time.process_time()
+    start = time.monotonic()
+
+    capture.start()
+
+    if args.selectors:
+        capture.run_selectors()
+    else:
+        asyncio.run(capture.run_asyncio())
+
+    end = time.monotonic()
+    end_cpu = time.process_time()
+
+    capture.stop()
+
+    ret = cam.release()
+    assert ret == 0
+
+    elapsed = end - start
+    cpu = end_cpu - start_cpu
+
+    print(f'{capture.frames} frames in {elapsed:.2f} s ({capture.frames / elapsed:.2f} fps), '
+          f'{capture.wakeups} wakeups, '
+          f'{cpu / capture.frames * 1000000:.0f} us of CPU time per frame')
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -5,6 +5,8 @@
  * Python bindings
  */
 
+#include <map>
+#include <memory>
 #include <mutex>
 #include <stdexcept>
 #include <sys/eventfd.h>
@@ -14,6 +16,9 @@
 
 #include <libcamera/libcamera.h>
 
+#include "libcamera/internal/formats.h"
+#include "libcamera/internal/mapped_framebuffer.h"
+
 #include <pybind11/functional.h>
 #include <pybind11/smart_holder.h>
 #include <pybind11/stl.h>
@@ -79,31 +84,173 @@ static ControlValue controlValueMaybeArray(const py::object &ob)
 	return ControlValue(ob.cast<T>());
 }
 
-static ControlValue pyToControlValue(const py::object &ob, ControlType type)
+using ControlValueConverter = ControlValue (*)(const py::object &ob);
+
+static ControlValueConverter controlValueConverter(ControlType type)
 {
 	switch (type) {
 	case ControlTypeBool:
-		return ControlValue(ob.cast<bool>());
+		return [](const py::object &ob) { return ControlValue(ob.cast<bool>()); };
 	case ControlTypeByte:
-		return controlValueMaybeArray<uint8_t>(ob);
+		return controlValueMaybeArray<uint8_t>;
 	case ControlTypeInteger32:
-		return controlValueMaybeArray<int32_t>(ob);
+		return controlValueMaybeArray<int32_t>;
 	case ControlTypeInteger64:
-		return controlValueMaybeArray<int64_t>(ob);
+		return controlValueMaybeArray<int64_t>;
 	case ControlTypeFloat:
-		return controlValueMaybeArray<float>(ob);
+		return controlValueMaybeArray<float>;
 	case ControlTypeString:
-		return ControlValue(ob.cast<std::string>());
+		return [](const py::object &ob) { return ControlValue(ob.cast<std::string>()); };
 	case ControlTypeRectangle:
-		return ControlValue(ob.cast<Rectangle>());
+		return [](const py::object &ob) { return ControlValue(ob.cast<Rectangle>()); };
 	case ControlTypeSize:
-		return ControlValue(ob.cast<Size>());
+		return [](const py::object &ob) { return ControlValue(ob.cast<Size>()); };
 	case ControlTypeNone:
 	default:
 		throw std::runtime_error("Control type not implemented");
 	}
 }
 
+static ControlValue pyToControlValue(const py::object &ob, ControlType type)
+{
+	return controlValueConverter(type)(ob);
+}
+
+/*
+ * A setter for a control, bound to the control ID. The conversion from
+ * Python objects is selected once when the setter is created, instead of for
+ * every value being set.
+ */
+class PyControlSetter
+{
+public:
+	PyControlSetter(const ControlId *id)
+		: id_(id->id()), convert_(controlValueConverter(id->type()))
+	{
+	}
+
+	void set(Request &request, const py::object &value) const
+	{
+		request.controls().set(id_, convert_(value));
+	}
+
+	void set(const std::vector<Request *> &requests, const py::object &value) const
+	{
+		ControlValue cv = convert_(value);
+
+		for (Request *request : requests)
+			request->controls().set(id_, cv);
+	}
+
+private:
+	unsigned int id_;
+	ControlValueConverter convert_;
+};
+
+/*
+ * Map a FrameBuffer on first use, and cache the mapping in the Python
+ * FrameBuffer object. The mapping is released with the Python object, or when
+ * the last plane view referencing it is destroyed if it outlives the object.
+ */
+static std::shared_ptr<MappedFrameBuffer> mapFrameBuffer(py::handle pyBuffer)
+{
+	using Mapping = std::shared_ptr<MappedFrameBuffer>;
+
+	if (py::hasattr(pyBuffer, "_mapping")) {
+		py::capsule cached = pyBuffer.attr("_mapping");
+		return *static_cast<Mapping *>(cached.get_pointer());
+	}
+
+	const FrameBuffer *buffer = pyBuffer.cast<const FrameBuffer *>();
+	auto mapped = std::make_shared<MappedFrameBuffer>(buffer,
+							  MappedFrameBuffer::MapFlag::ReadWrite);
+	if (!mapped->isValid())
+		throw std::system_error(-mapped->error(), std::generic_category(),
+					"Failed to map FrameBuffer");
+
+	pyBuffer.attr("_mapping") = py::capsule(new Mapping(mapped), [](void *mapping) {
+		delete static_cast<Mapping *>(mapping);
+	});
+
+	return mapped;
+}
+
+/*
+ * A view of a mapped FrameBuffer, exposing its planes through the Python buffer
+ * protocol. The planes reference the mapping, which stays valid as long as
+ * any view of the data (such as a numpy array) exists.
+ */
+class PyFrameBufferView
+{
+public:
+	struct Plane {
+		std::shared_ptr<MappedFrameBuffer> mapping;
+		uint8_t *data;
+		std::vector<ssize_t> shape;
+		std::vector<ssize_t> strides;
+	};
+
+	PyFrameBufferView(py::handle pyBuffer, const StreamConfiguration *config)
+		: buffer_(pyBuffer.cast<FrameBuffer *>())
+	{
+		std::shared_ptr<MappedFrameBuffer> mapping = mapFrameBuffer(pyBuffer);
+		const std::vector<MappedBuffer::Plane> &planes = mapping->planes();
+
+		for (unsigned int i = 0; i < planes.size(); i++) {
+			Plane plane{ mapping, planes[i].data(),
+				     { static_cast<ssize_t>(planes[i].size()) }, { 1 } };
+
+			if (config && planes.size() == PixelFormatInfo::info(config->pixelFormat).numPlanes())
+				setLayout(plane, *config, i, planes[i].size());
+
+			planes_.push_back(std::move(plane));
+		}
+	}
+
+	FrameBuffer *buffer() const { return buffer_; }
+	const std::vector<Plane> &planes() const { return planes_; }
+
+private:
+	/*
+	 * Describe the plane as a 2D array of bytes of the visible image size,
+	 * or a 3D array of pixels for RGB formats, skipping the line padding.
+	 */
+	static void setLayout(Plane &plane, const StreamConfiguration &config,
+			      unsigned int index, size_t length)
+	{
+		const PixelFormatInfo &info = PixelFormatInfo::info(config.pixelFormat);
+		const PixelFormatInfo::Plane &p = info.planes[index];
+
+		if (!config.stride || !p.bytesPerGroup)
+			return;
+
+		/* Compute the stride of the plane as V4L2VideoDevice does. */
+		ssize_t stride = config.stride * p.bytesPerGroup
+			       / info.planes[0].bytesPerGroup;
+		ssize_t lines = (config.size.height + p.verticalSubSampling - 1)
+			      / p.verticalSubSampling;
+		ssize_t bytesPerLine = info.stride(config.size.width, index);
+
+		if ((lines - 1) * stride + bytesPerLine > static_cast<ssize_t>(length))
+			return;
+
+		if (info.colourEncoding == PixelFormatInfo::ColourEncodingRGB &&
+		    info.pixelsPerGroup == 1 && !info.packed) {
+			ssize_t width = config.size.width;
+			ssize_t bpp = p.bytesPerGroup;
+
+			plane.shape = { lines, width, bpp };
+			plane.strides = { stride, bpp, 1 };
+		} else {
+			plane.shape = { lines, bytesPerLine };
+			plane.strides = { stride, 1 };
+		}
+	}
+
+	FrameBuffer *buffer_;
+	std::vector<Plane> planes_;
+};
+
 static std::weak_ptr<CameraManager> gCameraManager;
 static int gEventfd;
 static std::mutex gReqlistMutex;
@@ -154,11 +301,15 @@ PYBIND11_MODULE(_libcamera, m)
 	auto pyStreamConfiguration = py::class_<StreamConfiguration>(m, "StreamConfiguration");
 	auto pyStreamFormats = py::class_<StreamFormats>(m, "StreamFormats");
 	auto pyFrameBufferAllocator = py::class_<FrameBufferAllocator>(m, "FrameBufferAllocator");
-	auto pyFrameBuffer = py::class_<FrameBuffer>(m, "FrameBuffer");
+	auto pyFrameBuffer = py::class_<FrameBuffer>(m, "FrameBuffer", py::dynamic_attr());
 	auto pyFrameBufferPlane = py::class_<FrameBuffer::Plane>(pyFrameBuffer, "Plane");
+	auto pyFrameBufferView = py::class_<PyFrameBufferView>(m, "FrameBufferView");
+	auto pyFrameBufferViewPlane = py::class_<PyFrameBufferView::Plane>(pyFrameBufferView, "Plane",
+									   py::buffer_protocol());
 	auto pyStream = py::class_<Stream>(m, "Stream");
 	auto pyControlId = py::class_<ControlId>(m, "ControlId");
 	auto pyControlInfo = py::class_<ControlInfo>(m, "ControlInfo");
+	auto pyControlSetter = py::class_<PyControlSetter>(m, "ControlSetter");
 	auto pyRequest = py::class_<Request>(m, "Request");
 	auto pyRequestStatus = py::enum_<Request::Status>(pyRequest, "Status");
 	auto pyRequestReuse = py::enum_<Request::ReuseFlag>(pyRequest, "Reuse");
@@ -214,14 +365,22 @@ PYBIND11_MODULE(_libcamera, m)
 		})
 
 		.def("get_ready_requests", [](CameraManager &) {
-			uint8_t buf[8];
-
-			if (read(gEventfd, buf, 8) != 8)
-				throw std::system_error(errno, std::generic_category());
-
 			std::vector<Request *> v;
 
 			{
+				/*
+				 * Release the GIL while draining the eventfd,
+				 * which may block if no request has completed,
+				 * and while contending with the completion
+				 * handler for the list.
+				 */
+				py::gil_scoped_release release;
+
+				uint8_t buf[8];
+
+				if (read(gEventfd, buf, 8) != 8)
+					throw std::system_error(errno, std::generic_category());
+
 				std::lock_guard guard(gReqlistMutex);
 				swap(v, gReqList);
 			}
@@ -317,6 +476,66 @@ PYBIND11_MODULE(_libcamera, m)
 			return ret;
 		})
 
+		/*
+		 * Queue multiple requests in one call, optionally reusing them
+		 * first, without holding the GIL. Queuing stops at the first
+		 * error, the requests before the failing one stay queued.
+		 *
+		 * When reusing the requests, reuse() clears their controls. The
+		 * controls passed to queue_requests() are thus applied to each
+		 * request after it has been reused, right before queueing it,
+		 * while controls set on the requests beforehand are discarded.
+		 */
+		.def("queue_requests", [](Camera &self, const std::vector<Request *> &reqs,
+					  bool reuse,
+					  const std::unordered_map<const ControlId *, py::object> &controls) {
+			std::vector<py::object> py_reqs;
+			py_reqs.reserve(reqs.size());
+
+			/*
+			 * Increase the reference counts, will be dropped in
+			 * CameraManager.get_ready_requests().
+			 */
+			for (Request *req : reqs) {
+				py::object py_req = py::cast(req);
+				py_req.inc_ref();
+				py_reqs.push_back(std::move(py_req));
+			}
+
+			/* Convert the controls once, with the GIL held. */
+			std::vector<std::pair<unsigned int, ControlValue>> values;
+			values.reserve(controls.size());
+			for (const auto &[id, obj] : controls)
+				values.emplace_back(id->id(), pyToControlValue(obj, id->type()));
+
+			size_t queued = 0;
+			int ret = 0;
+
+			{
+				py::gil_scoped_release release;
+
+				for (Request *req : reqs) {
+					if (reuse)
+						req->reuse(Request::ReuseFlag::ReuseBuffers);
+
+					for (const auto &[id, value] : values)
+						req->controls().set(id, value);
+
+					ret = self.queueRequest(req);
+					if (ret)
+						break;
+
+					queued++;
+				}
+			}
+
+			for (size_t i = queued; i < py_reqs.size(); ++i)
+				py_reqs[i].dec_ref();
+
+			return ret;
+		}, py::arg("requests"), py::arg("reuse") = false,
+		   py::arg("controls") = std::unordered_map<const ControlId *, py::object>())
+
 		.def_property_readonly("streams", [](Camera &self) {
 			py::set set;
 			for (auto &s : self.streams()) {
@@ -431,6 +650,30 @@ PYBIND11_MODULE(_libcamera, m)
 		.def_readwrite("offset", &FrameBuffer::Plane::offset)
 		.def_readwrite("length", &FrameBuffer::Plane::length);
 
+	pyFrameBufferView
+		.def(py::init<py::handle, const StreamConfiguration *>(),
+		     py::arg("buffer"), py::arg("config") = nullptr,
+		     py::keep_alive<1, 2>()) /* FrameBufferView keeps FrameBuffer alive */
+		.def_property_readonly("fb", &PyFrameBufferView::buffer)
+		.def_property_readonly("planes", [](PyFrameBufferView &self) {
+			py::tuple t(self.planes().size());
+
+			for (size_t i = 0; i < self.planes().size(); ++i)
+				t[i] = py::cast(self.planes()[i]);
+
+			return t;
+		});
+
+	pyFrameBufferViewPlane
+		.def_buffer([](PyFrameBufferView::Plane &self) {
+			return py::buffer_info(self.data, sizeof(uint8_t),
+					       py::format_descriptor<uint8_t>::format(),
+					       self.shape.size(), self.shape, self.strides);
+		})
+		.def_property_readonly("shape", [](PyFrameBufferView::Plane &self) {
+			return py::tuple(py::cast(self.shape));
+		});
+
 	pyStream
 		.def_property_readonly("configuration", &Stream::configuration);
 
@@ -466,6 +709,13 @@ PYBIND11_MODULE(_libcamera, m)
 				.format(self.toString());
 		});
 
+	pyControlSetter
+		.def(py::init<const ControlId *>())
+		.def("__call__", py::overload_cast<Request &, const py::object &>(&PyControlSetter::set, py::const_),
+		     py::arg("request"), py::arg("value"))
+		.def("__call__", py::overload_cast<const std::vector<Request *> &, const py::object &>(&PyControlSetter::set, py::const_),
+		     py::arg("requests"), py::arg("value"));
+
 	pyRequest
 		/* \todo Fence is not supported, so we cannot expose addBuffer() directly */
 		.def("add_buffer", [](Request &self, const Stream *stream, FrameBuffer *buffer) {
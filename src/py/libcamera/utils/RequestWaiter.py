@@ -0,0 +1,71 @@
+# SPDX-License-Identifier: LGPL-2.1-or-later
+# Copyright (C) 2022, Google Inc.
+
+import asyncio
+import libcamera
+
+
+class RequestWaiter:
+    """
+    Provides completed requests to asyncio coroutines
+
+    The CameraManager event fd is registered as a reader with the running
+    event loop. All requests completed since the last wakeup are collected at
+    once and returned as a batch, either by awaiting wait_requests() or by
+    iterating asynchronously over the RequestWaiter.
+    """
+    def __init__(self, cm: libcamera.CameraManager):
+        self.__cm = cm
+        self.__loop = None
+        self.__event = None
+        self.__reqs = []
+
+    async def __aenter__(self):
+        return self
+
+    async def __aexit__(self, exc_type, exc_value, exc_traceback):
+        self.close()
+
+    def __aiter__(self):
+        return self
+
+    async def __anext__(self) -> list[libcamera.Request]:
+        return await self.wait_requests()
+
+    def __start(self):
+        loop = asyncio.get_running_loop()
+        if self.__loop is loop:
+            return
+
+        if self.__loop:
+            raise RuntimeError('RequestWaiter already used from another event loop')
+
+        loop.add_reader(self.__cm.event_fd, self.__handle_event)
+        self.__loop = loop
+        self.__event = asyncio.Event()
+
+    def __handle_event(self):
+        # The event fd counts the completed requests, a single read drains
+        # them all.
+        self.__reqs += self.__cm.get_ready_requests()
+        self.__event.set()
+
+    def close(self):
+        if not self.__loop:
+            return
+
+        self.__loop.remove_reader(self.__cm.event_fd)
+        self.__loop = None
+        self.__event = None
+
+    async def wait_requests(self) -> list[libcamera.Request]:
+        """Wait for completed requests and return all of them"""
+        self.__start()
+
+        while not self.__reqs:
+            self.__event.clear()
+            await self.__event.wait()
+
+        reqs = self.__reqs
+        self.__reqs = []
+        return reqs
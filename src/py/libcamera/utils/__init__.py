@@ -2,3 +2,4 @@
 # Copyright (C) 2022, Tomi Valkeinen <tomi.valkeinen@ideasonboard.com>
 
 from .MappedFrameBuffer import MappedFrameBuffer
+from .RequestWaiter import RequestWaiter
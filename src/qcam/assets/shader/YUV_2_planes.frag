@@ -9,6 +9,12 @@
 precision mediump float;
 #endif
 
+#if defined(TEXTURE_RG)
+#define CHROMA_2ND g
+#else
+#define CHROMA_2ND a
+#endif
+
 varying vec2 textureOut;
 uniform sampler2D tex_y;
 uniform sampler2D tex_u;
@@ -26,9 +32,9 @@ void main(void)
 	yuv.x = texture2D(tex_y, textureOut).r - 0.063;
 #if defined(YUV_PATTERN_UV)
 	yuv.y = texture2D(tex_u, textureOut).r - 0.500;
-	yuv.z = texture2D(tex_u, textureOut).a - 0.500;
+	yuv.z = texture2D(tex_u, textureOut).CHROMA_2ND - 0.500;
 #elif defined(YUV_PATTERN_VU)
-	yuv.y = texture2D(tex_u, textureOut).a - 0.500;
+	yuv.y = texture2D(tex_u, textureOut).CHROMA_2ND - 0.500;
 	yuv.z = texture2D(tex_u, textureOut).r - 0.500;
 #else
 #error Invalid pattern
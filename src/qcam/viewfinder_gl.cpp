@@ -8,11 +8,17 @@
 #include "viewfinder_gl.h"
 
 #include <QByteArray>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QImage>
+#include <QtGlobal>
 
 #include <libcamera/formats.h>
 
+#ifdef HAVE_EGL
+#include <linux/drm_fourcc.h>
+#endif
+
 #include "../cam/image.h"
 
 static const QList<libcamera::PixelFormat> supportedFormats{
@@ -57,12 +63,19 @@ static const QList<libcamera::PixelFormat> supportedFormats{
 
 ViewFinderGL::ViewFinderGL(QWidget *parent)
 	: QOpenGLWidget(parent), buffer_(nullptr), image_(nullptr),
-	  vertexBuffer_(QOpenGLBuffer::VertexBuffer)
+	  vertexBuffer_(QOpenGLBuffer::VertexBuffer),
+	  dmabufSupported_(false), dmabufImport_(false),
+	  renderStats_(qEnvironmentVariableIsSet("QCAM_RENDER_STATS")),
+	  renderTime_(0), renderFrames_(0)
 {
 }
 
 ViewFinderGL::~ViewFinderGL()
 {
+	makeCurrent();
+	clearDmaBufCache();
+	doneCurrent();
+
 	removeShader();
 }
 
@@ -91,6 +104,22 @@ int ViewFinderGL::setFormat(const libcamera::PixelFormat &format,
 		format_ = format;
 	}
 
+	/*
+	 * The cached DMABUF textures depend on the format, size and stride.
+	 * Drop them and retry importing, even if a previous import failed.
+	 */
+	makeCurrent();
+	clearDmaBufCache();
+	doneCurrent();
+
+	if (dmabufImport_ != dmabufSupported_ && shaderProgram_.isLinked()) {
+		shaderProgram_.release();
+		shaderProgram_.removeShader(fragmentShader_.get());
+		fragmentShader_.reset();
+	}
+
+	dmabufImport_ = dmabufSupported_;
+
 	size_ = size;
 	stride_ = stride;
 
@@ -105,6 +134,14 @@ void ViewFinderGL::stop()
 		buffer_ = nullptr;
 		image_ = nullptr;
 	}
+
+	/* The frame buffers are freed when capture stops. */
+	makeCurrent();
+	clearDmaBufCache();
+	doneCurrent();
+
+	renderTime_ = 0;
+	renderFrames_ = 0;
 }
 
 QImage ViewFinderGL::getCurrentImage()
@@ -317,6 +354,92 @@ bool ViewFinderGL::selectFormat(const libcamera::PixelFormat &format)
 	return ret;
 }
 
+/*
+ * Fill the planes array, indexed by texture unit, with the image plane and
+ * texture layout used to render the current format. Return the number of
+ * textures, or 0 if the format is not supported.
+ */
+unsigned int ViewFinderGL::planeTextures(std::array<PlaneTexture, 3> &planes) const
+{
+	switch (format_) {
+	case libcamera::formats::NV12:
+	case libcamera::formats::NV21:
+	case libcamera::formats::NV16:
+	case libcamera::formats::NV61:
+	case libcamera::formats::NV24:
+	case libcamera::formats::NV42:
+		planes[0] = { 0, GL_LUMINANCE, static_cast<GLsizei>(stride_),
+			      size_.height() };
+		planes[1] = { 1, GL_LUMINANCE_ALPHA,
+			      static_cast<GLsizei>(stride_ / horzSubSample_),
+			      static_cast<GLsizei>(size_.height() / vertSubSample_) };
+		return 2;
+
+	case libcamera::formats::YUV420:
+	case libcamera::formats::YVU420: {
+		/* Texture unit 1 samples U and texture unit 2 samples V. */
+		bool yvu = format_ == libcamera::formats::YVU420;
+
+		planes[0] = { 0, GL_LUMINANCE, static_cast<GLsizei>(stride_),
+			      size_.height() };
+		planes[1] = { yvu ? 2U : 1U, GL_LUMINANCE,
+			      static_cast<GLsizei>(stride_ / horzSubSample_),
+			      static_cast<GLsizei>(size_.height() / vertSubSample_) };
+		planes[2] = { yvu ? 1U : 2U, GL_LUMINANCE,
+			      static_cast<GLsizei>(stride_ / horzSubSample_),
+			      static_cast<GLsizei>(size_.height() / vertSubSample_) };
+		return 3;
+	}
+
+	case libcamera::formats::UYVY:
+	case libcamera::formats::VYUY:
+	case libcamera::formats::YUYV:
+	case libcamera::formats::YVYU:
+		/*
+		 * Packed YUV formats are stored in a RGBA texture to match the
+		 * OpenGL texel size with the 4 bytes repeating pattern in YUV.
+		 * The texture width is thus half of the image with.
+		 */
+	case libcamera::formats::ABGR8888:
+	case libcamera::formats::ARGB8888:
+	case libcamera::formats::BGRA8888:
+	case libcamera::formats::RGBA8888:
+		planes[0] = { 0, GL_RGBA, static_cast<GLsizei>(stride_ / 4),
+			      size_.height() };
+		return 1;
+
+	case libcamera::formats::BGR888:
+	case libcamera::formats::RGB888:
+		planes[0] = { 0, GL_RGB, static_cast<GLsizei>(stride_ / 3),
+			      size_.height() };
+		return 1;
+
+	case libcamera::formats::SBGGR8:
+	case libcamera::formats::SGBRG8:
+	case libcamera::formats::SGRBG8:
+	case libcamera::formats::SRGGB8:
+	case libcamera::formats::SBGGR10_CSI2P:
+	case libcamera::formats::SGBRG10_CSI2P:
+	case libcamera::formats::SGRBG10_CSI2P:
+	case libcamera::formats::SRGGB10_CSI2P:
+	case libcamera::formats::SBGGR12_CSI2P:
+	case libcamera::formats::SGBRG12_CSI2P:
+	case libcamera::formats::SGRBG12_CSI2P:
+	case libcamera::formats::SRGGB12_CSI2P:
+		/*
+		 * Raw Bayer 8-bit, and packed raw Bayer 10-bit/12-bit formats
+		 * are stored in a GL_LUMINANCE texture. The texture width is
+		 * equal to the stride.
+		 */
+		planes[0] = { 0, GL_LUMINANCE, static_cast<GLsizei>(stride_),
+			      size_.height() };
+		return 1;
+
+	default:
+		return 0;
+	}
+}
+
 bool ViewFinderGL::createVertexShader()
 {
 	/* Create Vertex Shader */
@@ -350,7 +473,16 @@ bool ViewFinderGL::createFragmentShader()
 		return false;
 	}
 
-	QString defines = fragmentShaderDefines_.join('\n') + "\n";
+	/*
+	 * Two-component textures imported from a DMABUF use the GR88 format,
+	 * which stores the second component in the green channel instead of
+	 * the alpha channel of GL_LUMINANCE_ALPHA.
+	 */
+	QStringList shaderDefines = fragmentShaderDefines_;
+	if (dmabufImport_)
+		shaderDefines.append("#define TEXTURE_RG");
+
+	QString defines = shaderDefines.join('\n') + "\n";
 	QByteArray src = file.readAll();
 	src.prepend(defines.toUtf8());
 
@@ -410,9 +542,9 @@ bool ViewFinderGL::createFragmentShader()
 	return true;
 }
 
-void ViewFinderGL::configureTexture(QOpenGLTexture &texture)
+void ViewFinderGL::configureTexture(GLuint texture)
 {
-	glBindTexture(GL_TEXTURE_2D, texture.textureId());
+	glBindTexture(GL_TEXTURE_2D, texture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
 			textureMinMagFilters_);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
@@ -460,141 +592,200 @@ void ViewFinderGL::initializeGL()
 	if (!createVertexShader())
 		qWarning() << "[ViewFinderGL]: create vertex shader failed.";
 
+	initDmaBufImport();
+
 	glClearColor(1.0f, 1.0f, 1.0f, 0.0f);
 }
 
-void ViewFinderGL::doRender()
+void ViewFinderGL::initDmaBufImport()
 {
-	/* Stride of the first plane, in pixels. */
-	unsigned int stridePixels;
+#ifdef HAVE_EGL
+	/*
+	 * DMABUF import is only possible when Qt uses EGL for the current
+	 * context, which isn't the case with GLX.
+	 */
+	eglDisplay_ = eglGetCurrentDisplay();
+	if (eglDisplay_ == EGL_NO_DISPLAY)
+		return;
+
+	const char *extensions = eglQueryString(eglDisplay_, EGL_EXTENSIONS);
+	if (!extensions ||
+	    !QByteArray(extensions).split(' ').contains("EGL_EXT_image_dma_buf_import"))
+		return;
+
+	eglCreateImageKHR_ = reinterpret_cast<PFNEGLCREATEIMAGEKHRPROC>(
+		eglGetProcAddress("eglCreateImageKHR"));
+	eglDestroyImageKHR_ = reinterpret_cast<PFNEGLDESTROYIMAGEKHRPROC>(
+		eglGetProcAddress("eglDestroyImageKHR"));
+	glEGLImageTargetTexture2DOES_ = reinterpret_cast<void (*)(GLenum, void *)>(
+		eglGetProcAddress("glEGLImageTargetTexture2DOES"));
+
+	if (!eglCreateImageKHR_ || !eglDestroyImageKHR_ ||
+	    !glEGLImageTargetTexture2DOES_)
+		return;
+
+	dmabufSupported_ = true;
+	dmabufImport_ = true;
+
+	qInfo() << "[ViewFinderGL]:" << "Using DMABUF import";
+#endif
+}
 
-	switch (format_) {
-	case libcamera::formats::NV12:
-	case libcamera::formats::NV21:
-	case libcamera::formats::NV16:
-	case libcamera::formats::NV61:
-	case libcamera::formats::NV24:
-	case libcamera::formats::NV42:
-		/* Activate texture Y */
-		glActiveTexture(GL_TEXTURE0);
-		configureTexture(*textures_[0]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_LUMINANCE,
-			     stride_,
-			     size_.height(),
-			     0,
-			     GL_LUMINANCE,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(0).data());
-		shaderProgram_.setUniformValue(textureUniformY_, 0);
+/*
+ * Import all planes of the frame buffer as EGL images bound to textures. The
+ * textures are cached and reused every time the same buffer is rendered.
+ * Return nullptr if the buffer can't be imported.
+ */
+const ViewFinderGL::DmaBufTextures *
+ViewFinderGL::importBuffer([[maybe_unused]] libcamera::FrameBuffer *buffer)
+{
+#ifdef HAVE_EGL
+	auto iter = dmabufCache_.find(buffer);
+	if (iter != dmabufCache_.end())
+		return &iter->second;
 
-		/* Activate texture UV/VU */
-		glActiveTexture(GL_TEXTURE1);
-		configureTexture(*textures_[1]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_LUMINANCE_ALPHA,
-			     stride_ / horzSubSample_,
-			     size_.height() / vertSubSample_,
-			     0,
-			     GL_LUMINANCE_ALPHA,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(1).data());
-		shaderProgram_.setUniformValue(textureUniformU_, 1);
+	std::array<PlaneTexture, 3> planes;
+	unsigned int count = planeTextures(planes);
+	if (!count)
+		return nullptr;
 
-		stridePixels = stride_;
-		break;
+	DmaBufTextures dmabuf{};
 
-	case libcamera::formats::YUV420:
-		/* Activate texture Y */
-		glActiveTexture(GL_TEXTURE0);
-		configureTexture(*textures_[0]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_LUMINANCE,
-			     stride_,
-			     size_.height(),
-			     0,
-			     GL_LUMINANCE,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(0).data());
-		shaderProgram_.setUniformValue(textureUniformY_, 0);
+	for (unsigned int i = 0; i < count; ++i) {
+		const PlaneTexture &plane = planes[i];
 
-		/* Activate texture U */
-		glActiveTexture(GL_TEXTURE1);
-		configureTexture(*textures_[1]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_LUMINANCE,
-			     stride_ / horzSubSample_,
-			     size_.height() / vertSubSample_,
-			     0,
-			     GL_LUMINANCE,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(1).data());
-		shaderProgram_.setUniformValue(textureUniformU_, 1);
+		if (plane.plane >= buffer->planes().size()) {
+			releaseDmaBufTextures(dmabuf);
+			return nullptr;
+		}
 
-		/* Activate texture V */
-		glActiveTexture(GL_TEXTURE2);
-		configureTexture(*textures_[2]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_LUMINANCE,
-			     stride_ / horzSubSample_,
-			     size_.height() / vertSubSample_,
-			     0,
-			     GL_LUMINANCE,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(2).data());
-		shaderProgram_.setUniformValue(textureUniformV_, 2);
+		const libcamera::FrameBuffer::Plane &fbPlane =
+			buffer->planes()[plane.plane];
+
+		EGLint fourcc;
+		EGLint bytesPerPixel;
+
+		switch (plane.format) {
+		case GL_LUMINANCE:
+			fourcc = DRM_FORMAT_R8;
+			bytesPerPixel = 1;
+			break;
+		case GL_LUMINANCE_ALPHA:
+			fourcc = DRM_FORMAT_GR88;
+			bytesPerPixel = 2;
+			break;
+		case GL_RGB:
+			fourcc = DRM_FORMAT_BGR888;
+			bytesPerPixel = 3;
+			break;
+		case GL_RGBA:
+		default:
+			fourcc = DRM_FORMAT_ABGR8888;
+			bytesPerPixel = 4;
+			break;
+		}
 
-		stridePixels = stride_;
-		break;
+		const EGLint attribs[] = {
+			EGL_WIDTH, plane.width,
+			EGL_HEIGHT, plane.height,
+			EGL_LINUX_DRM_FOURCC_EXT, fourcc,
+			EGL_DMA_BUF_PLANE0_FD_EXT, fbPlane.fd.get(),
+			EGL_DMA_BUF_PLANE0_OFFSET_EXT, static_cast<EGLint>(fbPlane.offset),
+			EGL_DMA_BUF_PLANE0_PITCH_EXT, plane.width * bytesPerPixel,
+			EGL_NONE,
+		};
+
+		EGLImageKHR image = eglCreateImageKHR_(eglDisplay_, EGL_NO_CONTEXT,
+						       EGL_LINUX_DMA_BUF_EXT,
+						       nullptr, attribs);
+		if (image == EGL_NO_IMAGE_KHR) {
+			releaseDmaBufTextures(dmabuf);
+			return nullptr;
+		}
 
-	case libcamera::formats::YVU420:
-		/* Activate texture Y */
-		glActiveTexture(GL_TEXTURE0);
-		configureTexture(*textures_[0]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_LUMINANCE,
-			     stride_,
-			     size_.height(),
-			     0,
-			     GL_LUMINANCE,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(0).data());
-		shaderProgram_.setUniformValue(textureUniformY_, 0);
+		GLuint texture;
+		glGenTextures(1, &texture);
+		configureTexture(texture);
+		glEGLImageTargetTexture2DOES_(GL_TEXTURE_2D, image);
 
-		/* Activate texture V */
-		glActiveTexture(GL_TEXTURE2);
-		configureTexture(*textures_[2]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_LUMINANCE,
-			     stride_ / horzSubSample_,
-			     size_.height() / vertSubSample_,
-			     0,
-			     GL_LUMINANCE,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(1).data());
-		shaderProgram_.setUniformValue(textureUniformV_, 2);
+		dmabuf.images[i] = image;
+		dmabuf.textures[i] = texture;
+		dmabuf.count++;
+	}
+
+	return &dmabufCache_.emplace(buffer, dmabuf).first->second;
+#else
+	return nullptr;
+#endif
+}
+
+void ViewFinderGL::releaseDmaBufTextures(DmaBufTextures &dmabuf)
+{
+	glDeleteTextures(dmabuf.count, dmabuf.textures.data());
 
-		/* Activate texture U */
-		glActiveTexture(GL_TEXTURE1);
-		configureTexture(*textures_[1]);
+#ifdef HAVE_EGL
+	for (unsigned int i = 0; i < dmabuf.count; ++i)
+		eglDestroyImageKHR_(eglDisplay_, dmabuf.images[i]);
+#endif
+
+	dmabuf.count = 0;
+}
+
+void ViewFinderGL::clearDmaBufCache()
+{
+	for (auto &[buffer, dmabuf] : dmabufCache_)
+		releaseDmaBufTextures(dmabuf);
+
+	dmabufCache_.clear();
+}
+
+void ViewFinderGL::doRender(const DmaBufTextures *dmabuf)
+{
+	std::array<PlaneTexture, 3> planes;
+	unsigned int count = planeTextures(planes);
+
+	/* Stride of the first plane, in pixels. */
+	unsigned int stridePixels;
+
+	/*
+	 * Bind the textures to texture units 0 to 2, either from the cached
+	 * DMABUF textures or by uploading the mapped planes.
+	 */
+	for (unsigned int i = 0; i < count; ++i) {
+		const PlaneTexture &plane = planes[i];
+
+		glActiveTexture(GL_TEXTURE0 + i);
+
+		if (dmabuf) {
+			glBindTexture(GL_TEXTURE_2D, dmabuf->textures[i]);
+			continue;
+		}
+
+		configureTexture(textures_[i]->textureId());
 		glTexImage2D(GL_TEXTURE_2D,
 			     0,
-			     GL_LUMINANCE,
-			     stride_ / horzSubSample_,
-			     size_.height() / vertSubSample_,
+			     plane.format,
+			     plane.width,
+			     plane.height,
 			     0,
-			     GL_LUMINANCE,
+			     plane.format,
 			     GL_UNSIGNED_BYTE,
-			     image_->data(2).data());
-		shaderProgram_.setUniformValue(textureUniformU_, 1);
+			     image_->data(plane.plane).data());
+	}
+
+	shaderProgram_.setUniformValue(textureUniformY_, 0);
+	shaderProgram_.setUniformValue(textureUniformU_, 1);
+	shaderProgram_.setUniformValue(textureUniformV_, 2);
 
+	switch (format_) {
+	case libcamera::formats::NV12:
+	case libcamera::formats::NV21:
+	case libcamera::formats::NV16:
+	case libcamera::formats::NV61:
+	case libcamera::formats::NV24:
+	case libcamera::formats::NV42:
+	case libcamera::formats::YUV420:
+	case libcamera::formats::YVU420:
 		stridePixels = stride_;
 		break;
 
@@ -602,24 +793,6 @@ void ViewFinderGL::doRender()
 	case libcamera::formats::VYUY:
 	case libcamera::formats::YUYV:
 	case libcamera::formats::YVYU:
-		/*
-		 * Packed YUV formats are stored in a RGBA texture to match the
-		 * OpenGL texel size with the 4 bytes repeating pattern in YUV.
-		 * The texture width is thus half of the image_ with.
-		 */
-		glActiveTexture(GL_TEXTURE0);
-		configureTexture(*textures_[0]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_RGBA,
-			     stride_ / 4,
-			     size_.height(),
-			     0,
-			     GL_RGBA,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(0).data());
-		shaderProgram_.setUniformValue(textureUniformY_, 0);
-
 		/*
 		 * The shader needs the step between two texture pixels in the
 		 * horizontal direction, expressed in texture coordinate units
@@ -637,37 +810,11 @@ void ViewFinderGL::doRender()
 	case libcamera::formats::ARGB8888:
 	case libcamera::formats::BGRA8888:
 	case libcamera::formats::RGBA8888:
-		glActiveTexture(GL_TEXTURE0);
-		configureTexture(*textures_[0]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_RGBA,
-			     stride_ / 4,
-			     size_.height(),
-			     0,
-			     GL_RGBA,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(0).data());
-		shaderProgram_.setUniformValue(textureUniformY_, 0);
-
 		stridePixels = stride_ / 4;
 		break;
 
 	case libcamera::formats::BGR888:
 	case libcamera::formats::RGB888:
-		glActiveTexture(GL_TEXTURE0);
-		configureTexture(*textures_[0]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_RGB,
-			     stride_ / 3,
-			     size_.height(),
-			     0,
-			     GL_RGB,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(0).data());
-		shaderProgram_.setUniformValue(textureUniformY_, 0);
-
 		stridePixels = stride_ / 3;
 		break;
 
@@ -683,23 +830,6 @@ void ViewFinderGL::doRender()
 	case libcamera::formats::SGBRG12_CSI2P:
 	case libcamera::formats::SGRBG12_CSI2P:
 	case libcamera::formats::SRGGB12_CSI2P:
-		/*
-		 * Raw Bayer 8-bit, and packed raw Bayer 10-bit/12-bit formats
-		 * are stored in a GL_LUMINANCE texture. The texture width is
-		 * equal to the stride.
-		 */
-		glActiveTexture(GL_TEXTURE0);
-		configureTexture(*textures_[0]);
-		glTexImage2D(GL_TEXTURE_2D,
-			     0,
-			     GL_LUMINANCE,
-			     stride_,
-			     size_.height(),
-			     0,
-			     GL_LUMINANCE,
-			     GL_UNSIGNED_BYTE,
-			     image_->data(0).data());
-		shaderProgram_.setUniformValue(textureUniformY_, 0);
 		shaderProgram_.setUniformValue(textureUniformBayerFirstRed_,
 					       firstRed_);
 		shaderProgram_.setUniformValue(textureUniformSize_,
@@ -731,8 +861,52 @@ void ViewFinderGL::doRender()
 				       (stridePixels - 1));
 }
 
+void ViewFinderGL::updateRenderStats(qint64 duration, bool dmabuf)
+{
+	static constexpr unsigned int kStatsInterval = 100;
+
+	renderTime_ += duration;
+	if (++renderFrames_ < kStatsInterval)
+		return;
+
+	qDebug().noquote()
+		<< "[ViewFinderGL]:"
+		<< (dmabuf ? "dmabuf import" : "texture upload")
+		<< "average frame setup time:"
+		<< renderTime_ / renderFrames_ / 1000 << "us";
+
+	renderTime_ = 0;
+	renderFrames_ = 0;
+}
+
 void ViewFinderGL::paintGL()
 {
+	const DmaBufTextures *dmabuf = nullptr;
+	QElapsedTimer timer;
+
+	timer.start();
+
+	if (image_ && dmabufImport_) {
+		dmabuf = importBuffer(buffer_);
+		if (!dmabuf) {
+			qWarning() << "[ViewFinderGL]:"
+				   << "DMABUF import failed, falling back to texture upload";
+
+			/*
+			 * Stop importing buffers until the next format change,
+			 * and recreate the fragment shader for texture uploads.
+			 */
+			clearDmaBufCache();
+			dmabufImport_ = false;
+
+			if (shaderProgram_.isLinked()) {
+				shaderProgram_.release();
+				shaderProgram_.removeShader(fragmentShader_.get());
+				fragmentShader_.reset();
+			}
+		}
+	}
+
 	if (!fragmentShader_)
 		if (!createFragmentShader()) {
 			qWarning() << "[ViewFinderGL]:"
@@ -743,8 +917,20 @@ void ViewFinderGL::paintGL()
 		glClearColor(0.0, 0.0, 0.0, 1.0);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		doRender();
+		doRender(dmabuf);
 		glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+
+		if (renderStats_)
+			updateRenderStats(timer.nsecsElapsed(), dmabuf);
+
+		/*
+		 * The buffer is handed back to the camera with renderComplete
+		 * when the next frame is rendered. Wait for the GPU to finish
+		 * sampling the imported DMABUF, to prevent the camera from
+		 * overwriting it while it is still being read.
+		 */
+		if (dmabuf)
+			glFinish();
 	}
 }
 
@@ -9,6 +9,7 @@
 #pragma once
 
 #include <array>
+#include <map>
 #include <memory>
 
 #include <QImage>
@@ -24,6 +25,11 @@
 #include <libcamera/formats.h>
 #include <libcamera/framebuffer.h>
 
+#ifdef HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
 #include "viewfinder.h"
 
 class ViewFinderGL : public QOpenGLWidget,
@@ -55,13 +61,35 @@ protected:
 	QSize sizeHint() const override;
 
 private:
+	struct PlaneTexture {
+		unsigned int plane;
+		GLenum format;
+		GLsizei width;
+		GLsizei height;
+	};
+
+	struct DmaBufTextures {
+		unsigned int count;
+		std::array<GLuint, 3> textures;
+#ifdef HAVE_EGL
+		std::array<EGLImageKHR, 3> images;
+#endif
+	};
+
 	bool selectFormat(const libcamera::PixelFormat &format);
+	unsigned int planeTextures(std::array<PlaneTexture, 3> &planes) const;
 
-	void configureTexture(QOpenGLTexture &texture);
+	void configureTexture(GLuint texture);
 	bool createFragmentShader();
 	bool createVertexShader();
 	void removeShader();
-	void doRender();
+	void doRender(const DmaBufTextures *dmabuf);
+	void updateRenderStats(qint64 duration, bool dmabuf);
+
+	void initDmaBufImport();
+	const DmaBufTextures *importBuffer(libcamera::FrameBuffer *buffer);
+	void releaseDmaBufTextures(DmaBufTextures &dmabuf);
+	void clearDmaBufCache();
 
 	/* Captured image size, format and buffer */
 	libcamera::FrameBuffer *buffer_;
@@ -101,5 +129,21 @@ private:
 	GLuint textureUniformBayerFirstRed_;
 	QPointF firstRed_;
 
+	/* DMABUF import, with textures cached per frame buffer */
+	bool dmabufSupported_;
+	bool dmabufImport_;
+	std::map<libcamera::FrameBuffer *, DmaBufTextures> dmabufCache_;
+#ifdef HAVE_EGL
+	EGLDisplay eglDisplay_;
+	PFNEGLCREATEIMAGEKHRPROC eglCreateImageKHR_;
+	PFNEGLDESTROYIMAGEKHRPROC eglDestroyImageKHR_;
+	void (*glEGLImageTargetTexture2DOES_)(GLenum target, void *image);
+#endif
+
+	/* Texture setup time statistics, enabled by QCAM_RENDER_STATS */
+	bool renderStats_;
+	qint64 renderTime_;
+	unsigned int renderFrames_;
+
 	QMutex mutex_; /* Prevent concurrent access to image_ */
 };
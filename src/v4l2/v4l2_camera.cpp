@@ -7,18 +7,26 @@
 
 #include "v4l2_camera.h"
 
+#include <algorithm>
 #include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <libcamera/base/log.h>
 
+#include "libcamera/internal/formats.h"
+#include "libcamera/internal/framebuffer.h"
+#include "libcamera/internal/mapped_framebuffer.h"
+
+#include "v4l2_compat_manager.h"
+
 using namespace libcamera;
 
 LOG_DECLARE_CATEGORY(V4L2Compat)
 
 V4L2Camera::V4L2Camera(std::shared_ptr<Camera> camera)
-	: camera_(camera), isRunning_(false), bufferAllocator_(nullptr),
-	  efd_(-1), bufferAvailableCount_(0)
+	: camera_(camera), isRunning_(false), bufferAllocator_(nullptr)
 {
 	camera_->requestCompleted.connect(this, &V4L2Camera::requestComplete);
 }
@@ -49,6 +57,14 @@ int V4L2Camera::open(StreamConfiguration *streamConfig)
 
 void V4L2Camera::close()
 {
+	{
+		MutexLocker locker(bufferMutex_);
+		consumers_.clear();
+	}
+
+	/* Wake up the consumers blocked in dqbuf(), their entries are gone. */
+	bufferCV_.notify_all();
+
 	requestPool_.clear();
 
 	delete bufferAllocator_;
@@ -57,27 +73,133 @@ void V4L2Camera::close()
 	camera_->release();
 }
 
-void V4L2Camera::bind(int efd)
+void V4L2Camera::bind(int efd, DropPolicy policy)
+{
+	MutexLocker locker(bufferMutex_);
+
+	Consumer &consumer = consumers_[efd];
+	consumer.policy = policy;
+	consumer.streaming = false;
+	consumer.buffers.assign(bufferRefs_.size(), BufferState::Idle);
+	consumer.done.clear();
+}
+
+void V4L2Camera::unbind(int efd)
+{
+	MutexLocker locker(bufferMutex_);
+
+	auto iter = consumers_.find(efd);
+	if (iter == consumers_.end())
+		return;
+
+	Consumer &consumer = iter->second;
+	for (unsigned int index = 0; index < consumer.buffers.size(); index++)
+		releaseBuffer(efd, consumer, index);
+
+	consumers_.erase(iter);
+
+	locker.unlock();
+
+	/* Wake up a dqbuf() call blocked on the consumer being removed. */
+	bufferCV_.notify_all();
+}
+
+void V4L2Camera::signal(int efd)
+{
+	uint64_t data = 1;
+	int ret = ::write(efd, &data, sizeof(data));
+	if (ret != sizeof(data))
+		LOG(V4L2Compat, Error) << "Failed to signal eventfd POLLIN";
+}
+
+void V4L2Camera::clearSignal(int efd)
 {
-	efd_ = efd;
+	/*
+	 * Use the original read() as the eventfd is also the file descriptor
+	 * of the camera file.
+	 */
+	uint64_t data;
+	int ret = V4L2CompatManager::instance()->fops().read(efd, &data,
+							     sizeof(data));
+	if (ret != sizeof(data))
+		LOG(V4L2Compat, Error) << "Failed to clear eventfd POLLIN";
 }
 
-void V4L2Camera::unbind()
+void V4L2Camera::resizeBuffers(unsigned int count)
 {
-	efd_ = -1;
+	bufferRefs_.assign(count, 0);
+	bufferQueued_.assign(count, false);
+	bufferMetadata_.assign(count, FrameMetadata{});
+
+	for (auto &[efd, consumer] : consumers_) {
+		for (unsigned int i = 0; i < consumer.done.size(); i++)
+			clearSignal(efd);
+
+		consumer.buffers.assign(count, BufferState::Idle);
+		consumer.done.clear();
+	}
 }
 
-std::vector<V4L2Camera::Buffer> V4L2Camera::completedBuffers()
+/*
+ * Release the reference held by a consumer on a buffer, if any, and hand the
+ * buffer back to the camera if no other consumer holds it.
+ */
+void V4L2Camera::releaseBuffer(int efd, Consumer &consumer, unsigned int index)
 {
-	std::vector<Buffer> v;
+	BufferState &state = consumer.buffers[index];
+
+	if (state == BufferState::Done) {
+		auto iter = std::find(consumer.done.begin(), consumer.done.end(), index);
+		consumer.done.erase(iter);
+		clearSignal(efd);
+	}
+
+	if (state == BufferState::Done || state == BufferState::Dequeued)
+		bufferRefs_[index]--;
+
+	state = BufferState::Idle;
+}
+
+/*
+ * Queue a buffer to the camera if it is free and at least one streaming
+ * consumer waits for it.
+ */
+int V4L2Camera::queueBuffer(unsigned int index)
+{
+	if (!isRunning_ || bufferQueued_[index] || bufferRefs_[index])
+		return 0;
+
+	bool wanted = std::any_of(consumers_.begin(), consumers_.end(),
+				  [&](const auto &entry) {
+					  const Consumer &consumer = entry.second;
+					  return consumer.streaming &&
+						 consumer.buffers[index] == BufferState::Queued;
+				  });
+	if (!wanted)
+		return 0;
+
+	Request *request = requestPool_[index].get();
+	Stream *stream = config_->at(0).stream();
+	FrameBuffer *buffer = importedBuffers_.empty()
+			    ? bufferAllocator_->buffers(stream)[index].get()
+			    : importedBuffers_[index].buffer.get();
+
+	int ret = request->addBuffer(stream, buffer);
+	if (ret < 0) {
+		LOG(V4L2Compat, Error) << "Can't set buffer for request";
+		return -ENOMEM;
+	}
+
+	ret = camera_->queueRequest(request);
+	if (ret < 0) {
+		LOG(V4L2Compat, Error) << "Can't queue request";
+		request->reuse();
+		return ret == -EACCES ? -EBUSY : ret;
+	}
 
-	bufferLock_.lock();
-	for (std::unique_ptr<Buffer> &metadata : completedBuffers_)
-		v.push_back(*metadata.get());
-	completedBuffers_.clear();
-	bufferLock_.unlock();
+	bufferQueued_[index] = true;
 
-	return v;
+	return 0;
 }
 
 void V4L2Camera::requestComplete(Request *request)
@@ -85,24 +207,46 @@ void V4L2Camera::requestComplete(Request *request)
 	if (request->status() == Request::RequestCancelled)
 		return;
 
+	unsigned int index = request->cookie();
+
 	/* We only have one stream at the moment. */
-	bufferLock_.lock();
 	FrameBuffer *buffer = request->buffers().begin()->second;
-	std::unique_ptr<Buffer> metadata =
-		std::make_unique<Buffer>(request->cookie(), buffer->metadata());
-	completedBuffers_.push_back(std::move(metadata));
-	bufferLock_.unlock();
 
-	uint64_t data = 1;
-	int ret = ::write(efd_, &data, sizeof(data));
-	if (ret != sizeof(data))
-		LOG(V4L2Compat, Error) << "Failed to signal eventfd POLLIN";
+	MutexLocker locker(bufferMutex_);
 
+	bufferMetadata_[index] = buffer->metadata();
+	bufferQueued_[index] = false;
 	request->reuse();
-	{
-		MutexLocker locker(bufferMutex_);
-		bufferAvailableCount_++;
+
+	/* Deliver the frame to all consumers waiting for it. */
+	for (auto &[efd, consumer] : consumers_) {
+		if (!consumer.streaming ||
+		    consumer.buffers[index] != BufferState::Queued)
+			continue;
+
+		if (consumer.policy == DropPolicy::DropNewest &&
+		    !consumer.done.empty())
+			continue;
+
+		consumer.buffers[index] = BufferState::Done;
+		consumer.done.push_back(index);
+		bufferRefs_[index]++;
+		signal(efd);
+
+		if (consumer.policy == DropPolicy::DropOldest &&
+		    consumer.done.size() > 1) {
+			unsigned int oldest = consumer.done.front();
+			releaseBuffer(efd, consumer, oldest);
+			consumer.buffers[oldest] = BufferState::Queued;
+			queueBuffer(oldest);
+		}
 	}
+
+	/* Requeue the buffer right away if no consumer took it. */
+	queueBuffer(index);
+
+	locker.unlock();
+
 	bufferCV_.notify_all();
 }
 
@@ -174,16 +318,45 @@ int V4L2Camera::allocBuffers(unsigned int count)
 		requestPool_.push_back(std::move(request));
 	}
 
+	MutexLocker locker(bufferMutex_);
+	resizeBuffers(count);
+
 	return ret;
 }
 
+int V4L2Camera::importBuffers(unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++) {
+		std::unique_ptr<Request> request = camera_->createRequest(i);
+		if (!request) {
+			requestPool_.clear();
+			return -ENOMEM;
+		}
+		requestPool_.push_back(std::move(request));
+	}
+
+	importedBuffers_.resize(count);
+
+	MutexLocker locker(bufferMutex_);
+	resizeBuffers(count);
+
+	return 0;
+}
+
 void V4L2Camera::freeBuffers()
 {
-	pendingRequests_.clear();
+	{
+		MutexLocker locker(bufferMutex_);
+		resizeBuffers(0);
+	}
+
 	requestPool_.clear();
+	importedBuffers_.clear();
 
-	Stream *stream = config_->at(0).stream();
-	bufferAllocator_->free(stream);
+	if (bufferAllocator_->allocated()) {
+		Stream *stream = config_->at(0).stream();
+		bufferAllocator_->free(stream);
+	}
 }
 
 int V4L2Camera::getBufferFd(unsigned int index)
@@ -198,104 +371,296 @@ int V4L2Camera::getBufferFd(unsigned int index)
 	return buffers[index]->planes()[0].fd.get();
 }
 
-int V4L2Camera::streamOn()
+ssize_t V4L2Camera::copyBuffer(unsigned int index, void *dst, size_t length)
 {
-	if (isRunning_)
-		return 0;
+	Stream *stream = config_->at(0).stream();
+	const std::vector<std::unique_ptr<FrameBuffer>> &buffers =
+		bufferAllocator_->buffers(stream);
 
-	int ret = camera_->start();
-	if (ret < 0)
-		return ret == -EACCES ? -EBUSY : ret;
+	if (buffers.size() <= index)
+		return -EINVAL;
+
+	/* The buffers are mapped on first use and stay mapped until freed. */
+	const MappedFrameBuffer *mapped =
+		buffers[index]->_d()->map(MappedFrameBuffer::MapFlag::Read);
+	if (!mapped) {
+		LOG(V4L2Compat, Error) << "Failed to map buffer " << index;
+		return -ENOMEM;
+	}
 
-	isRunning_ = true;
+	MappedFrameBuffer::CpuAccess access(*mapped);
 
-	for (Request *req : pendingRequests_) {
-		/* \todo What should we do if this returns -EINVAL? */
-		ret = camera_->queueRequest(req);
+	uint8_t *data = static_cast<uint8_t *>(dst);
+	size_t copied = 0;
+
+	for (const Span<uint8_t> &plane : mapped->planes()) {
+		size_t size = std::min(plane.size(), length - copied);
+		memcpy(data + copied, plane.data(), size);
+		copied += size;
+
+		if (copied == length)
+			break;
+	}
+
+	return copied;
+}
+
+FrameBuffer *V4L2Camera::importBuffer(unsigned int index, int fd)
+{
+	if (index >= importedBuffers_.size())
+		return nullptr;
+
+	struct stat st;
+	if (fstat(fd, &st) < 0) {
+		LOG(V4L2Compat, Error)
+			<< "Invalid dmabuf fd " << fd << ": " << strerror(errno);
+		return nullptr;
+	}
+
+	/*
+	 * Applications usually queue the same dmabuf for a given index. Reuse
+	 * the FrameBuffer in that case, identifying the dmabuf by its inode as
+	 * the file descriptor number may differ.
+	 */
+	ImportedBuffer &imported = importedBuffers_[index];
+	if (imported.buffer && imported.inode == st.st_ino)
+		return imported.buffer.get();
+
+	const StreamConfiguration &streamConfig = config_->at(0);
+	const PixelFormatInfo &info = PixelFormatInfo::info(streamConfig.pixelFormat);
+	unsigned int numPlanes = info.isValid() ? info.numPlanes() : 0;
+	SharedFD dmabuf(fd);
+
+	std::vector<FrameBuffer::Plane> planes;
+
+	if (!numPlanes) {
+		/* Compressed formats are stored in a single plane. */
+		FrameBuffer::Plane plane;
+		plane.fd = dmabuf;
+		plane.offset = 0;
+		plane.length = streamConfig.frameSize;
+		planes.push_back(std::move(plane));
+	} else {
+		/*
+		 * The single-planar V4L2 API stores all colour planes in one
+		 * buffer. Split it into FrameBuffer planes, computing the
+		 * stride of the other planes from the horizontal subsampling
+		 * factor as V4L2VideoDevice does.
+		 */
+		size_t offset = 0;
+
+		for (unsigned int i = 0; i < numPlanes; i++) {
+			unsigned int stride = streamConfig.stride
+					    * info.planes[i].bytesPerGroup
+					    / info.planes[0].bytesPerGroup;
+
+			FrameBuffer::Plane plane;
+			plane.fd = dmabuf;
+			plane.offset = offset;
+			plane.length = info.planeSize(streamConfig.size.height,
+						      i, stride);
+			offset += plane.length;
+
+			planes.push_back(std::move(plane));
+		}
+	}
+
+	imported.inode = st.st_ino;
+	imported.buffer = std::make_unique<FrameBuffer>(planes);
+
+	return imported.buffer.get();
+}
+
+int V4L2Camera::streamOn(int efd)
+{
+	MutexLocker streamLocker(streamMutex_);
+	MutexLocker locker(bufferMutex_);
+
+	auto iter = consumers_.find(efd);
+	if (iter == consumers_.end())
+		return -EINVAL;
+
+	Consumer &consumer = iter->second;
+	if (consumer.streaming)
+		return 0;
+
+	if (!isRunning_) {
+		int ret = camera_->start();
 		if (ret < 0)
 			return ret == -EACCES ? -EBUSY : ret;
+
+		isRunning_ = true;
 	}
 
-	pendingRequests_.clear();
+	consumer.streaming = true;
+
+	for (unsigned int index = 0; index < bufferQueued_.size(); index++) {
+		/* \todo What should we do if this returns -EINVAL? */
+		int ret = queueBuffer(index);
+		if (ret < 0)
+			return ret;
+	}
 
 	return 0;
 }
 
-int V4L2Camera::streamOff()
+int V4L2Camera::streamOff(int efd)
 {
-	if (!isRunning_) {
-		for (std::unique_ptr<Request> &req : requestPool_)
-			req->reuse();
+	/*
+	 * Hold the stream lock until the camera is stopped, to prevent a
+	 * concurrent streamOn() from starting it while it is being stopped.
+	 */
+	MutexLocker streamLocker(streamMutex_);
+	MutexLocker locker(bufferMutex_);
+
+	auto iter = consumers_.find(efd);
+	if (iter == consumers_.end())
+		return -EINVAL;
+
+	/* Streaming off returns all buffers of the consumer to the idle state. */
+	Consumer &consumer = iter->second;
+	for (unsigned int index = 0; index < consumer.buffers.size(); index++)
+		releaseBuffer(efd, consumer, index);
+
+	bool wasStreaming = consumer.streaming;
+	consumer.streaming = false;
+
+	bool streaming = std::any_of(consumers_.begin(), consumers_.end(),
+				     [](const auto &entry) {
+					     return entry.second.streaming;
+				     });
+
+	if (streaming || !isRunning_) {
+		/*
+		 * Buffers released by this consumer may be awaited by the
+		 * others.
+		 */
+		for (unsigned int index = 0; index < bufferQueued_.size(); index++)
+			queueBuffer(index);
+
+		locker.unlock();
+
+		if (wasStreaming)
+			bufferCV_.notify_all();
 
 		return 0;
 	}
 
-	pendingRequests_.clear();
+	isRunning_ = false;
+
+	/*
+	 * Stop the camera without holding the buffer lock, as completing the
+	 * requests in flight requires it.
+	 */
+	locker.unlock();
+	bufferCV_.notify_all();
 
 	int ret = camera_->stop();
+
+	locker.lock();
+	bufferQueued_.assign(bufferQueued_.size(), false);
+	for (std::unique_ptr<Request> &req : requestPool_)
+		req->reuse();
+
 	if (ret < 0)
 		return ret == -EACCES ? -EBUSY : ret;
 
-	{
-		MutexLocker locker(bufferMutex_);
-		isRunning_ = false;
-	}
-	bufferCV_.notify_all();
-
 	return 0;
 }
 
-int V4L2Camera::qbuf(unsigned int index)
+int V4L2Camera::qbuf(int efd, unsigned int index, int fd)
 {
-	if (index >= requestPool_.size()) {
+	MutexLocker locker(bufferMutex_);
+
+	auto iter = consumers_.find(efd);
+	if (iter == consumers_.end())
+		return -EINVAL;
+
+	Consumer &consumer = iter->second;
+
+	if (index >= consumer.buffers.size()) {
 		LOG(V4L2Compat, Error) << "Invalid index";
 		return -EINVAL;
 	}
-	Request *request = requestPool_[index].get();
 
-	Stream *stream = config_->at(0).stream();
-	FrameBuffer *buffer = bufferAllocator_->buffers(stream)[index].get();
-	int ret = request->addBuffer(stream, buffer);
-	if (ret < 0) {
-		LOG(V4L2Compat, Error) << "Can't set buffer for request";
-		return -ENOMEM;
+	if (fd >= 0 && !importBuffer(index, fd)) {
+		LOG(V4L2Compat, Error) << "Can't import dmabuf";
+		return -EINVAL;
 	}
 
-	if (!isRunning_) {
-		pendingRequests_.push_back(request);
-		return 0;
-	}
+	BufferState &state = consumer.buffers[index];
+	if (state == BufferState::Queued || state == BufferState::Done)
+		return -EINVAL;
 
-	ret = camera_->queueRequest(request);
-	if (ret < 0) {
-		LOG(V4L2Compat, Error) << "Can't queue request";
-		return ret == -EACCES ? -EBUSY : ret;
-	}
+	if (state == BufferState::Dequeued)
+		bufferRefs_[index]--;
 
-	return 0;
+	state = BufferState::Queued;
+
+	return queueBuffer(index);
 }
 
-void V4L2Camera::waitForBufferAvailable()
+int V4L2Camera::dqbuf(int efd, bool nonBlocking, Buffer *buffer)
 {
 	MutexLocker locker(bufferMutex_);
-	bufferCV_.wait(locker, [&] {
-			       return bufferAvailableCount_ >= 1 || !isRunning_;
-		       });
-	if (isRunning_)
-		bufferAvailableCount_--;
+
+	if (!nonBlocking) {
+		/*
+		 * The consumer may be unbound while we wait, look it up again
+		 * on every wake-up instead of holding a reference to it.
+		 */
+		bufferCV_.wait(locker, [&]() LIBCAMERA_TSA_REQUIRES(bufferMutex_) {
+			auto iter = consumers_.find(efd);
+			if (iter == consumers_.end())
+				return true;
+
+			const Consumer &consumer = iter->second;
+			return !consumer.done.empty() || !consumer.streaming;
+		});
+	}
+
+	auto iter = consumers_.find(efd);
+	if (iter == consumers_.end())
+		return -EINVAL;
+
+	Consumer &consumer = iter->second;
+
+	if (!consumer.streaming)
+		return -EINVAL;
+
+	if (consumer.done.empty())
+		return -EAGAIN;
+
+	unsigned int index = consumer.done.front();
+	consumer.done.pop_front();
+	consumer.buffers[index] = BufferState::Dequeued;
+	clearSignal(efd);
+
+	*buffer = Buffer(index, bufferMetadata_[index]);
+
+	return 0;
 }
 
-bool V4L2Camera::isBufferAvailable()
+V4L2Camera::BufferState V4L2Camera::bufferState(int efd, unsigned int index)
 {
 	MutexLocker locker(bufferMutex_);
-	if (bufferAvailableCount_ < 1)
-		return false;
 
-	bufferAvailableCount_--;
-	return true;
+	auto iter = consumers_.find(efd);
+	if (iter == consumers_.end() || index >= iter->second.buffers.size())
+		return BufferState::Idle;
+
+	return iter->second.buffers[index];
 }
 
 bool V4L2Camera::isRunning()
 {
 	return isRunning_;
 }
+
+bool V4L2Camera::isStreaming(int efd)
+{
+	MutexLocker locker(bufferMutex_);
+
+	auto iter = consumers_.find(efd);
+	return iter != consumers_.end() && iter->second.streaming;
+}
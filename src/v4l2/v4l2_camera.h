@@ -8,10 +8,12 @@
 #pragma once
 
 #include <deque>
+#include <map>
+#include <sys/types.h>
 #include <utility>
+#include <vector>
 
 #include <libcamera/base/mutex.h>
-#include <libcamera/base/semaphore.h>
 #include <libcamera/base/shared_fd.h>
 
 #include <libcamera/camera.h>
@@ -31,15 +33,34 @@ public:
 		libcamera::FrameMetadata data_;
 	};
 
+	/*
+	 * Policy applied when a frame completes while a consumer still has
+	 * completed frames waiting to be dequeued. Block delivers all frames,
+	 * holding the buffers until they are dequeued and requeued.
+	 * DropOldest and DropNewest keep a single frame waiting, releasing the
+	 * older one or skipping the new one respectively, so that a slow
+	 * consumer doesn't starve the others.
+	 */
+	enum class DropPolicy {
+		Block,
+		DropOldest,
+		DropNewest,
+	};
+
+	enum class BufferState {
+		Idle,
+		Queued,
+		Done,
+		Dequeued,
+	};
+
 	V4L2Camera(std::shared_ptr<libcamera::Camera> camera);
 	~V4L2Camera();
 
 	int open(libcamera::StreamConfiguration *streamConfig);
 	void close();
-	void bind(int efd);
-	void unbind();
-
-	std::vector<Buffer> completedBuffers();
+	void bind(int efd, DropPolicy policy);
+	void unbind(int efd);
 
 	int configure(libcamera::StreamConfiguration *streamConfigOut,
 		      const libcamera::Size &size,
@@ -50,38 +71,73 @@ public:
 				  libcamera::StreamConfiguration *streamConfigOut);
 
 	int allocBuffers(unsigned int count);
+	int importBuffers(unsigned int count);
 	void freeBuffers();
 	int getBufferFd(unsigned int index);
+	ssize_t copyBuffer(unsigned int index, void *dst, size_t length);
 
-	int streamOn();
-	int streamOff();
-
-	int qbuf(unsigned int index);
+	int streamOn(int efd);
+	int streamOff(int efd);
 
-	void waitForBufferAvailable();
-	bool isBufferAvailable();
+	int qbuf(int efd, unsigned int index, int fd = -1);
+	int dqbuf(int efd, bool nonBlocking, Buffer *buffer);
+	BufferState bufferState(int efd, unsigned int index);
 
 	bool isRunning();
+	bool isStreaming(int efd);
 
 private:
+	struct ImportedBuffer {
+		ino_t inode;
+		std::unique_ptr<libcamera::FrameBuffer> buffer;
+	};
+
+	/*
+	 * Each file bound to the camera consumes the frames of the shared
+	 * stream through its own queue of completed buffers. A buffer is
+	 * handed back to the camera once no consumer holds it anymore.
+	 */
+	struct Consumer {
+		DropPolicy policy;
+		bool streaming;
+		std::vector<BufferState> buffers;
+		std::deque<unsigned int> done;
+	};
+
 	void requestComplete(libcamera::Request *request);
+	libcamera::FrameBuffer *importBuffer(unsigned int index, int fd);
+
+	void resizeBuffers(unsigned int count)
+		LIBCAMERA_TSA_REQUIRES(bufferMutex_);
+	void releaseBuffer(int efd, Consumer &consumer, unsigned int index)
+		LIBCAMERA_TSA_REQUIRES(bufferMutex_);
+	int queueBuffer(unsigned int index)
+		LIBCAMERA_TSA_REQUIRES(bufferMutex_);
+	void signal(int efd);
+	void clearSignal(int efd);
 
 	std::shared_ptr<libcamera::Camera> camera_;
 	std::unique_ptr<libcamera::CameraConfiguration> config_;
 
 	bool isRunning_;
 
-	libcamera::Mutex bufferLock_;
 	libcamera::FrameBufferAllocator *bufferAllocator_;
+	std::vector<ImportedBuffer> importedBuffers_;
 
 	std::vector<std::unique_ptr<libcamera::Request>> requestPool_;
 
-	std::deque<libcamera::Request *> pendingRequests_;
-	std::deque<std::unique_ptr<Buffer>> completedBuffers_;
-
-	int efd_;
+	/* Serializes starting and stopping the camera, taken before bufferMutex_. */
+	libcamera::Mutex streamMutex_;
 
 	libcamera::Mutex bufferMutex_;
 	libcamera::ConditionVariable bufferCV_;
-	unsigned int bufferAvailableCount_;
+
+	/* Consumers, indexed by the eventfd of their file. */
+	std::map<int, Consumer> consumers_ LIBCAMERA_TSA_GUARDED_BY(bufferMutex_);
+
+	/* Per-buffer state, indexed by buffer index. */
+	std::vector<unsigned int> bufferRefs_ LIBCAMERA_TSA_GUARDED_BY(bufferMutex_);
+	std::vector<bool> bufferQueued_ LIBCAMERA_TSA_GUARDED_BY(bufferMutex_);
+	std::vector<libcamera::FrameMetadata> bufferMetadata_
+		LIBCAMERA_TSA_GUARDED_BY(bufferMutex_);
 };
@@ -39,10 +39,28 @@ LOG_DECLARE_CATEGORY(V4L2Compat)
 
 V4L2CameraProxy::V4L2CameraProxy(unsigned int index,
 				 std::shared_ptr<Camera> camera)
-	: refcount_(0), index_(index), bufferCount_(0), currentBuf_(0),
+	: refcount_(0), index_(index), memory_(V4L2_MEMORY_MMAP),
+	  bufferCount_(0), readIO_(false),
+	  dropPolicy_(V4L2Camera::DropPolicy::Block),
 	  vcam_(std::make_unique<V4L2Camera>(camera)), owner_(nullptr)
 {
 	querycap(camera);
+
+	/*
+	 * The drop policy applies to all files sharing the stream, it selects
+	 * how frames are delivered to a file that doesn't dequeue them fast
+	 * enough.
+	 */
+	const char *policy = utils::secure_getenv("LIBCAMERA_V4L2_DROP_POLICY");
+	if (!policy || !strcmp(policy, "block"))
+		dropPolicy_ = V4L2Camera::DropPolicy::Block;
+	else if (!strcmp(policy, "drop-oldest"))
+		dropPolicy_ = V4L2Camera::DropPolicy::DropOldest;
+	else if (!strcmp(policy, "drop-newest"))
+		dropPolicy_ = V4L2Camera::DropPolicy::DropNewest;
+	else
+		LOG(V4L2Compat, Warning)
+			<< "Invalid drop policy '" << policy << "', using 'block'";
 }
 
 int V4L2CameraProxy::open(V4L2CameraFile *file)
@@ -61,10 +79,10 @@ int V4L2CameraProxy::open(V4L2CameraFile *file)
 	 * We open the camera here, once, and keep it open until the last
 	 * V4L2CameraFile is closed. The proxy is initially not owned by any
 	 * file. The first file that calls reqbufs with count > 0 or s_fmt
-	 * will become the owner, and no other file will be allowed to call
-	 * buffer-related ioctls (except querybuf), set the format, or start or
-	 * stop the stream until ownership is released with a call to reqbufs
-	 * with count = 0.
+	 * will become the owner, and no other file will be allowed to set the
+	 * format or allocate buffers until ownership is released with a call
+	 * to reqbufs with count = 0. Other files can however share the buffers
+	 * allocated by the owner, see joinStream().
 	 */
 
 	int ret = vcam_->open(&streamConfig_);
@@ -89,7 +107,27 @@ void V4L2CameraProxy::close(V4L2CameraFile *file)
 
 	files_.erase(file);
 
-	release(file);
+	if (readIO_ && hasOwnership(file))
+		stopReadIO(file);
+
+	if (consumers_.count(file)) {
+		leaveStream(file);
+	} else if (hasOwnership(file) && !consumers_.empty()) {
+		/*
+		 * Hand ownership over to one of the files sharing the stream,
+		 * the buffers stay allocated.
+		 */
+		vcam_->streamOff(file->efd());
+		vcam_->unbind(file->efd());
+
+		owner_ = *consumers_.begin();
+		consumers_.erase(owner_);
+	} else {
+		if (hasOwnership(file))
+			vcam_->streamOff(file->efd());
+
+		release(file);
+	}
 
 	if (--refcount_ > 0)
 		return;
@@ -105,6 +143,11 @@ void *V4L2CameraProxy::mmap(V4L2CameraFile *file, void *addr, size_t length,
 
 	MutexLocker locker(proxyMutex_);
 
+	if (memory_ != V4L2_MEMORY_MMAP) {
+		errno = EINVAL;
+		return MAP_FAILED;
+	}
+
 	/*
 	 * Mimic the videobuf2 behaviour, which requires PROT_READ and
 	 * MAP_SHARED.
@@ -166,6 +209,85 @@ int V4L2CameraProxy::munmap(V4L2CameraFile *file, void *addr, size_t length)
 	return 0;
 }
 
+ssize_t V4L2CameraProxy::read(V4L2CameraFile *file, void *buf, size_t count)
+{
+	LOG(V4L2Compat, Debug)
+		<< "[" << file->description() << "] " << __func__
+		<< "(count=" << count << ")";
+
+	MutexLocker locker(proxyMutex_);
+
+	int ret;
+
+	if (!readIO_) {
+		/* Streaming I/O and read() can't be mixed. */
+		if (bufferCount_ > 0 || vcam_->isRunning()) {
+			errno = EBUSY;
+			return -1;
+		}
+
+		ret = startReadIO(file);
+		if (ret < 0) {
+			errno = -ret;
+			return -1;
+		}
+	}
+
+	if (!hasOwnership(file)) {
+		errno = EBUSY;
+		return -1;
+	}
+
+	/*
+	 * The file is bound with the DropOldest policy, at most one completed
+	 * buffer is thus waiting and it holds the most recent frame. Release
+	 * the lock while waiting for it.
+	 */
+	V4L2Camera::Buffer frame(0, {});
+
+	locker.unlock();
+	ret = vcam_->dqbuf(file->efd(), file->nonBlocking(), &frame);
+	locker.lock();
+
+	if (ret == -EAGAIN) {
+		errno = EAGAIN;
+		return -1;
+	}
+
+	if (ret < 0 || !readIO_) {
+		errno = EIO;
+		return -1;
+	}
+
+	unsigned int index = frame.index_;
+	updateBuffer(frame);
+
+	struct v4l2_buffer &buffer = buffers_[index];
+	ssize_t copied;
+
+	if (buffer.flags & V4L2_BUF_FLAG_ERROR) {
+		copied = -EIO;
+	} else {
+		/*
+		 * Partial reads are not carried over to the next call, the
+		 * remainder of the frame is dropped.
+		 */
+		copied = vcam_->copyBuffer(index, buf,
+					   std::min<size_t>(count, buffer.bytesused));
+	}
+
+	ret = vcam_->qbuf(file->efd(), index);
+	if (ret < 0 && copied >= 0)
+		copied = ret;
+
+	if (copied < 0) {
+		errno = -copied;
+		return -1;
+	}
+
+	return copied;
+}
+
 bool V4L2CameraProxy::validateBufferType(uint32_t type)
 {
 	return type == V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -173,7 +295,9 @@ bool V4L2CameraProxy::validateBufferType(uint32_t type)
 
 bool V4L2CameraProxy::validateMemoryType(uint32_t memory)
 {
-	return memory == V4L2_MEMORY_MMAP;
+	return memory == V4L2_MEMORY_MMAP ||
+	       memory == V4L2_MEMORY_USERPTR ||
+	       memory == V4L2_MEMORY_DMABUF;
 }
 
 void V4L2CameraProxy::setFmtFromConfig(const StreamConfiguration &streamConfig)
@@ -210,42 +334,63 @@ void V4L2CameraProxy::querycap(std::shared_ptr<Camera> camera)
 	capabilities_.version = KERNEL_VERSION(5, 2, 0);
 	capabilities_.device_caps = V4L2_CAP_VIDEO_CAPTURE
 				  | V4L2_CAP_STREAMING
+				  | V4L2_CAP_READWRITE
 				  | V4L2_CAP_EXT_PIX_FORMAT;
 	capabilities_.capabilities = capabilities_.device_caps
 				   | V4L2_CAP_DEVICE_CAPS;
 	memset(capabilities_.reserved, 0, sizeof(capabilities_.reserved));
 }
 
-void V4L2CameraProxy::updateBuffers()
-{
-	std::vector<V4L2Camera::Buffer> completedBuffers = vcam_->completedBuffers();
-	for (const V4L2Camera::Buffer &buffer : completedBuffers) {
-		const FrameMetadata &fmd = buffer.data_;
-		struct v4l2_buffer &buf = buffers_[buffer.index_];
-
-		switch (fmd.status) {
-		case FrameMetadata::FrameSuccess:
-			buf.bytesused = std::accumulate(fmd.planes().begin(),
-							fmd.planes().end(), 0,
-							[](unsigned int total, const auto &plane) {
-								return total + plane.bytesused;
-							});
-			buf.field = V4L2_FIELD_NONE;
-			buf.timestamp.tv_sec = fmd.timestamp / 1000000000;
-			buf.timestamp.tv_usec = (fmd.timestamp / 1000) % 1000000;
-			buf.sequence = fmd.sequence;
-
-			buf.flags |= V4L2_BUF_FLAG_DONE;
-			break;
-		case FrameMetadata::FrameError:
-			buf.flags |= V4L2_BUF_FLAG_ERROR;
-			break;
-		default:
-			break;
-		}
+void V4L2CameraProxy::updateBuffer(const V4L2Camera::Buffer &buffer)
+{
+	const FrameMetadata &fmd = buffer.data_;
+	struct v4l2_buffer &buf = buffers_[buffer.index_];
+
+	buf.flags &= ~(V4L2_BUF_FLAG_ERROR | V4L2_BUF_FLAG_PREPARED);
+
+	switch (fmd.status) {
+	case FrameMetadata::FrameSuccess:
+		buf.bytesused = std::accumulate(fmd.planes().begin(),
+						fmd.planes().end(), 0,
+						[](unsigned int total, const auto &plane) {
+							return total + plane.bytesused;
+						});
+		buf.field = V4L2_FIELD_NONE;
+		buf.timestamp.tv_sec = fmd.timestamp / 1000000000;
+		buf.timestamp.tv_usec = (fmd.timestamp / 1000) % 1000000;
+		buf.sequence = fmd.sequence;
+		break;
+	case FrameMetadata::FrameError:
+		buf.flags |= V4L2_BUF_FLAG_ERROR;
+		break;
+	default:
+		break;
 	}
 }
 
+/*
+ * The buffers are shared between all files streaming from the camera, but
+ * each file queues and dequeues them independently. Compute the flags of a
+ * buffer as seen by a file.
+ */
+uint32_t V4L2CameraProxy::bufferFlags(V4L2CameraFile *file, unsigned int index)
+{
+	uint32_t flags = buffers_[index].flags;
+
+	switch (vcam_->bufferState(file->efd(), index)) {
+	case V4L2Camera::BufferState::Queued:
+		flags |= V4L2_BUF_FLAG_QUEUED;
+		break;
+	case V4L2Camera::BufferState::Done:
+		flags |= V4L2_BUF_FLAG_DONE;
+		break;
+	default:
+		break;
+	}
+
+	return flags;
+}
+
 int V4L2CameraProxy::vidioc_querycap(V4L2CameraFile *file, struct v4l2_capability *arg)
 {
 	LOG(V4L2Compat, Debug)
@@ -361,6 +506,9 @@ int V4L2CameraProxy::vidioc_s_fmt(V4L2CameraFile *file, struct v4l2_format *arg)
 	if (ret < 0)
 		return ret;
 
+	if (!consumers_.empty())
+		return -EBUSY;
+
 	ret = tryFormat(arg);
 	if (ret < 0)
 		return ret;
@@ -466,6 +614,76 @@ int V4L2CameraProxy::vidioc_s_input(V4L2CameraFile *file, int *arg)
 	return 0;
 }
 
+/*
+ * Start streaming with a ring of internal buffers when read() is first
+ * called. All buffers are queued to the camera, read() then always returns
+ * the latest completed frame.
+ */
+int V4L2CameraProxy::startReadIO(V4L2CameraFile *file)
+{
+	int ret = acquire(file);
+	if (ret < 0)
+		return ret;
+
+	/* Always return the most recent frame. */
+	vcam_->bind(file->efd(), V4L2Camera::DropPolicy::DropOldest);
+
+	Size size(v4l2PixFormat_.width, v4l2PixFormat_.height);
+	V4L2PixelFormat v4l2Format = V4L2PixelFormat(v4l2PixFormat_.pixelformat);
+	ret = vcam_->configure(&streamConfig_, size, v4l2Format.toPixelFormat(),
+			       kNumReadBuffers);
+	if (ret < 0)
+		goto error;
+
+	setFmtFromConfig(streamConfig_);
+
+	bufferCount_ = streamConfig_.bufferCount;
+	memory_ = V4L2_MEMORY_MMAP;
+
+	ret = vcam_->allocBuffers(bufferCount_);
+	if (ret < 0)
+		goto error;
+
+	buffers_.resize(bufferCount_);
+	for (unsigned int i = 0; i < bufferCount_; i++) {
+		struct v4l2_buffer buf = {};
+		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		buf.length = v4l2PixFormat_.sizeimage;
+		buf.memory = V4L2_MEMORY_MMAP;
+		buf.index = i;
+		buf.flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
+		buffers_[i] = buf;
+
+		ret = vcam_->qbuf(file->efd(), i);
+		if (ret < 0)
+			goto error;
+	}
+
+	ret = vcam_->streamOn(file->efd());
+	if (ret < 0)
+		goto error;
+
+	readIO_ = true;
+
+	LOG(V4L2Compat, Debug)
+		<< "Started read() I/O with " << bufferCount_ << " buffers";
+
+	return 0;
+
+error:
+	vcam_->streamOff(file->efd());
+	freeBuffers();
+	release(file);
+	return ret;
+}
+
+void V4L2CameraProxy::stopReadIO(V4L2CameraFile *file)
+{
+	vcam_->streamOff(file->efd());
+	freeBuffers();
+	readIO_ = false;
+}
+
 void V4L2CameraProxy::freeBuffers()
 {
 	vcam_->freeBuffers();
@@ -487,13 +705,22 @@ int V4L2CameraProxy::vidioc_reqbufs(V4L2CameraFile *file, struct v4l2_requestbuf
 	if (file->priority() < maxPriority())
 		return -EBUSY;
 
-	if (!hasOwnership(file) && owner_)
+	if (readIO_)
 		return -EBUSY;
 
-	arg->capabilities = V4L2_BUF_CAP_SUPPORTS_MMAP;
+	arg->capabilities = V4L2_BUF_CAP_SUPPORTS_MMAP
+			  | V4L2_BUF_CAP_SUPPORTS_USERPTR
+			  | V4L2_BUF_CAP_SUPPORTS_DMABUF;
 	arg->flags = 0;
 	memset(arg->reserved, 0, sizeof(arg->reserved));
 
+	if (!hasOwnership(file) && owner_)
+		return joinStream(file, arg);
+
+	/* The buffers can't be reallocated while they are shared. */
+	if (!consumers_.empty())
+		return -EBUSY;
+
 	if (arg->count == 0) {
 		/* \todo Add buffer orphaning support */
 		if (!mmaps_.empty())
@@ -522,8 +749,18 @@ int V4L2CameraProxy::vidioc_reqbufs(V4L2CameraFile *file, struct v4l2_requestbuf
 
 	arg->count = streamConfig_.bufferCount;
 	bufferCount_ = arg->count;
+	memory_ = static_cast<enum v4l2_memory>(arg->memory);
 
-	ret = vcam_->allocBuffers(arg->count);
+	/*
+	 * DMABUF buffers are imported from the application when queued.
+	 * USERPTR buffers can't be imported as libcamera requires dmabufs, so
+	 * capture to internal buffers and copy to the user memory when
+	 * dequeuing.
+	 */
+	if (memory_ == V4L2_MEMORY_DMABUF)
+		ret = vcam_->importBuffers(arg->count);
+	else
+		ret = vcam_->allocBuffers(arg->count);
 	if (ret < 0) {
 		arg->count = 0;
 		return ret;
@@ -534,8 +771,9 @@ int V4L2CameraProxy::vidioc_reqbufs(V4L2CameraFile *file, struct v4l2_requestbuf
 		struct v4l2_buffer buf = {};
 		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 		buf.length = v4l2PixFormat_.sizeimage;
-		buf.memory = V4L2_MEMORY_MMAP;
-		buf.m.offset = i * v4l2PixFormat_.sizeimage;
+		buf.memory = memory_;
+		if (memory_ == V4L2_MEMORY_MMAP)
+			buf.m.offset = i * v4l2PixFormat_.sizeimage;
 		buf.index = i;
 		buf.flags = V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC;
 
@@ -561,9 +799,8 @@ int V4L2CameraProxy::vidioc_querybuf(V4L2CameraFile *file, struct v4l2_buffer *a
 	    arg->index >= bufferCount_)
 		return -EINVAL;
 
-	updateBuffers();
-
 	*arg = buffers_[arg->index];
+	arg->flags = bufferFlags(file, arg->index);
 
 	return 0;
 }
@@ -574,7 +811,7 @@ int V4L2CameraProxy::vidioc_prepare_buf(V4L2CameraFile *file, struct v4l2_buffer
 		<< "[" << file->description() << "] " << __func__
 		<< "(index=" << arg->index << ")";
 
-	if (!hasOwnership(file))
+	if (!hasBufferAccess(file))
 		return -EBUSY;
 
 	if (arg->index >= bufferCount_)
@@ -584,18 +821,19 @@ int V4L2CameraProxy::vidioc_prepare_buf(V4L2CameraFile *file, struct v4l2_buffer
 		return -EINVAL;
 
 	if (!validateBufferType(arg->type) ||
-	    !validateMemoryType(arg->memory))
+	    arg->memory != memory_)
 		return -EINVAL;
 
 	struct v4l2_buffer &buffer = buffers_[arg->index];
+	uint32_t flags = bufferFlags(file, arg->index);
 
-	if (buffer.flags & V4L2_BUF_FLAG_QUEUED ||
-	    buffer.flags & V4L2_BUF_FLAG_PREPARED)
+	if (flags & V4L2_BUF_FLAG_QUEUED ||
+	    flags & V4L2_BUF_FLAG_PREPARED)
 		return -EINVAL;
 
 	buffer.flags |= V4L2_BUF_FLAG_PREPARED;
 
-	arg->flags = buffer.flags;
+	arg->flags = bufferFlags(file, arg->index);
 
 	return 0;
 }
@@ -609,24 +847,53 @@ int V4L2CameraProxy::vidioc_qbuf(V4L2CameraFile *file, struct v4l2_buffer *arg)
 	if (arg->index >= bufferCount_)
 		return -EINVAL;
 
-	if (buffers_[arg->index].flags & V4L2_BUF_FLAG_QUEUED)
+	if (bufferFlags(file, arg->index) & (V4L2_BUF_FLAG_QUEUED | V4L2_BUF_FLAG_DONE))
 		return -EINVAL;
 
-	if (!hasOwnership(file))
+	if (!hasBufferAccess(file) || readIO_)
 		return -EBUSY;
 
 	if (!validateBufferType(arg->type) ||
-	    !validateMemoryType(arg->memory) ||
+	    arg->memory != memory_ ||
 	    arg->index >= bufferCount_)
 		return -EINVAL;
 
-	int ret = vcam_->qbuf(arg->index);
-	if (ret < 0)
-		return ret;
+	struct v4l2_buffer &buffer = buffers_[arg->index];
+	int ret;
+
+	switch (memory_) {
+	case V4L2_MEMORY_DMABUF:
+		if (arg->length && arg->length < sizeimage_)
+			return -EINVAL;
+
+		ret = vcam_->qbuf(file->efd(), arg->index, arg->m.fd);
+		if (ret < 0)
+			return ret;
+
+		buffer.m.fd = arg->m.fd;
+		buffer.length = arg->length ? arg->length : sizeimage_;
+		break;
 
-	buffers_[arg->index].flags |= V4L2_BUF_FLAG_QUEUED;
+	case V4L2_MEMORY_USERPTR:
+		if (!arg->m.userptr || arg->length < sizeimage_)
+			return -EINVAL;
 
-	arg->flags = buffers_[arg->index].flags;
+		ret = vcam_->qbuf(file->efd(), arg->index);
+		if (ret < 0)
+			return ret;
+
+		buffer.m.userptr = arg->m.userptr;
+		buffer.length = arg->length;
+		break;
+
+	default:
+		ret = vcam_->qbuf(file->efd(), arg->index);
+		if (ret < 0)
+			return ret;
+		break;
+	}
+
+	arg->flags = bufferFlags(file, arg->index);
 
 	return ret;
 }
@@ -640,44 +907,57 @@ int V4L2CameraProxy::vidioc_dqbuf(V4L2CameraFile *file, struct v4l2_buffer *arg,
 	if (arg->index >= bufferCount_)
 		return -EINVAL;
 
-	if (!hasOwnership(file))
+	if (!hasBufferAccess(file) || readIO_)
 		return -EBUSY;
 
-	if (!vcam_->isRunning())
+	if (!vcam_->isStreaming(file->efd()))
 		return -EINVAL;
 
 	if (!validateBufferType(arg->type) ||
-	    !validateMemoryType(arg->memory))
+	    arg->memory != memory_)
 		return -EINVAL;
 
-	if (!file->nonBlocking()) {
-		lock->unlock();
-		vcam_->waitForBufferAvailable();
-		lock->lock();
-	} else if (!vcam_->isBufferAvailable())
-		return -EAGAIN;
-
 	/*
-	 * We need to check here again in case stream was turned off while we
-	 * were blocked on waitForBufferAvailable().
+	 * Release the proxy lock while waiting for a frame, to let other files
+	 * sharing the stream dequeue and requeue their buffers.
 	 */
-	if (!vcam_->isRunning())
-		return -EINVAL;
+	V4L2Camera::Buffer frame(0, {});
+
+	lock->unlock();
+	int ret = vcam_->dqbuf(file->efd(), file->nonBlocking(), &frame);
+	lock->lock();
 
-	updateBuffers();
+	if (ret < 0)
+		return ret;
+
+	/* The buffers may have been freed while the lock was released. */
+	unsigned int index = frame.index_;
+	if (index >= bufferCount_)
+		return -EINVAL;
 
-	struct v4l2_buffer &buf = buffers_[currentBuf_];
+	updateBuffer(frame);
 
-	buf.flags &= ~(V4L2_BUF_FLAG_QUEUED | V4L2_BUF_FLAG_DONE | V4L2_BUF_FLAG_PREPARED);
-	buf.length = sizeimage_;
-	*arg = buf;
+	struct v4l2_buffer &buf = buffers_[index];
 
-	currentBuf_ = (currentBuf_ + 1) % bufferCount_;
+	switch (memory_) {
+	case V4L2_MEMORY_USERPTR:
+		if (!(buf.flags & V4L2_BUF_FLAG_ERROR)) {
+			ssize_t copied = vcam_->copyBuffer(index,
+							   reinterpret_cast<void *>(buf.m.userptr),
+							   std::min<size_t>(buf.length, buf.bytesused));
+			if (copied < 0)
+				buf.flags |= V4L2_BUF_FLAG_ERROR;
+		}
+		break;
+	case V4L2_MEMORY_MMAP:
+		buf.length = sizeimage_;
+		break;
+	default:
+		break;
+	}
 
-	uint64_t data;
-	int ret = ::read(file->efd(), &data, sizeof(data));
-	if (ret != sizeof(data))
-		LOG(V4L2Compat, Error) << "Failed to clear eventfd POLLIN";
+	*arg = buf;
+	arg->flags = bufferFlags(file, index);
 
 	return 0;
 }
@@ -687,11 +967,10 @@ int V4L2CameraProxy::vidioc_expbuf(V4L2CameraFile *file, struct v4l2_exportbuffe
 	LOG(V4L2Compat, Debug)
 		<< "[" << file->description() << "] " << __func__ << "()";
 
-	if (!hasOwnership(file))
+	if (!hasBufferAccess(file))
 		return -EBUSY;
 
-	/* \todo Verify that the memory type is MMAP when adding DMABUF support */
-	if (!validateBufferType(arg->type))
+	if (!validateBufferType(arg->type) || memory_ != V4L2_MEMORY_MMAP)
 		return -EINVAL;
 
 	if (arg->index >= bufferCount_)
@@ -723,15 +1002,10 @@ int V4L2CameraProxy::vidioc_streamon(V4L2CameraFile *file, int *arg)
 	if (file->priority() < maxPriority())
 		return -EBUSY;
 
-	if (!hasOwnership(file))
+	if (!hasBufferAccess(file))
 		return -EBUSY;
 
-	if (vcam_->isRunning())
-		return 0;
-
-	currentBuf_ = 0;
-
-	return vcam_->streamOn();
+	return vcam_->streamOn(file->efd());
 }
 
 int V4L2CameraProxy::vidioc_streamoff(V4L2CameraFile *file, int *arg)
@@ -745,15 +1019,10 @@ int V4L2CameraProxy::vidioc_streamoff(V4L2CameraFile *file, int *arg)
 	if (file->priority() < maxPriority())
 		return -EBUSY;
 
-	if (!hasOwnership(file) && owner_)
-		return -EBUSY;
+	if (!hasBufferAccess(file))
+		return owner_ ? -EBUSY : 0;
 
-	int ret = vcam_->streamOff();
-
-	for (struct v4l2_buffer &buf : buffers_)
-		buf.flags &= ~(V4L2_BUF_FLAG_QUEUED | V4L2_BUF_FLAG_DONE);
-
-	return ret;
+	return vcam_->streamOff(file->efd());
 }
 
 const std::set<unsigned long> V4L2CameraProxy::supportedIoctls_ = {
@@ -871,6 +1140,52 @@ bool V4L2CameraProxy::hasOwnership(V4L2CameraFile *file)
 	return owner_ == file;
 }
 
+bool V4L2CameraProxy::hasBufferAccess(V4L2CameraFile *file)
+{
+	return owner_ == file || consumers_.count(file);
+}
+
+/*
+ * Share the buffers allocated by the owner with another file. This allows
+ * multiple applications (or multiple file handles of the same application)
+ * to capture from the same camera, with each frame being delivered to all of
+ * them. Only MMAP buffers can be shared, as USERPTR and DMABUF buffers are
+ * provided by the owner.
+ */
+int V4L2CameraProxy::joinStream(V4L2CameraFile *file, struct v4l2_requestbuffers *arg)
+{
+	if (arg->count == 0) {
+		if (consumers_.count(file))
+			leaveStream(file);
+
+		return 0;
+	}
+
+	if (!bufferCount_ || memory_ != V4L2_MEMORY_MMAP ||
+	    arg->memory != V4L2_MEMORY_MMAP)
+		return -EBUSY;
+
+	if (consumers_.insert(file).second) {
+		vcam_->bind(file->efd(), dropPolicy_);
+
+		LOG(V4L2Compat, Debug)
+			<< "[" << file->description() << "] Sharing "
+			<< bufferCount_ << " buffers";
+	}
+
+	arg->count = bufferCount_;
+
+	return 0;
+}
+
+void V4L2CameraProxy::leaveStream(V4L2CameraFile *file)
+{
+	vcam_->streamOff(file->efd());
+	vcam_->unbind(file->efd());
+
+	consumers_.erase(file);
+}
+
 /**
  * \brief Acquire exclusive ownership of the V4L2Camera
  *
@@ -890,7 +1205,7 @@ int V4L2CameraProxy::acquire(V4L2CameraFile *file)
 	if (owner_)
 		return -EBUSY;
 
-	vcam_->bind(file->efd());
+	vcam_->bind(file->efd(), dropPolicy_);
 
 	owner_ = file;
 
@@ -902,7 +1217,7 @@ void V4L2CameraProxy::release(V4L2CameraFile *file)
 	if (owner_ != file)
 		return;
 
-	vcam_->unbind();
+	vcam_->unbind(file->efd());
 
 	owner_ = nullptr;
 }
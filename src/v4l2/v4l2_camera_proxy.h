@@ -32,6 +32,7 @@ public:
 	void *mmap(V4L2CameraFile *file, void *addr, size_t length, int prot,
 		   int flags, off64_t offset);
 	int munmap(V4L2CameraFile *file, void *addr, size_t length);
+	ssize_t read(V4L2CameraFile *file, void *buf, size_t count);
 
 	int ioctl(V4L2CameraFile *file, unsigned long request, void *arg);
 
@@ -42,9 +43,13 @@ private:
 	void querycap(std::shared_ptr<libcamera::Camera> camera);
 	int tryFormat(struct v4l2_format *arg);
 	enum v4l2_priority maxPriority();
-	void updateBuffers();
+	void updateBuffer(const V4L2Camera::Buffer &buffer);
+	uint32_t bufferFlags(V4L2CameraFile *file, unsigned int index);
 	void freeBuffers();
 
+	int startReadIO(V4L2CameraFile *file);
+	void stopReadIO(V4L2CameraFile *file);
+
 	int vidioc_querycap(V4L2CameraFile *file, struct v4l2_capability *arg);
 	int vidioc_enum_framesizes(V4L2CameraFile *file, struct v4l2_frmsizeenum *arg);
 	int vidioc_enum_fmt(V4L2CameraFile *file, struct v4l2_fmtdesc *arg);
@@ -67,17 +72,23 @@ private:
 	int vidioc_streamoff(V4L2CameraFile *file, int *arg);
 
 	bool hasOwnership(V4L2CameraFile *file);
+	bool hasBufferAccess(V4L2CameraFile *file);
+	int joinStream(V4L2CameraFile *file, struct v4l2_requestbuffers *arg);
+	void leaveStream(V4L2CameraFile *file);
 	int acquire(V4L2CameraFile *file);
 	void release(V4L2CameraFile *file);
 
 	static const std::set<unsigned long> supportedIoctls_;
 
+	/* Number of internal buffers cycled through for read() I/O. */
+	static constexpr unsigned int kNumReadBuffers = 3;
+
 	unsigned int refcount_;
 	unsigned int index_;
 
 	libcamera::StreamConfiguration streamConfig_;
+	enum v4l2_memory memory_;
 	unsigned int bufferCount_;
-	unsigned int currentBuf_;
 	unsigned int sizeimage_;
 
 	struct v4l2_capability capabilities_;
@@ -86,6 +97,11 @@ private:
 	std::vector<struct v4l2_buffer> buffers_;
 	std::map<void *, unsigned int> mmaps_;
 
+	/* True when streaming has been started implicitly by read(). */
+	bool readIO_;
+
+	V4L2Camera::DropPolicy dropPolicy_;
+
 	std::set<V4L2CameraFile *> files_;
 
 	std::unique_ptr<V4L2Camera> vcam_;
@@ -97,10 +113,15 @@ private:
 	 * the owner, and when the owner calls reqbufs with count = 0 it will
 	 * release ownership. Any buffer-related ioctl (except querybuf) or
 	 * s_fmt that is called by a non-owner while there exists an owner
-	 * will return -EBUSY.
+	 * will return -EBUSY, with the exception of reqbufs which makes the
+	 * file share the owner's buffers and then queue and dequeue them
+	 * independently.
 	 */
 	V4L2CameraFile *owner_;
 
+	/* Files sharing the buffers allocated by the owner. */
+	std::set<V4L2CameraFile *> consumers_;
+
 	/* This mutex is to serialize access to the proxy. */
 	libcamera::Mutex proxyMutex_;
 };
@@ -125,6 +125,24 @@ LIBCAMERA_PUBLIC int munmap(void *addr, size_t length)
 	return V4L2CompatManager::instance()->munmap(addr, length);
 }
 
+LIBCAMERA_PUBLIC ssize_t read(int fd, void *buf, size_t count)
+{
+	return V4L2CompatManager::instance()->read(fd, buf, count);
+}
+
+/* Provided by the C library, not declared in public headers */
+[[noreturn]] void __chk_fail(void);
+
+/* _FORTIFY_SOURCE redirects read to __read_chk */
+LIBCAMERA_PUBLIC ssize_t __read_chk(int fd, void *buf, size_t count,
+				    size_t buflen)
+{
+	if (count > buflen)
+		__chk_fail();
+
+	return read(fd, buf, count);
+}
+
 LIBCAMERA_PUBLIC int ioctl(int fd, unsigned long request, ...)
 {
 	void *arg;
@@ -39,8 +39,56 @@ void get_symbol(T &func, const char *name)
 }
 } /* namespace */
 
+V4L2CompatManager::CameraFdSet::~CameraFdSet()
+{
+	for (std::atomic<Chunk *> &chunk : chunks_)
+		delete chunk.load(std::memory_order_relaxed);
+}
+
+bool V4L2CompatManager::CameraFdSet::contains(int fd) const
+{
+	if (fd < 0)
+		return false;
+
+	unsigned int index = fd >> kChunkShift;
+	if (index >= kNumChunks)
+		return true;
+
+	const Chunk *chunk = chunks_[index].load(std::memory_order_acquire);
+	if (!chunk)
+		return false;
+
+	return (*chunk)[fd & (kChunkSize - 1)].load(std::memory_order_acquire);
+}
+
+void V4L2CompatManager::CameraFdSet::insert(int fd)
+{
+	unsigned int index = fd >> kChunkShift;
+	if (fd < 0 || index >= kNumChunks)
+		return;
+
+	Chunk *chunk = chunks_[index].load(std::memory_order_relaxed);
+	if (!chunk) {
+		chunk = new Chunk{};
+		chunks_[index].store(chunk, std::memory_order_release);
+	}
+
+	(*chunk)[fd & (kChunkSize - 1)].store(true, std::memory_order_release);
+}
+
+void V4L2CompatManager::CameraFdSet::erase(int fd)
+{
+	unsigned int index = fd >> kChunkShift;
+	if (fd < 0 || index >= kNumChunks)
+		return;
+
+	Chunk *chunk = chunks_[index].load(std::memory_order_relaxed);
+	if (chunk)
+		(*chunk)[fd & (kChunkSize - 1)].store(false, std::memory_order_release);
+}
+
 V4L2CompatManager::V4L2CompatManager()
-	: cm_(nullptr)
+	: cm_(nullptr), numMmaps_(0)
 {
 	get_symbol(fops_.openat, "openat64");
 	get_symbol(fops_.dup, "dup");
@@ -48,12 +96,16 @@ V4L2CompatManager::V4L2CompatManager()
 	get_symbol(fops_.ioctl, "ioctl");
 	get_symbol(fops_.mmap, "mmap64");
 	get_symbol(fops_.munmap, "munmap");
+	get_symbol(fops_.read, "read");
 }
 
 V4L2CompatManager::~V4L2CompatManager()
 {
-	files_.clear();
-	mmaps_.clear();
+	{
+		MutexLocker locker(mutex_);
+		files_.clear();
+		mmaps_.clear();
+	}
 
 	if (cm_) {
 		proxies_.clear();
@@ -99,6 +151,12 @@ V4L2CompatManager *V4L2CompatManager::instance()
 
 std::shared_ptr<V4L2CameraFile> V4L2CompatManager::cameraFile(int fd)
 {
+	/* Fast path for file descriptors unrelated to cameras. */
+	if (!cameraFds_.contains(fd))
+		return nullptr;
+
+	MutexLocker locker(mutex_);
+
 	auto file = files_.find(fd);
 	if (file == files_.end())
 		return nullptr;
@@ -156,9 +214,15 @@ int V4L2CompatManager::openat(int dirfd, const char *path, int oflag, mode_t mod
 		return efd;
 
 	V4L2CameraProxy *proxy = proxies_[ret].get();
-	files_.emplace(efd, std::make_shared<V4L2CameraFile>(dirfd, path, efd,
-							     oflag & O_NONBLOCK,
-							     proxy));
+	std::shared_ptr<V4L2CameraFile> file =
+		std::make_shared<V4L2CameraFile>(dirfd, path, efd,
+						 oflag & O_NONBLOCK, proxy);
+
+	{
+		MutexLocker locker(mutex_);
+		files_.emplace(efd, std::move(file));
+		cameraFds_.insert(efd);
+	}
 
 	LOG(V4L2Compat, Debug) << "Opened " << path << " -> fd " << efd;
 	return efd;
@@ -167,21 +231,31 @@ int V4L2CompatManager::openat(int dirfd, const char *path, int oflag, mode_t mod
 int V4L2CompatManager::dup(int oldfd)
 {
 	int newfd = fops_.dup(oldfd);
-	if (newfd < 0)
+	if (newfd < 0 || !cameraFds_.contains(oldfd))
 		return newfd;
 
+	MutexLocker locker(mutex_);
+
 	auto file = files_.find(oldfd);
-	if (file != files_.end())
+	if (file != files_.end()) {
 		files_[newfd] = file->second;
+		cameraFds_.insert(newfd);
+	}
 
 	return newfd;
 }
 
 int V4L2CompatManager::close(int fd)
 {
-	auto file = files_.find(fd);
-	if (file != files_.end())
-		files_.erase(file);
+	if (cameraFds_.contains(fd)) {
+		MutexLocker locker(mutex_);
+
+		auto file = files_.find(fd);
+		if (file != files_.end()) {
+			files_.erase(file);
+			cameraFds_.erase(fd);
+		}
+	}
 
 	/* We still need to close the eventfd. */
 	return fops_.close(fd);
@@ -199,27 +273,53 @@ void *V4L2CompatManager::mmap(void *addr, size_t length, int prot, int flags,
 	if (map == MAP_FAILED)
 		return map;
 
+	MutexLocker locker(mutex_);
 	mmaps_[map] = file;
+	numMmaps_.fetch_add(1, std::memory_order_release);
+
 	return map;
 }
 
 int V4L2CompatManager::munmap(void *addr, size_t length)
 {
-	auto device = mmaps_.find(addr);
-	if (device == mmaps_.end())
+	/* Fast path when no camera buffer is mapped. */
+	if (!numMmaps_.load(std::memory_order_acquire))
 		return fops_.munmap(addr, length);
 
-	V4L2CameraFile *file = device->second.get();
+	std::shared_ptr<V4L2CameraFile> file;
+
+	{
+		MutexLocker locker(mutex_);
 
-	int ret = file->proxy()->munmap(file, addr, length);
+		auto device = mmaps_.find(addr);
+		if (device == mmaps_.end()) {
+			locker.unlock();
+			return fops_.munmap(addr, length);
+		}
+
+		file = device->second;
+	}
+
+	int ret = file->proxy()->munmap(file.get(), addr, length);
 	if (ret < 0)
 		return ret;
 
-	mmaps_.erase(device);
+	MutexLocker locker(mutex_);
+	if (mmaps_.erase(addr))
+		numMmaps_.fetch_sub(1, std::memory_order_release);
 
 	return 0;
 }
 
+ssize_t V4L2CompatManager::read(int fd, void *buf, size_t count)
+{
+	std::shared_ptr<V4L2CameraFile> file = cameraFile(fd);
+	if (!file)
+		return fops_.read(fd, buf, count);
+
+	return file->proxy()->read(file.get(), buf, count);
+}
+
 int V4L2CompatManager::ioctl(int fd, unsigned long request, void *arg)
 {
 	std::shared_ptr<V4L2CameraFile> file = cameraFile(fd);
@@ -7,12 +7,16 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <fcntl.h>
 #include <map>
 #include <memory>
 #include <sys/types.h>
 #include <vector>
 
+#include <libcamera/base/mutex.h>
+
 #include <libcamera/camera_manager.h>
 
 #include "v4l2_camera_proxy.h"
@@ -29,6 +33,7 @@ public:
 		using mmap_func_t = void *(*)(void *addr, size_t length, int prot,
 					      int flags, int fd, off64_t offset);
 		using munmap_func_t = int (*)(void *addr, size_t length);
+		using read_func_t = ssize_t (*)(int fd, void *buf, size_t count);
 
 		openat_func_t openat;
 		dup_func_t dup;
@@ -36,6 +41,7 @@ public:
 		ioctl_func_t ioctl;
 		mmap_func_t mmap;
 		munmap_func_t munmap;
+		read_func_t read;
 	};
 
 	static V4L2CompatManager *instance();
@@ -49,9 +55,36 @@ public:
 	void *mmap(void *addr, size_t length, int prot, int flags,
 		   int fd, off64_t offset);
 	int munmap(void *addr, size_t length);
+	ssize_t read(int fd, void *buf, size_t count);
 	int ioctl(int fd, unsigned long request, void *arg);
 
 private:
+	/*
+	 * Lock-free set of the camera file descriptors, indexed by fd. It lets
+	 * the interposed functions dismiss file descriptors unrelated to
+	 * cameras without taking the manager lock. Entries are only modified
+	 * with the manager lock held. File descriptors beyond the capacity of
+	 * the set are always reported as possible camera files.
+	 */
+	class CameraFdSet
+	{
+	public:
+		~CameraFdSet();
+
+		bool contains(int fd) const;
+		void insert(int fd);
+		void erase(int fd);
+
+	private:
+		static constexpr unsigned int kChunkShift = 10;
+		static constexpr unsigned int kChunkSize = 1 << kChunkShift;
+		static constexpr unsigned int kNumChunks = 1024;
+
+		using Chunk = std::array<std::atomic<bool>, kChunkSize>;
+
+		std::array<std::atomic<Chunk *>, kNumChunks> chunks_{};
+	};
+
 	V4L2CompatManager();
 	~V4L2CompatManager();
 
@@ -64,6 +97,13 @@ private:
 	libcamera::CameraManager *cm_;
 
 	std::vector<std::unique_ptr<V4L2CameraProxy>> proxies_;
-	std::map<int, std::shared_ptr<V4L2CameraFile>> files_;
-	std::map<void *, std::shared_ptr<V4L2CameraFile>> mmaps_;
+
+	CameraFdSet cameraFds_;
+	std::atomic<unsigned int> numMmaps_;
+
+	libcamera::Mutex mutex_;
+	std::map<int, std::shared_ptr<V4L2CameraFile>> files_
+		LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	std::map<void *, std::shared_ptr<V4L2CameraFile>> mmaps_
+		LIBCAMERA_TSA_GUARDED_BY(mutex_);
 };
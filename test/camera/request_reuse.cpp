@@ -0,0 +1,180 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * libcamera Request reuse allocation tests
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include <libcamera/framebuffer_allocator.h>
+
+#include "libcamera/internal/request.h"
+
+#include "camera_test.h"
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+/*
+ * Count the memory allocations performed by the current thread while counting
+ * is enabled. Other threads are ignored to avoid false positives from
+ * background activity in the camera manager thread.
+ */
+thread_local bool countAllocations = false;
+thread_local unsigned int allocations = 0;
+
+} /* namespace */
+
+void *operator new(std::size_t size)
+{
+	if (countAllocations)
+		allocations++;
+
+	void *ptr = std::malloc(size ? size : 1);
+	if (!ptr)
+		throw std::bad_alloc();
+
+	return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, [[maybe_unused]] std::size_t size) noexcept
+{
+	std::free(ptr);
+}
+
+namespace {
+
+class RequestReuse : public CameraTest, public Test
+{
+public:
+	RequestReuse()
+		: CameraTest("platform/vimc.0 Sensor B")
+	{
+	}
+
+protected:
+	int init() override
+	{
+		if (status_ != TestPass)
+			return status_;
+
+		config_ = camera_->generateConfiguration({ StreamRole::VideoRecording });
+		if (!config_ || config_->size() != 1) {
+			cout << "Failed to generate default configuration" << endl;
+			return TestFail;
+		}
+
+		allocator_ = std::make_unique<FrameBufferAllocator>(camera_);
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		static constexpr unsigned int kIterations = 100;
+
+		if (camera_->acquire()) {
+			cout << "Failed to acquire the camera" << endl;
+			return TestFail;
+		}
+
+		if (camera_->configure(config_.get())) {
+			cout << "Failed to set default configuration" << endl;
+			return TestFail;
+		}
+
+		Stream *stream = config_->at(0).stream();
+
+		int ret = allocator_->allocate(stream);
+		if (ret < 0)
+			return TestFail;
+
+		FrameBuffer *buffer = allocator_->buffers(stream)[0].get();
+
+		std::unique_ptr<Request> request = camera_->createRequest();
+		if (!request) {
+			cout << "Failed to create request" << endl;
+			return TestFail;
+		}
+
+		if (request->addBuffer(stream, buffer)) {
+			cout << "Failed to associate buffer with request" << endl;
+			return TestFail;
+		}
+
+		/*
+		 * Run the request bookkeeping through prepare, buffer
+		 * completion and request completion, as done by the pipeline
+		 * handler, and reuse it with the same buffers. The first
+		 * iteration is not accounted for, to exclude one-time
+		 * initialization.
+		 *
+		 * Request completion logs the request, and the log message
+		 * allocates memory even when debug messages are disabled. It
+		 * is thus run outside of the counted window.
+		 */
+		for (unsigned int i = 0; i <= kIterations; i++) {
+			countAllocations = i != 0;
+
+			request->_d()->prepare();
+
+			if (!request->_d()->completeBuffer(buffer)) {
+				countAllocations = false;
+				cout << "Request still has pending buffers" << endl;
+				return TestFail;
+			}
+
+			countAllocations = false;
+			request->_d()->complete();
+
+			if (request->status() != Request::RequestComplete) {
+				cout << "Request not completed" << endl;
+				return TestFail;
+			}
+
+			countAllocations = i != 0;
+			request->reuse(Request::ReuseBuffers);
+
+			countAllocations = false;
+
+			if (!request->hasPendingBuffers() ||
+			    request->findBuffer(stream) != buffer) {
+				cout << "Request lost its buffer on reuse" << endl;
+				return TestFail;
+			}
+		}
+
+		if (allocations) {
+			cout << "Request reuse performed " << allocations
+			     << " allocations in " << kIterations << " iterations"
+			     << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup() override
+	{
+		allocator_.reset();
+	}
+
+private:
+	std::unique_ptr<CameraConfiguration> config_;
+	std::unique_ptr<FrameBufferAllocator> allocator_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(RequestReuse)
@@ -0,0 +1,117 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * gstreamer_cpu_usage_test.cpp - GStreamer capture CPU usage benchmark
+ */
+
+#include <iostream>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <gst/gst.h>
+
+#include "gstreamer_test.h"
+#include "test.h"
+
+using namespace std;
+
+class GstreamerCpuUsageTest : public GstreamerTest, public Test
+{
+public:
+	GstreamerCpuUsageTest()
+		: GstreamerTest(), frames_(0)
+	{
+	}
+
+protected:
+	int init() override
+	{
+		if (status_ != TestPass)
+			return status_;
+
+		sink_ = gst_element_factory_make("fakesink", "sink");
+		if (!sink_) {
+			g_printerr("Sink could not be created\n");
+			return TestFail;
+		}
+		g_object_ref_sink(sink_);
+
+		if (createPipeline() != TestPass)
+			return TestFail;
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		/* Build the pipeline */
+		gst_bin_add_many(GST_BIN(pipeline_), libcameraSrc_, sink_, NULL);
+		if (gst_element_link(libcameraSrc_, sink_) != TRUE) {
+			g_printerr("Elements could not be linked.\n");
+			return TestFail;
+		}
+
+		/* Count the buffers produced by the source. */
+		g_autoptr(GstPad) pad = gst_element_get_static_pad(libcameraSrc_, "src");
+		gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+				  &GstreamerCpuUsageTest::countBuffer, this, nullptr);
+
+		struct rusage start;
+		getrusage(RUSAGE_SELF, &start);
+
+		if (startPipeline() != TestPass)
+			return TestFail;
+
+		if (processEvent() != TestPass)
+			return TestFail;
+
+		struct rusage end;
+		getrusage(RUSAGE_SELF, &end);
+
+		if (!frames_) {
+			g_printerr("No frame captured\n");
+			return TestFail;
+		}
+
+		/*
+		 * The CPU time includes the pipeline start and stop, which is
+		 * amortized over the number of captured frames.
+		 */
+		long cpuTime = timevalDiff(end.ru_utime, start.ru_utime) +
+			       timevalDiff(end.ru_stime, start.ru_stime);
+
+		cout << "Captured " << frames_ << " frames, "
+		     << cpuTime / frames_ << " us of CPU time per frame"
+		     << endl;
+
+		return TestPass;
+	}
+
+	void cleanup() override
+	{
+		g_clear_object(&sink_);
+	}
+
+private:
+	static long timevalDiff(const struct timeval &a, const struct timeval &b)
+	{
+		return (a.tv_sec - b.tv_sec) * 1000000 + (a.tv_usec - b.tv_usec);
+	}
+
+	static GstPadProbeReturn countBuffer([[maybe_unused]] GstPad *pad,
+					     [[maybe_unused]] GstPadProbeInfo *info,
+					     gpointer userData)
+	{
+		GstreamerCpuUsageTest *test = static_cast<GstreamerCpuUsageTest *>(userData);
+		test->frames_++;
+
+		return GST_PAD_PROBE_OK;
+	}
+
+	GstElement *sink_;
+	unsigned int frames_;
+};
+
+TEST_REGISTER(GstreamerCpuUsageTest)
@@ -0,0 +1,144 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * gstreamer_low_latency_test.cpp - GStreamer low-latency capture test
+ */
+
+#include <iostream>
+#include <unistd.h>
+
+#include <gst/gst.h>
+
+#include "gstreamer_test.h"
+#include "test.h"
+
+using namespace std;
+
+class GstreamerLowLatencyTest : public GstreamerTest, public Test
+{
+public:
+	GstreamerLowLatencyTest()
+		: GstreamerTest(), frames_(0), lastPts_(GST_CLOCK_TIME_NONE),
+		  duration_(0), minLatency_(0), maxLatency_(GST_CLOCK_TIME_NONE)
+	{
+	}
+
+protected:
+	static constexpr guint kBufferCount = 8;
+	static constexpr unsigned int kLatencyFrame = 10;
+
+	int init() override
+	{
+		if (status_ != TestPass)
+			return status_;
+
+		sink_ = gst_element_factory_make("fakesink", "sink");
+		if (!sink_) {
+			g_printerr("Sink could not be created\n");
+			return TestFail;
+		}
+		g_object_ref_sink(sink_);
+
+		if (createPipeline() != TestPass)
+			return TestFail;
+
+		g_object_set(libcameraSrc_, "buffer-count", kBufferCount,
+			     "low-latency", TRUE, NULL);
+
+		guint bufferCount;
+		gboolean lowLatency;
+		g_object_get(libcameraSrc_, "buffer-count", &bufferCount,
+			     "low-latency", &lowLatency, NULL);
+		if (bufferCount != kBufferCount || !lowLatency) {
+			g_printerr("Failed to set the source properties\n");
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		/* Build the pipeline */
+		gst_bin_add_many(GST_BIN(pipeline_), libcameraSrc_, sink_, NULL);
+		if (gst_element_link(libcameraSrc_, sink_) != TRUE) {
+			g_printerr("Elements could not be linked.\n");
+			return TestFail;
+		}
+
+		g_autoptr(GstPad) pad = gst_element_get_static_pad(libcameraSrc_, "src");
+		gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER,
+				  &GstreamerLowLatencyTest::processBuffer, this, nullptr);
+
+		if (startPipeline() != TestPass)
+			return TestFail;
+
+		if (processEvent() != TestPass)
+			return TestFail;
+
+		if (frames_ < kLatencyFrame) {
+			cout << "Only " << frames_ << " frames captured, skipping" << endl;
+			return TestSkip;
+		}
+
+		if (!GST_CLOCK_TIME_IS_VALID(maxLatency_) || maxLatency_ < minLatency_) {
+			g_printerr("Invalid latency reported\n");
+			return TestFail;
+		}
+
+		/*
+		 * The max latency accounts for the frames held by the requests
+		 * queued after the one being captured. In low-latency mode
+		 * fewer requests than buffers must be in flight, with a margin
+		 * of one frame for jitter.
+		 */
+		GstClockTime queued = maxLatency_ - minLatency_;
+		if (queued >= (kBufferCount - 2) * duration_) {
+			g_printerr("Latency of %" GST_TIME_FORMAT " for %u buffers of %"
+				   GST_TIME_FORMAT ", requests not limited\n",
+				   GST_TIME_ARGS(queued), kBufferCount,
+				   GST_TIME_ARGS(duration_));
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup() override
+	{
+		g_clear_object(&sink_);
+	}
+
+private:
+	static GstPadProbeReturn processBuffer(GstPad *pad, GstPadProbeInfo *info,
+					       gpointer userData)
+	{
+		GstreamerLowLatencyTest *test = static_cast<GstreamerLowLatencyTest *>(userData);
+		GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+		GstClockTime pts = GST_BUFFER_PTS(buffer);
+
+		if (GST_CLOCK_TIME_IS_VALID(test->lastPts_) && pts > test->lastPts_)
+			test->duration_ = pts - test->lastPts_;
+		test->lastPts_ = pts;
+
+		/* Query the latency once it has settled. */
+		if (++test->frames_ == kLatencyFrame) {
+			g_autoptr(GstQuery) query = gst_query_new_latency();
+			if (gst_pad_query(pad, query))
+				gst_query_parse_latency(query, nullptr, &test->minLatency_,
+							&test->maxLatency_);
+		}
+
+		return GST_PAD_PROBE_OK;
+	}
+
+	GstElement *sink_;
+	unsigned int frames_;
+	GstClockTime lastPts_;
+	GstClockTime duration_;
+	GstClockTime minLatency_;
+	GstClockTime maxLatency_;
+};
+
+TEST_REGISTER(GstreamerLowLatencyTest)
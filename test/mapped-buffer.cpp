@@ -9,6 +9,7 @@
 
 #include <libcamera/framebuffer_allocator.h>
 
+#include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/mapped_framebuffer.h"
 
 #include "camera_test.h"
@@ -103,6 +104,29 @@ protected:
 			return TestFail;
 		}
 
+		/* Test the mappings cached by the frame buffer. */
+		const MappedFrameBuffer *cached =
+			buffer->_d()->map(MappedFrameBuffer::MapFlag::Read);
+		if (!cached || !cached->isValid()) {
+			cout << "Failed to map cached buffer" << endl;
+			return TestFail;
+		}
+
+		if (buffer->_d()->map(MappedFrameBuffer::MapFlag::Read) != cached) {
+			cout << "Cached mapping not reused" << endl;
+			return TestFail;
+		}
+
+		if (buffer->_d()->map(MappedFrameBuffer::MapFlag::ReadWrite) == cached) {
+			cout << "Cached mapping reused with different flags" << endl;
+			return TestFail;
+		}
+
+		if (cached->beginCpuAccess() || cached->endCpuAccess()) {
+			cout << "Failed to synchronize cached mapping" << endl;
+			return TestFail;
+		}
+
 		return TestPass;
 	}
 
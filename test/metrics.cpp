@@ -0,0 +1,221 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * metrics.cpp - Latency metrics tests
+ */
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <libcamera/base/metrics.h>
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+class MetricsTest : public Test
+{
+protected:
+	int testBuckets()
+	{
+		/* Bucket indices must be monotonic and match the lower bounds. */
+		unsigned int prev = 0;
+
+		for (unsigned int shift = 1; shift < 64; ++shift) {
+			for (uint64_t value : { 1ULL << shift, (1ULL << shift) + 1,
+						(2ULL << shift) - 1 }) {
+				unsigned int index = MetricHistogram::bucketIndex(value);
+				if (index < prev || index >= MetricHistogram::kBuckets) {
+					cerr << "Invalid bucket " << index
+					     << " for value " << value << endl;
+					return TestFail;
+				}
+
+				if (MetricHistogram::bucketLowerBound(index) > value ||
+				    (index + 1 < MetricHistogram::kBuckets &&
+				     MetricHistogram::bucketLowerBound(index + 1) <= value)) {
+					cerr << "Value " << value
+					     << " out of bucket " << index << endl;
+					return TestFail;
+				}
+
+				prev = index;
+			}
+		}
+
+		return TestPass;
+	}
+
+	int testPercentiles()
+	{
+		MetricHistogram histogram("test.percentiles");
+
+		if (histogram.percentile(50) != 0 || histogram.min() != 0) {
+			cerr << "Empty histogram reports values" << endl;
+			return TestFail;
+		}
+
+		for (uint64_t value = 1; value <= 10000; ++value)
+			histogram.record(value);
+
+		if (histogram.count() != 10000 || histogram.sum() != 50005000 ||
+		    histogram.min() != 1 || histogram.max() != 10000) {
+			cerr << "Invalid histogram statistics" << endl;
+			return TestFail;
+		}
+
+		/* Percentiles are accurate to 1/8th of their value. */
+		for (double percent : { 1.0, 10.0, 50.0, 90.0, 99.0 }) {
+			double expected = percent * 100;
+			double value = histogram.percentile(percent);
+
+			if (value < expected * 7 / 8 || value > expected * 9 / 8) {
+				cerr << "Percentile " << percent << " is " << value
+				     << ", expected " << expected << endl;
+				return TestFail;
+			}
+		}
+
+		if (histogram.percentile(100) != 10000) {
+			cerr << "Percentile 100 doesn't match the maximum" << endl;
+			return TestFail;
+		}
+
+		histogram.reset();
+		if (histogram.count() || histogram.max()) {
+			cerr << "Failed to reset histogram" << endl;
+			return TestFail;
+		}
+
+		histogram.record(std::chrono::microseconds(3));
+		if (histogram.sum() != 3000) {
+			cerr << "Durations are not recorded in nanoseconds" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testConcurrency()
+	{
+		static constexpr unsigned int kThreads = 4;
+		static constexpr unsigned int kValues = 100000;
+
+		MetricHistogram histogram("test.concurrency");
+		MetricCounter counter("test.concurrency");
+
+		vector<thread> threads;
+		for (unsigned int i = 0; i < kThreads; ++i) {
+			threads.emplace_back([&, i]() {
+				for (unsigned int j = 0; j < kValues; ++j) {
+					histogram.record(i * kValues + j);
+					counter.add();
+				}
+			});
+		}
+
+		for (thread &thread : threads)
+			thread.join();
+
+		if (histogram.count() != kThreads * kValues ||
+		    counter.value() != kThreads * kValues ||
+		    histogram.min() != 0 ||
+		    histogram.max() != kThreads * kValues - 1) {
+			cerr << "Concurrent updates lost" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testRegistry()
+	{
+		MetricsRegistry *registry = MetricsRegistry::instance();
+
+		{
+			MetricHistogram histogram("test.registry.histogram");
+			MetricCounter counter("test.registry.counter");
+
+			histogram.record(1000);
+			counter.add(42);
+
+			vector<MetricsRegistry::HistogramStats> histograms =
+				registry->histograms();
+			auto hist = find_if(histograms.begin(), histograms.end(),
+					    [](const MetricsRegistry::HistogramStats &stats) {
+						    return stats.name == "test.registry.histogram";
+					    });
+			if (hist == histograms.end() || hist->count != 1 ||
+			    hist->p50 != 1000) {
+				cerr << "Histogram not registered" << endl;
+				return TestFail;
+			}
+
+			vector<MetricsRegistry::CounterStats> counters =
+				registry->counters();
+			auto count = find_if(counters.begin(), counters.end(),
+					     [](const MetricsRegistry::CounterStats &stats) {
+						     return stats.name == "test.registry.counter";
+					     });
+			if (count == counters.end() || count->value != 42) {
+				cerr << "Counter not registered" << endl;
+				return TestFail;
+			}
+
+			stringstream dump;
+			dump << setprecision(3);
+			registry->dump(dump);
+			if (dump.str().find("test.registry.histogram") == string::npos ||
+			    dump.str().find("test.registry.counter") == string::npos) {
+				cerr << "Metrics missing from dump" << endl;
+				return TestFail;
+			}
+
+			/* The dump must not alter the format state of the stream. */
+			if (dump.precision() != 3 || dump.flags() != stringstream().flags()) {
+				cerr << "Dump altered the stream format" << endl;
+				return TestFail;
+			}
+
+			registry->reset();
+			if (histogram.count() || counter.value()) {
+				cerr << "Failed to reset metrics" << endl;
+				return TestFail;
+			}
+		}
+
+		for (const MetricsRegistry::HistogramStats &stats : registry->histograms()) {
+			if (stats.name == "test.registry.histogram") {
+				cerr << "Histogram not unregistered" << endl;
+				return TestFail;
+			}
+		}
+
+		return TestPass;
+	}
+
+	int run()
+	{
+		int ret = testBuckets();
+		if (ret != TestPass)
+			return ret;
+
+		ret = testPercentiles();
+		if (ret != TestPass)
+			return ret;
+
+		ret = testConcurrency();
+		if (ret != TestPass)
+			return ret;
+
+		return testRegistry();
+	}
+};
+
+TEST_REGISTER(MetricsTest)
@@ -0,0 +1,135 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * simple_pipeline_test.cpp - Simple pipeline handler capture formats cache test
+ */
+
+#include <errno.h>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include <libcamera/base/metrics.h>
+
+#include <libcamera/camera.h>
+#include <libcamera/camera_manager.h>
+
+#include "libcamera/internal/camera.h"
+#include "libcamera/internal/pipeline_handler.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+/*
+ * Verify that matching the cameras of the simple pipeline handler a second
+ * time in the same process produces the same configurations, served from the
+ * capture formats cache without trying formats on the subdevices.
+ *
+ * The test is supposed to be run on a platform supported by the simple
+ * pipeline handler, and is skipped otherwise.
+ */
+class SimplePipelineTest : public Test
+{
+protected:
+	int init() override
+	{
+		/* Populate the capture formats cache. */
+		int ret = listCameras(&cameras_);
+		if (ret != TestPass)
+			return ret;
+
+		if (cameras_.empty()) {
+			cerr << "No camera handled by the simple pipeline: test skip" << endl;
+			return TestSkip;
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		MetricsRegistry::instance()->reset();
+
+		map<string, string> cameras;
+		int ret = listCameras(&cameras);
+		if (ret != TestPass)
+			return ret;
+
+		if (cameras != cameras_) {
+			cerr << "Cameras differ when matched twice" << endl;
+			return TestFail;
+		}
+
+		for (const auto &counter : MetricsRegistry::instance()->counters()) {
+			if (counter.name != "v4l2.subdev.try_format")
+				continue;
+
+			if (counter.value) {
+				cerr << counter.value
+				     << " TRY formats set when matching cameras again"
+				     << endl;
+				return TestFail;
+			}
+		}
+
+		return TestPass;
+	}
+
+private:
+	/*
+	 * Start a camera manager and describe the default configuration of each
+	 * camera handled by the simple pipeline, indexed by camera ID.
+	 */
+	int listCameras(map<string, string> *cameras)
+	{
+		unique_ptr<CameraManager> cm = make_unique<CameraManager>();
+		int ret = cm->start();
+		if (ret == -ENODEV) {
+			cerr << "No media device found: test skip" << endl;
+			return TestSkip;
+		} else if (ret) {
+			cerr << "Failed to start the CameraManager" << endl;
+			return TestFail;
+		}
+
+		for (const shared_ptr<Camera> &camera : cm->cameras()) {
+			PipelineHandler *pipe = camera->_d()->pipe();
+			if (pipe->name() != string("SimplePipelineHandler"))
+				continue;
+
+			unique_ptr<CameraConfiguration> config =
+				camera->generateConfiguration({ StreamRole::Viewfinder });
+			if (!config) {
+				cerr << "Failed to generate configuration for "
+				     << camera->id() << endl;
+				cm->stop();
+				return TestFail;
+			}
+
+			const StreamFormats &formats = config->at(0).formats();
+			stringstream desc;
+
+			desc << config->at(0).toString();
+			for (const PixelFormat &format : formats.pixelformats()) {
+				desc << " " << format << ":";
+				for (const Size &size : formats.sizes(format))
+					desc << " " << size;
+			}
+
+			(*cameras)[camera->id()] = desc.str();
+		}
+
+		cm->stop();
+
+		return TestPass;
+	}
+
+	map<string, string> cameras_;
+};
+
+TEST_REGISTER(SimplePipelineTest)
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+
+# SPDX-License-Identifier: GPL-2.0-or-later
+# Copyright (C) 2022, Google Inc.
+
+# Measure the CPU time spent in Python per frame to set controls on, reuse and
+# queue requests, comparing the per-request and the batch APIs.
+
+import libcamera as libcam
+import selectors
+import sys
+import time
+
+NUM_FRAMES = 300
+
+
+def capture(cm, cam, batch):
+    camconfig = cam.generate_configuration([libcam.StreamRole.Viewfinder])
+    streamconfig = camconfig.at(0)
+
+    ret = cam.configure(camconfig)
+    assert ret == 0
+
+    stream = streamconfig.stream
+
+    allocator = libcam.FrameBufferAllocator(cam)
+    ret = allocator.allocate(stream)
+    assert ret > 0
+
+    reqs = []
+    for i, buffer in enumerate(allocator.buffers(stream)):
+        req = cam.create_request(i)
+        ret = req.add_buffer(stream, buffer)
+        assert ret == 0
+        reqs.append(req)
+
+    sel = selectors.DefaultSelector()
+    sel.register(cm.event_fd, selectors.EVENT_READ)
+
+    ret = cam.start()
+    assert ret == 0
+
+    ret = cam.queue_requests(reqs)
+    assert ret == 0
+
+    frames = 0
+    cpu = 0
+
+    while frames < NUM_FRAMES:
+        sel.select()
+
+        ready = cm.get_ready_requests()
+
+        start = time.thread_time_ns()
+
+        if batch:
+            # Reusing a request clears its controls, pass them to
+            # queue_requests() to have them set after reuse.
+            ret = cam.queue_requests(ready, reuse=True,
+                                     controls={libcam.controls.Brightness: 0.0})
+            assert ret == 0
+        else:
+            for req in ready:
+                req.reuse()
+                req.set_control(libcam.controls.Brightness, 0.0)
+                ret = cam.queue_request(req)
+                assert ret == 0
+
+        cpu += time.thread_time_ns() - start
+        frames += len(ready)
+
+    ret = cam.stop()
+    assert ret == 0
+
+    # Drain the requests cancelled by stop()
+    if sel.select(timeout=0):
+        cm.get_ready_requests()
+
+    sel.close()
+
+    return cpu / frames
+
+
+def main():
+    cm = libcam.CameraManager.singleton()
+    cam = next((cam for cam in cm.cameras if 'platform/vimc' in cam.id), None)
+    if cam is None:
+        print('No vimc camera found')
+        return 0
+
+    ret = cam.acquire()
+    assert ret == 0
+
+    for batch in [False, True]:
+        cpu = capture(cm, cam, batch)
+        print(f'{"batch" if batch else "single"}: {cpu / 1000:.1f} us of CPU time per frame')
+
+    ret = cam.release()
+    assert ret == 0
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
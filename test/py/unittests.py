@@ -3,10 +3,12 @@
 # SPDX-License-Identifier: GPL-2.0-or-later
 # Copyright (C) 2022, Tomi Valkeinen <tomi.valkeinen@ideasonboard.com>
 
+import asyncio
 from collections import defaultdict
 import errno
 import gc
 import libcamera as libcam
+import libcamera.utils
 import selectors
 import time
 import typing
@@ -159,6 +161,55 @@ class AllocatorTestMethods(CameraTesterBase):
         self.assertIsNone(wr_camconfig())
         self.assertIsNone(wr_streamconfig())
 
+    def test_mapped_buffer(self):
+        cam = self.cam
+
+        camconfig = cam.generate_configuration([libcam.StreamRole.StillCapture])
+        streamconfig = camconfig.at(0)
+
+        ret = cam.configure(camconfig)
+        self.assertZero(ret)
+
+        stream = streamconfig.stream
+
+        allocator = libcam.FrameBufferAllocator(cam)
+        ret = allocator.allocate(stream)
+        self.assertTrue(ret > 0)
+
+        buffer = allocator.buffers(stream)[0]
+
+        # Without a configuration, the planes are flat arrays of bytes
+        mfb = libcam.FrameBufferView(buffer)
+        self.assertTrue(len(mfb.planes) == len(buffer.planes))
+
+        mv = memoryview(mfb.planes[0])
+        self.assertTrue(mv.ndim == 1)
+        self.assertTrue(mv.nbytes == buffer.planes[0].length)
+
+        # The mapping is shared by all FrameBufferView instances of a buffer
+        mv[0] = 0x5a
+        mv2 = memoryview(libcam.FrameBufferView(buffer).planes[0])
+        self.assertTrue(mv2[0] == 0x5a)
+
+        # The mapping is tied to the FrameBuffer object, and outlives it as
+        # long as a plane view references it
+        buffer = None
+        mfb = None
+        mv2 = None
+        gc.collect()
+        self.assertTrue(mv[0] == 0x5a)
+
+        buffer = allocator.buffers(stream)[0]
+
+        # With a configuration, the planes are shaped to the image size
+        mfb = libcam.FrameBufferView(buffer, streamconfig)
+        shape = mfb.planes[0].shape
+        self.assertTrue(shape[0] == streamconfig.size.height)
+
+        mv = memoryview(mfb.planes[0])
+        self.assertTrue(mv.shape == shape)
+        self.assertTrue(mv.strides[0] == streamconfig.stride)
+
 
 class SimpleCaptureMethods(CameraTesterBase):
     def test_blocking(self):
@@ -226,6 +277,69 @@ class SimpleCaptureMethods(CameraTesterBase):
         ret = cam.stop()
         self.assertZero(ret)
 
+    def test_queue_requests(self):
+        cm = self.cm
+        cam = self.cam
+
+        camconfig = cam.generate_configuration([libcam.StreamRole.StillCapture])
+        streamconfig = camconfig.at(0)
+
+        ret = cam.configure(camconfig)
+        self.assertZero(ret)
+
+        stream = streamconfig.stream
+
+        allocator = libcam.FrameBufferAllocator(cam)
+        ret = allocator.allocate(stream)
+        self.assertTrue(ret > 0)
+
+        reqs = []
+        for i, buffer in enumerate(allocator.buffers(stream)):
+            req = cam.create_request(i)
+            ret = req.add_buffer(stream, buffer)
+            self.assertZero(ret)
+            reqs.append(req)
+
+        num_bufs = len(reqs)
+
+        brightness = libcam.ControlSetter(libcam.controls.Brightness)
+        brightness(reqs, 0.5)
+
+        ret = cam.start()
+        self.assertZero(ret)
+
+        ret = cam.queue_requests(reqs)
+        self.assertZero(ret)
+
+        reqs = None
+        gc.collect()
+
+        # Requeue all requests once, reusing them
+        reqs = []
+        while len(reqs) < num_bufs:
+            reqs += cm.get_ready_requests()
+
+        # Reusing the requests clears their controls, the controls passed
+        # to queue_requests() are set after reuse
+        ret = cam.queue_requests(reqs, reuse=True,
+                                 controls={libcam.controls.Brightness: 0.25})
+        self.assertZero(ret)
+
+        reqs = []
+        while len(reqs) < num_bufs:
+            reqs += cm.get_ready_requests()
+
+        self.assertTrue(sorted([req.cookie for req in reqs]) == list(range(num_bufs)))
+
+        for req in reqs:
+            self.assertEqual(req.status, libcam.Request.Status.Complete)
+
+        reqs = None
+        gc.collect()
+
+        ret = cam.stop()
+        self.assertZero(ret)
+
     def test_select(self):
         cm = self.cm
         cam = self.cam
@@ -299,6 +413,75 @@ class SimpleCaptureMethods(CameraTesterBase):
         ret = cam.stop()
         self.assertZero(ret)
 
+    def test_request_waiter(self):
+        cm = self.cm
+        cam = self.cam
+
+        camconfig = cam.generate_configuration([libcam.StreamRole.StillCapture])
+        streamconfig = camconfig.at(0)
+
+        ret = cam.configure(camconfig)
+        self.assertZero(ret)
+
+        stream = streamconfig.stream
+
+        allocator = libcam.FrameBufferAllocator(cam)
+        ret = allocator.allocate(stream)
+        self.assertTrue(ret > 0)
+
+        reqs = []
+        for i, buffer in enumerate(allocator.buffers(stream)):
+            req = cam.create_request(i)
+            ret = req.add_buffer(stream, buffer)
+            self.assertZero(ret)
+            reqs.append(req)
+
+        num_bufs = len(reqs)
+
+        ret = cam.start()
+        self.assertZero(ret)
+
+        ret = cam.queue_requests(reqs)
+        self.assertZero(ret)
+
+        reqs = None
+        gc.collect()
+
+        async def capture(waiter):
+            # Wait for all requests, requeue them once, and wait for them
+            # again by iterating over the waiter
+            reqs = []
+            while len(reqs) < num_bufs:
+                reqs += await waiter.wait_requests()
+
+            ret = cam.queue_requests(reqs, reuse=True)
+            self.assertZero(ret)
+
+            reqs = []
+            async for ready in waiter:
+                self.assertTrue(len(ready) > 0)
+                reqs += ready
+                if len(reqs) == num_bufs:
+                    break
+
+            return reqs
+
+        async def run():
+            async with libcamera.utils.RequestWaiter(cm) as waiter:
+                return await asyncio.wait_for(capture(waiter), timeout=5)
+
+        reqs = asyncio.run(run())
+
+        self.assertTrue(sorted([req.cookie for req in reqs]) == list(range(num_bufs)))
+        for req in reqs:
+            self.assertTrue(req.status == libcam.Request.Status.Complete)
+
+        reqs = None
+        gc.collect()
+
+        ret = cam.stop()
+        self.assertZero(ret)
+
 
 # Recursively expand slist's objects into olist, using seen to track already
 # processed objects.
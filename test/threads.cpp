@@ -8,6 +8,10 @@
 #include <chrono>
 #include <iostream>
 #include <memory>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string>
 #include <thread>
 
 #include <libcamera/base/thread.h>
@@ -35,6 +39,34 @@ private:
 	chrono::steady_clock::duration duration_;
 };
 
+class InspectThread : public Thread
+{
+public:
+	InspectThread(const std::string &name)
+		: Thread(name), cpuCount_(0), policy_(-1)
+	{
+		CPU_ZERO(&cpus_);
+	}
+
+	std::string threadName_;
+	cpu_set_t cpus_;
+	int cpuCount_;
+	int policy_;
+
+protected:
+	void run()
+	{
+		char name[16] = {};
+		pthread_getname_np(pthread_self(), name, sizeof(name));
+		threadName_ = name;
+
+		sched_getaffinity(0, sizeof(cpus_), &cpus_);
+		cpuCount_ = CPU_COUNT(&cpus_);
+
+		policy_ = sched_getscheduler(0);
+	}
+};
+
 class ThreadTest : public Test
 {
 protected:
@@ -118,6 +150,71 @@ protected:
 			return TestFail;
 		}
 
+		return testScheduling();
+	}
+
+	int testScheduling()
+	{
+		cpu_set_t available;
+		if (sched_getaffinity(0, sizeof(available), &available) < 0)
+			return TestSkip;
+
+		unsigned int cpu = 0;
+		while (!CPU_ISSET(cpu, &available))
+			cpu++;
+
+		/*
+		 * The configuration from the environment is parsed when the
+		 * first named thread starts, set it first.
+		 */
+		std::string config = "other-thread=other;env-*=other@" +
+				     std::to_string(cpu);
+		setenv("LIBCAMERA_THREAD_CONFIG", config.c_str(), 1);
+
+		/* Test the thread name, priority and affinity. */
+		auto inspect = std::make_unique<InspectThread>("test-thread-name");
+
+		if (inspect->setPriority(Thread::Policy::Other, 1) != -EINVAL) {
+			cout << "Invalid priority accepted" << endl;
+			return TestFail;
+		}
+
+		if (inspect->setPriority(Thread::Policy::Other) ||
+		    inspect->setAffinity({ cpu })) {
+			cout << "Failed to set thread scheduling parameters" << endl;
+			return TestFail;
+		}
+
+		inspect->start();
+		inspect->wait();
+
+		if (inspect->threadName_ != "test-thread-nam") {
+			cout << "Thread name not set (got '" << inspect->threadName_
+			     << "')" << endl;
+			return TestFail;
+		}
+
+		if (inspect->policy_ != SCHED_OTHER) {
+			cout << "Thread scheduling policy not set" << endl;
+			return TestFail;
+		}
+
+		if (inspect->cpuCount_ != 1 || !CPU_ISSET(cpu, &inspect->cpus_)) {
+			cout << "Thread CPU affinity not set" << endl;
+			return TestFail;
+		}
+
+		/* Test the configuration from the environment. */
+		inspect = std::make_unique<InspectThread>("env-thread");
+		inspect->start();
+		inspect->wait();
+
+		if (inspect->cpuCount_ != 1 || !CPU_ISSET(cpu, &inspect->cpus_)) {
+			cout << "Thread CPU affinity not set from environment"
+			     << endl;
+			return TestFail;
+		}
+
 		return TestPass;
 	}
 
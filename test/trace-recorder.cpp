@@ -0,0 +1,206 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * trace-recorder.cpp - Trace recorder tests
+ */
+
+#include <iomanip>
+#include <iostream>
+#include <pthread.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <libcamera/base/trace_recorder.h>
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+namespace {
+
+const char *const argNames[] = { "index", "value", "label" };
+
+unsigned int countOccurrences(const string &str, const string &pattern)
+{
+	unsigned int count = 0;
+
+	for (size_t pos = str.find(pattern); pos != string::npos;
+	     pos = str.find(pattern, pos + pattern.size()))
+		count++;
+
+	return count;
+}
+
+} /* namespace */
+
+class TraceRecorderTest : public Test
+{
+protected:
+	int init()
+	{
+		if (TraceRecorder::enabled()) {
+			cerr << "Trace recorder enabled from the environment" << endl;
+			return TestSkip;
+		}
+
+		return TestPass;
+	}
+
+	int testDisabled()
+	{
+		TraceRecorder *recorder = TraceRecorder::instance();
+
+		recorder->record("test", "disabled", nullptr, 1);
+		{
+			LIBCAMERA_TRACE_SCOPE("disabled.scope");
+		}
+
+		stringstream trace;
+		recorder->write(trace);
+		if (trace.str().find("disabled") != string::npos) {
+			cerr << "Event recorded while disabled" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testThreads()
+	{
+		static constexpr unsigned int kThreads = 4;
+		static constexpr unsigned int kEvents = 1000;
+
+		TraceRecorder *recorder = TraceRecorder::instance();
+		recorder->start();
+
+		vector<thread> threads;
+		for (unsigned int i = 0; i < kThreads; ++i) {
+			threads.emplace_back([&, i]() {
+				string name = "tracer-" + to_string(i);
+				pthread_setname_np(pthread_self(), name.c_str());
+
+				for (unsigned int j = 0; j < kEvents; ++j) {
+					LIBCAMERA_TRACE_SCOPE("test.scope");
+					recorder->record("test", "test.event", argNames,
+							 j, -1.5, "a \"quoted\" label");
+				}
+			});
+		}
+
+		for (thread &thread : threads)
+			thread.join();
+
+		recorder->begin("test", "test.duration");
+		recorder->end("test", "test.duration");
+		recorder->record("test", "test.escape", nullptr, "tab\t");
+
+		recorder->stop();
+
+		stringstream stream;
+		recorder->write(stream);
+		string trace = stream.str();
+
+		if (trace.find("{\"traceEvents\":[") != 0 ||
+		    trace.find("\"dropped_events\":0}") == string::npos) {
+			cerr << "Invalid trace structure" << endl;
+			return TestFail;
+		}
+
+		/* The label argument doesn't fit in an event and is truncated. */
+		string truncated = "\"truncated_strings\":" + to_string(kThreads * kEvents) + ",";
+		if (trace.find(truncated) == string::npos) {
+			cerr << "Truncated strings not reported" << endl;
+			return TestFail;
+		}
+
+		for (unsigned int i = 0; i < kThreads; ++i) {
+			string name = "\"args\":{\"name\":\"tracer-" + to_string(i) + "\"}";
+			if (trace.find(name) == string::npos) {
+				cerr << "Thread " << i << " name not found" << endl;
+				return TestFail;
+			}
+		}
+
+		if (countOccurrences(trace, "\"name\":\"test.event\"") != kThreads * kEvents ||
+		    countOccurrences(trace, "\"name\":\"test.scope\"") != kThreads * kEvents) {
+			cerr << "Events lost" << endl;
+			return TestFail;
+		}
+
+		if (trace.find("\"args\":{\"index\":999,\"value\":-1.500,\"label\":\"a \\\"quoted\\\" labe\"}") == string::npos) {
+			cerr << "Invalid event arguments" << endl;
+			return TestFail;
+		}
+
+		if (countOccurrences(trace, "\"ph\":\"B\"") != 1 ||
+		    countOccurrences(trace, "\"ph\":\"E\"") != 1) {
+			cerr << "Duration events not recorded" << endl;
+			return TestFail;
+		}
+
+		if (trace.find("\"arg0\":\"tab\\u0009\"") == string::npos) {
+			cerr << "Control character not escaped" << endl;
+			return TestFail;
+		}
+
+		/* Writing the trace must not alter the stream formatting. */
+		stream.str("");
+		stream << setw(4) << 42 << " " << 1.5;
+		if (stream.str() != "  42 1.5") {
+			cerr << "Stream formatting altered: " << stream.str() << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testOverflow()
+	{
+		static constexpr unsigned int kEvents = 100000;
+
+		TraceRecorder *recorder = TraceRecorder::instance();
+		recorder->start();
+
+		/* Record from a new thread to get an empty buffer. */
+		thread([&]() {
+			for (unsigned int i = 0; i < kEvents; ++i)
+				recorder->record("test", "test.overflow", nullptr, i);
+		}).join();
+
+		recorder->stop();
+
+		stringstream stream;
+		recorder->write(stream);
+		string trace = stream.str();
+
+		unsigned int recorded = countOccurrences(trace, "\"name\":\"test.overflow\"");
+		string dropped = "\"dropped_events\":" + to_string(kEvents - recorded) + "}";
+
+		if (recorded == 0 || recorded == kEvents ||
+		    trace.find(dropped) == string::npos) {
+			cerr << "Dropped events not reported" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int run()
+	{
+		int ret = testDisabled();
+		if (ret != TestPass)
+			return ret;
+
+		ret = testThreads();
+		if (ret != TestPass)
+			return ret;
+
+		return testOverflow();
+	}
+};
+
+TEST_REGISTER(TraceRecorderTest)
@@ -0,0 +1,70 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * v4l2_compat_ioctl_bench.cpp - Measure the cost of intercepted ioctl() calls
+ *
+ * When run with the V4L2 compatibility layer preloaded, every ioctl() call in
+ * the process goes through the interposer, including the ones unrelated to
+ * cameras. This benchmark compares the cost of ioctl() on a non-camera file
+ * descriptor through the C library entry point, which is intercepted, with the
+ * raw system call, which isn't.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <errno.h>
+#include <iostream>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace std::chrono;
+
+static constexpr unsigned int kIterations = 1000000;
+
+template<typename F>
+static double measure(F func)
+{
+	steady_clock::time_point start = steady_clock::now();
+
+	for (unsigned int i = 0; i < kIterations; i++)
+		func();
+
+	steady_clock::time_point end = steady_clock::now();
+
+	return duration_cast<duration<double, std::nano>>(end - start).count()
+	       / kIterations;
+}
+
+int main()
+{
+	int fds[2];
+	if (pipe(fds) < 0) {
+		cerr << "Failed to create pipe: " << strerror(errno) << endl;
+		return EXIT_FAILURE;
+	}
+
+	int available;
+
+	/* Warm up, to resolve symbols and initialize the interposer. */
+	ioctl(fds[0], FIONREAD, &available);
+
+	double raw = measure([&]() {
+		syscall(SYS_ioctl, fds[0], FIONREAD, &available);
+	});
+	double libc = measure([&]() {
+		ioctl(fds[0], FIONREAD, &available);
+	});
+
+	cout << "Raw ioctl syscall: " << raw << " ns/call" << endl;
+	cout << "ioctl() call:      " << libc << " ns/call" << endl;
+	cout << "Overhead:          " << libc - raw << " ns/call" << endl;
+
+	close(fds[0]);
+	close(fds[1]);
+
+	return 0;
+}
@@ -0,0 +1,397 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2022, Google Inc.
+ *
+ * v4l2_compat_multi_open.cpp - Test sharing a stream between multiple files
+ *
+ * Open the same camera twice through the V4L2 compatibility layer, share the
+ * buffers of the first file with the second one, and check that frames are
+ * delivered to both files according to the drop policy selected through the
+ * LIBCAMERA_V4L2_DROP_POLICY environment variable. The test must be run with
+ * the V4L2 compatibility layer preloaded.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <iostream>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+enum {
+	TestPass = 0,
+	TestFail = -1,
+	TestSkip = 77,
+};
+
+enum class DropPolicy {
+	Block,
+	DropOldest,
+	DropNewest,
+};
+
+static constexpr unsigned int kNumBuffers = 4;
+static constexpr int kTimeoutMs = 1000;
+
+static string findCamera()
+{
+	glob_t nodes;
+	string device;
+
+	if (glob("/dev/video*", 0, nullptr, &nodes))
+		return device;
+
+	for (size_t i = 0; i < nodes.gl_pathc && device.empty(); i++) {
+		int fd = open(nodes.gl_pathv[i], O_RDWR);
+		if (fd < 0)
+			continue;
+
+		struct v4l2_capability caps = {};
+		if (!ioctl(fd, VIDIOC_QUERYCAP, &caps) &&
+		    !strcmp(reinterpret_cast<const char *>(caps.driver), "libcamera"))
+			device = nodes.gl_pathv[i];
+
+		close(fd);
+	}
+
+	globfree(&nodes);
+
+	return device;
+}
+
+static int requestBuffers(int fd, unsigned int count)
+{
+	struct v4l2_requestbuffers req = {};
+	req.count = count;
+	req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	req.memory = V4L2_MEMORY_MMAP;
+
+	if (ioctl(fd, VIDIOC_REQBUFS, &req) < 0)
+		return -errno;
+
+	return req.count;
+}
+
+static int queueBuffer(int fd, unsigned int index)
+{
+	struct v4l2_buffer buf = {};
+	buf.index = index;
+	buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buf.memory = V4L2_MEMORY_MMAP;
+
+	if (ioctl(fd, VIDIOC_QBUF, &buf) < 0)
+		return -errno;
+
+	return 0;
+}
+
+/*
+ * Dequeue a buffer, waiting at most kTimeoutMs for it. Return -ETIMEDOUT if no
+ * frame is delivered in time.
+ */
+static int dequeueBuffer(int fd, struct v4l2_buffer *buf)
+{
+	struct pollfd pfd = { fd, POLLIN, 0 };
+
+	int ret = poll(&pfd, 1, kTimeoutMs);
+	if (ret < 0)
+		return -errno;
+	if (ret == 0)
+		return -ETIMEDOUT;
+
+	*buf = {};
+	buf->type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	buf->memory = V4L2_MEMORY_MMAP;
+
+	if (ioctl(fd, VIDIOC_DQBUF, buf) < 0)
+		return -errno;
+
+	return 0;
+}
+
+static int streamOn(int fd, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++) {
+		int ret = queueBuffer(fd, i);
+		if (ret < 0)
+			return ret;
+	}
+
+	int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	if (ioctl(fd, VIDIOC_STREAMON, &type) < 0)
+		return -errno;
+
+	return 0;
+}
+
+/*
+ * With both files dequeuing and requeuing all frames, each frame must be
+ * delivered to both of them with the block policy. The other policies may
+ * skip frames for the consumer if it lags behind the owner, but the frames it
+ * receives must still be delivered in order.
+ */
+static int testFanOut(int owner, int consumer, DropPolicy policy)
+{
+	unsigned int consumerFrames = 0;
+	unsigned int sequence = 0;
+
+	for (unsigned int i = 0; i < kNumBuffers * 4; i++) {
+		struct v4l2_buffer ownerBuf, consumerBuf;
+
+		int ret = dequeueBuffer(owner, &ownerBuf);
+		if (ret < 0) {
+			cerr << "Failed to dequeue from owner: " << strerror(-ret) << endl;
+			return TestFail;
+		}
+
+		if (queueBuffer(owner, ownerBuf.index) < 0) {
+			cerr << "Failed to requeue buffer" << endl;
+			return TestFail;
+		}
+
+		ret = dequeueBuffer(consumer, &consumerBuf);
+		if (ret == -ETIMEDOUT && policy != DropPolicy::Block)
+			continue;
+		if (ret < 0) {
+			cerr << "Failed to dequeue from consumer: " << strerror(-ret) << endl;
+			return TestFail;
+		}
+
+		if (policy == DropPolicy::Block &&
+		    (ownerBuf.index != consumerBuf.index ||
+		     ownerBuf.sequence != consumerBuf.sequence)) {
+			cerr << "Frame mismatch: owner got buffer " << ownerBuf.index
+			     << " (sequence " << ownerBuf.sequence << "), consumer got buffer "
+			     << consumerBuf.index << " (sequence " << consumerBuf.sequence
+			     << ")" << endl;
+			return TestFail;
+		}
+
+		if (consumerFrames && consumerBuf.sequence <= sequence) {
+			cerr << "Consumer got frame " << consumerBuf.sequence
+			     << " after frame " << sequence << endl;
+			return TestFail;
+		}
+
+		sequence = consumerBuf.sequence;
+		consumerFrames++;
+
+		if (queueBuffer(consumer, consumerBuf.index) < 0) {
+			cerr << "Failed to requeue buffer" << endl;
+			return TestFail;
+		}
+	}
+
+	if (!consumerFrames) {
+		cerr << "Consumer didn't receive any frame" << endl;
+		return TestFail;
+	}
+
+	return TestPass;
+}
+
+/*
+ * Stop dequeuing from the consumer and check how frames are delivered to the
+ * owner and to the stalled consumer according to the drop policy.
+ */
+static int testStall(int owner, int consumer, DropPolicy policy)
+{
+	unsigned int frames = 0;
+	unsigned int first = 0;
+	unsigned int last = 0;
+
+	/*
+	 * With the block policy the consumer holds every buffer it doesn't
+	 * dequeue, the owner thus runs out of frames after kNumBuffers at most.
+	 * With the other policies the consumer holds a single buffer and the
+	 * owner keeps receiving frames.
+	 */
+	while (frames < kNumBuffers * 4) {
+		struct v4l2_buffer buf;
+
+		int ret = dequeueBuffer(owner, &buf);
+		if (ret == -ETIMEDOUT)
+			break;
+		if (ret < 0) {
+			cerr << "Failed to dequeue from owner: " << strerror(-ret) << endl;
+			return TestFail;
+		}
+
+		if (!frames)
+			first = buf.sequence;
+		last = buf.sequence;
+		frames++;
+
+		if (queueBuffer(owner, buf.index) < 0) {
+			cerr << "Failed to requeue buffer" << endl;
+			return TestFail;
+		}
+	}
+
+	if (policy == DropPolicy::Block) {
+		if (frames > kNumBuffers) {
+			cerr << "Owner received " << frames
+			     << " frames while the consumer stalled" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	if (frames <= kNumBuffers) {
+		cerr << "Owner starved by the stalled consumer after "
+		     << frames << " frames" << endl;
+		return TestFail;
+	}
+
+	/* A single frame must be waiting for the consumer. */
+	struct v4l2_buffer buf;
+	int ret = dequeueBuffer(consumer, &buf);
+	if (ret < 0) {
+		cerr << "Failed to dequeue from consumer: " << strerror(-ret) << endl;
+		return TestFail;
+	}
+
+	struct v4l2_buffer extra = {};
+	extra.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	extra.memory = V4L2_MEMORY_MMAP;
+	if (ioctl(consumer, VIDIOC_DQBUF, &extra) == 0 || errno != EAGAIN) {
+		cerr << "More than one frame waiting for the consumer" << endl;
+		return TestFail;
+	}
+
+	/*
+	 * Dropping the oldest frames keeps the latest one, which the owner
+	 * has received after the first frame of the stall. Dropping the newest
+	 * frames keeps the first one, older than the last frame of the owner.
+	 */
+	if (policy == DropPolicy::DropOldest && buf.sequence <= first) {
+		cerr << "Consumer got stale frame " << buf.sequence
+		     << ", expected newer than " << first << endl;
+		return TestFail;
+	}
+
+	if (policy == DropPolicy::DropNewest && buf.sequence >= last) {
+		cerr << "Consumer got frame " << buf.sequence
+		     << ", expected older than " << last << endl;
+		return TestFail;
+	}
+
+	return TestPass;
+}
+
+/*
+ * Leaving the stream while a blocking dequeue is in progress must wake up the
+ * waiter with an error.
+ */
+static int testLeaveWhileWaiting(const string &device)
+{
+	int fd = open(device.c_str(), O_RDWR);
+	if (fd < 0) {
+		cerr << "Failed to open " << device << endl;
+		return TestFail;
+	}
+
+	int ret = requestBuffers(fd, kNumBuffers);
+	if (ret < 0) {
+		cerr << "Failed to share buffers: " << strerror(-ret) << endl;
+		close(fd);
+		return TestFail;
+	}
+
+	/* Don't queue any buffer, dequeuing then blocks until interrupted. */
+	int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	if (ioctl(fd, VIDIOC_STREAMON, &type) < 0) {
+		cerr << "Failed to start streaming: " << strerror(errno) << endl;
+		close(fd);
+		return TestFail;
+	}
+
+	int result = 0;
+	thread waiter([&]() {
+		struct v4l2_buffer buf = {};
+		buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+		buf.memory = V4L2_MEMORY_MMAP;
+		result = ioctl(fd, VIDIOC_DQBUF, &buf) < 0 ? -errno : 0;
+	});
+
+	usleep(100000);
+
+	requestBuffers(fd, 0);
+	waiter.join();
+
+	close(fd);
+
+	if (result != -EINVAL) {
+		cerr << "Blocked dequeue returned " << result
+		     << " after leaving the stream" << endl;
+		return TestFail;
+	}
+
+	return TestPass;
+}
+
+int main()
+{
+	DropPolicy policy = DropPolicy::Block;
+
+	const char *env = getenv("LIBCAMERA_V4L2_DROP_POLICY");
+	if (env && !strcmp(env, "drop-oldest"))
+		policy = DropPolicy::DropOldest;
+	else if (env && !strcmp(env, "drop-newest"))
+		policy = DropPolicy::DropNewest;
+
+	string device = findCamera();
+	if (device.empty()) {
+		cout << "No camera found through the V4L2 compatibility layer" << endl;
+		return TestSkip;
+	}
+
+	int owner = open(device.c_str(), O_RDWR | O_NONBLOCK);
+	int consumer = open(device.c_str(), O_RDWR | O_NONBLOCK);
+	if (owner < 0 || consumer < 0) {
+		cerr << "Failed to open " << device << endl;
+		return TestFail;
+	}
+
+	int ret = requestBuffers(owner, kNumBuffers);
+	if (ret < 0) {
+		cerr << "Failed to allocate buffers: " << strerror(-ret) << endl;
+		return TestFail;
+	}
+	unsigned int count = ret;
+
+	ret = requestBuffers(consumer, kNumBuffers);
+	if (ret < 0 || static_cast<unsigned int>(ret) != count) {
+		cerr << "Failed to share buffers" << endl;
+		return TestFail;
+	}
+
+	if (streamOn(owner, count) < 0 || streamOn(consumer, count) < 0) {
+		cerr << "Failed to start streaming" << endl;
+		return TestFail;
+	}
+
+	ret = testFanOut(owner, consumer, policy);
+	if (ret == TestPass)
+		ret = testStall(owner, consumer, policy);
+	if (ret == TestPass)
+		ret = testLeaveWhileWaiting(device);
+
+	int type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+	ioctl(consumer, VIDIOC_STREAMOFF, &type);
+	ioctl(owner, VIDIOC_STREAMOFF, &type);
+
+	close(consumer);
+	close(owner);
+
+	return ret;
+}
@@ -57,8 +57,24 @@ def extract_result(result):
     return ret
 
 
-def test_v4l2_compliance(v4l2_compliance, v4l2_compat, device, base_driver):
-    ret, output = run_with_stdout(v4l2_compliance, '-s', '-d', device, env={'LD_PRELOAD': v4l2_compat})
+def find_expbuf_device(v4l2_ctl, dev_nodes):
+    # vivid can export buffers, use it to test DMABUF import when available
+    for device in dev_nodes:
+        ret, out = run_with_stdout(v4l2_ctl, '-D', '-d', device)
+        if ret != 0:
+            continue
+        driver = grep('Driver name', out)
+        if driver and driver[0].split(':')[-1].strip() == 'vivid':
+            return device
+    return None
+
+
+def test_v4l2_compliance(v4l2_compliance, v4l2_compat, device, base_driver, expbuf_device):
+    args = [v4l2_compliance, '-s', '-d', device]
+    if expbuf_device is not None:
+        args += ['-e', expbuf_device]
+
+    ret, output = run_with_stdout(*args, env={'LD_PRELOAD': v4l2_compat})
     if ret < 0:
         output.append(f'Test for {device} terminated due to signal {signal.Signals(-ret).name}')
         return TestFail, output
@@ -115,6 +131,8 @@ def main(argv):
         print('no video nodes available to test with')
         return TestSkip
 
+    expbuf_device = find_expbuf_device(v4l2_ctl, dev_nodes)
+
     failed = []
     drivers_tested = {}
     for device in dev_nodes:
@@ -144,7 +162,8 @@ def main(argv):
             continue
 
         print(f'Testing {device} with {driver} driver... ', end='')
-        ret, msg = test_v4l2_compliance(v4l2_compliance, v4l2_compat, device, driver)
+        ret, msg = test_v4l2_compliance(v4l2_compliance, v4l2_compat, device, driver,
+                                        expbuf_device)
         if ret == TestFail:
             failed.append(device)
             print('failed')
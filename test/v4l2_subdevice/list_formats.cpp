@@ -10,6 +10,7 @@
 
 #include <libcamera/geometry.h>
 
+#include <libcamera/base/metrics.h>
 #include <libcamera/base/utils.h>
 
 #include "libcamera/internal/v4l2_subdevice.h"
@@ -29,6 +30,7 @@ protected:
 private:
 	void printFormats(unsigned int pad, unsigned code,
 			  const std::vector<SizeRange> &sizes);
+	uint64_t enumIoctls();
 };
 
 void ListFormatsTest::printFormats(unsigned int pad,
@@ -45,6 +47,19 @@ void ListFormatsTest::printFormats(unsigned int pad,
 	}
 }
 
+uint64_t ListFormatsTest::enumIoctls()
+{
+	uint64_t count = 0;
+
+	for (const auto &counter : MetricsRegistry::instance()->counters()) {
+		if (counter.name == "v4l2.subdev.enum_mbus_code" ||
+		    counter.name == "v4l2.subdev.enum_frame_size")
+			count += counter.value;
+	}
+
+	return count;
+}
+
 int ListFormatsTest::run()
 {
 	/* List all formats available on existing "Scaler" pads. */
@@ -68,6 +83,27 @@ int ListFormatsTest::run()
 	for (unsigned int code : utils::map_keys(formats))
 		printFormats(1, code, formats[code]);
 
+	/* Formats are cached, listing them again shall not issue any ioctl. */
+	uint64_t ioctls = enumIoctls();
+	if (!ioctls) {
+		cerr << "Format enumeration ioctls not counted" << endl;
+		return TestFail;
+	}
+
+	if (scaler_->formats(1) != formats || enumIoctls() != ioctls) {
+		cerr << "Formats on pad 1 of subdevice "
+		     << scaler_->entity()->name() << " not cached" << endl;
+		return TestFail;
+	}
+
+	scaler_->invalidateFormats();
+
+	if (scaler_->formats(1) != formats || enumIoctls() == ioctls) {
+		cerr << "Formats on pad 1 of subdevice "
+		     << scaler_->entity()->name() << " not invalidated" << endl;
+		return TestFail;
+	}
+
 	/* List format on a non-existing pad, format vector shall be empty. */
 	formats = scaler_->formats(2);
 	if (!formats.empty()) {
@@ -6,12 +6,16 @@
  */
 
 #include <array>
+#include <chrono>
 #include <iostream>
 #include <map>
+#include <sstream>
 #include <string>
 #include <unistd.h>
+#include <vector>
 
 #include <libcamera/base/file.h>
+#include <libcamera/base/span.h>
 #include <libcamera/base/utils.h>
 
 #include "libcamera/internal/yaml_parser.h"
@@ -37,11 +41,43 @@ static const string testYaml =
 	"level1:\n"
 	"  level2:\n"
 	"    - [1, 2]\n"
-	"    - {one: 1, two: 2}\n";
+	"    - {one: 1, two: 2}\n"
+	"numbers: [0.5, -1.25, 2]\n"
+	"table:\n"
+	"  - [1, 2, 3]\n"
+	"  - [4, 5, 6]\n";
 
 static const string invalidYaml =
 	"Invalid : - YAML : - Content";
 
+/*
+ * Generate a large synthetic tuning file, made of many algorithms each holding
+ * lens shading correction-like tables, to measure the parser performance.
+ */
+static string generateLargeYaml(unsigned int algorithms, unsigned int tables,
+				unsigned int tableSize)
+{
+	ostringstream yaml;
+
+	yaml << "version: 1\n";
+	yaml << "algorithms:\n";
+
+	for (unsigned int i = 0; i < algorithms; i++) {
+		yaml << "  - Algorithm" << i << ":\n";
+		yaml << "      enabled: true\n";
+		yaml << "      ct: " << 2000 + i * 100 << "\n";
+		yaml << "      tables:\n";
+
+		for (unsigned int j = 0; j < tables; j++) {
+			yaml << "        - [ ";
+			for (unsigned int k = 0; k < tableSize; k++)
+				yaml << (i + j + k) % 4096 << (k + 1 < tableSize ? ", " : " ]\n");
+		}
+	}
+
+	return yaml.str();
+}
+
 class YamlParserTest : public Test
 {
 protected:
@@ -69,6 +105,10 @@ protected:
 		if (!createFile(invalidYaml, invalidYamlFile_))
 			return TestFail;
 
+		if (!createFile(generateLargeYaml(kAlgorithms, kTables, kTableSize),
+				largeYamlFile_))
+			return TestFail;
+
 		return TestPass;
 	}
 
@@ -534,6 +574,125 @@ protected:
 			return TestFail;
 		}
 
+		/* Test bulk extraction of numerical lists and tables */
+		std::array<double, 3> numbers;
+		if (!(*root)["numbers"].getList(Span<double>(numbers)) ||
+		    numbers != std::array<double, 3>{ 0.5, -1.25, 2.0 }) {
+			cerr << "Numbers object fail to parse as double list" << std::endl;
+			return TestFail;
+		}
+
+		std::array<uint32_t, 3> unsignedNumbers;
+		if ((*root)["numbers"].getList(Span<uint32_t>(unsignedNumbers))) {
+			cerr << "Numbers object parse as unsigned integer list" << std::endl;
+			return TestFail;
+		}
+
+		std::array<double, 2> shortNumbers;
+		if ((*root)["numbers"].getList(Span<double>(shortNumbers))) {
+			cerr << "Numbers object parse with wrong size" << std::endl;
+			return TestFail;
+		}
+
+		std::array<uint16_t, 6> table;
+		if (!(*root)["table"].getTable(Span<uint16_t>(table), 2, 3) ||
+		    table != std::array<uint16_t, 6>{ 1, 2, 3, 4, 5, 6 }) {
+			cerr << "Table object fail to parse as 2x3 table" << std::endl;
+			return TestFail;
+		}
+
+		if ((*root)["table"].getTable(Span<uint16_t>(table), 3, 2)) {
+			cerr << "Table object parse as 3x2 table" << std::endl;
+			return TestFail;
+		}
+
+		if ((*root)["level1"]["level2"].getTable(Span<uint16_t>(table), 2, 3)) {
+			cerr << "Mixed list object parse as table" << std::endl;
+			return TestFail;
+		}
+
+		return runLargeFile();
+	}
+
+	int runLargeFile()
+	{
+		static constexpr unsigned int kIterations = 10;
+
+		File file{ largeYamlFile_ };
+		if (!file.open(File::OpenModeFlag::ReadOnly)) {
+			cerr << "Fail to open large YAML file" << std::endl;
+			return TestFail;
+		}
+
+		std::unique_ptr<YamlObject> root;
+		std::chrono::nanoseconds duration{ 0 };
+
+		for (unsigned int i = 0; i < kIterations; i++) {
+			file.seek(0);
+
+			auto start = std::chrono::steady_clock::now();
+			root = YamlParser::parse(file);
+			duration += std::chrono::steady_clock::now() - start;
+
+			if (!root) {
+				cerr << "Fail to parse large YAML file" << std::endl;
+				return TestFail;
+			}
+		}
+
+		cout << "Parsed " << file.size() << " bytes YAML file in "
+		     << std::chrono::duration_cast<std::chrono::microseconds>(duration).count() / kIterations
+		     << " us" << std::endl;
+
+		const YamlObject &algos = (*root)["algorithms"];
+		if (!algos.isList() || algos.size() != kAlgorithms) {
+			cerr << "Large YAML file algorithms fail to parse as list" << std::endl;
+			return TestFail;
+		}
+
+		const unsigned int index = kAlgorithms - 1;
+		const YamlObject &algo = algos[index]["Algorithm" + std::to_string(index)];
+		if (!algo.isDictionary() || algo.size() != 3 ||
+		    algo["ct"].get<uint32_t>(0) != 2000 + index * 100) {
+			cerr << "Large YAML file algorithm fail to parse as dictionary" << std::endl;
+			return TestFail;
+		}
+
+		const YamlObject &table = algo["tables"][kTables - 1];
+		if (!table.isList() || table.size() != kTableSize ||
+		    table[kTableSize - 1].get<uint32_t>(0) !=
+		    (index + kTables - 1 + kTableSize - 1) % 4096) {
+			cerr << "Large YAML file table fail to parse as list" << std::endl;
+			return TestFail;
+		}
+
+		/* Extract all the tables in bulk. */
+		std::vector<uint16_t> tables(kAlgorithms * kTables * kTableSize);
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (unsigned int i = 0; i < kAlgorithms; i++) {
+			const YamlObject &data = algos[i]["Algorithm" + std::to_string(i)]["tables"];
+			Span<uint16_t> values{ &tables[i * kTables * kTableSize],
+					       kTables * kTableSize };
+
+			if (!data.getTable(values, kTables, kTableSize)) {
+				cerr << "Large YAML file tables fail to parse as table" << std::endl;
+				return TestFail;
+			}
+		}
+
+		duration = std::chrono::steady_clock::now() - start;
+
+		cout << "Extracted " << tables.size() << " table values in "
+		     << std::chrono::duration_cast<std::chrono::microseconds>(duration).count()
+		     << " us" << std::endl;
+
+		if (tables.back() != (index + kTables - 1 + kTableSize - 1) % 4096) {
+			cerr << "Large YAML file tables have wrong values" << std::endl;
+			return TestFail;
+		}
+
 		return TestPass;
 	}
 
@@ -541,11 +700,17 @@ protected:
 	{
 		unlink(testYamlFile_.c_str());
 		unlink(invalidYamlFile_.c_str());
+		unlink(largeYamlFile_.c_str());
 	}
 
 private:
+	static constexpr unsigned int kAlgorithms = 100;
+	static constexpr unsigned int kTables = 4;
+	static constexpr unsigned int kTableSize = 17 * 13;
+
 	std::string testYamlFile_;
 	std::string invalidYamlFile_;
+	std::string largeYamlFile_;
 };
 
 TEST_REGISTER(YamlParserTest)
@@ -0,0 +1,273 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+# Copyright (C) 2022, Google Inc.
+#
+# analyze-trace.py - Per-stage latency analysis of libcamera lttng traces
+#
+# The script matches the libcamera tracepoints of a trace to compute the time
+# spent in each stage of request processing, IPA calls, IPC round-trips and
+# thread message queues, and prints latency statistics for each stage.
+#
+# It can additionally export the trace in the Chrome JSON trace event format,
+# which can be loaded in Perfetto (https://ui.perfetto.dev) or chrome://tracing.
+#
+# Tracepoints are available for the libcamera and libcamera_base providers. To
+# attribute events to threads, enable the vtid context:
+#
+#   lttng create
+#   lttng enable-event -u 'libcamera:*' -u 'libcamera_base:*'
+#   lttng add-context -u -t vtid
+#   lttng start
+
+import argparse
+import bt2
+import json
+import statistics as stats
+import sys
+
+
+class Stage(object):
+    def __init__(self):
+        self.samples = []
+
+    def add(self, duration):
+        self.samples.append(duration)
+
+    def percentile(self, percent):
+        samples = sorted(self.samples)
+        index = min(int(len(samples) * percent / 100), len(samples) - 1)
+        return samples[index]
+
+
+class TraceAnalyzer(object):
+    def __init__(self, perfetto):
+        # stage name -> Stage
+        self.stages = {}
+
+        # Chrome trace events, or None if export is disabled
+        self.events = [] if perfetto else None
+
+        # Pending begin timestamps, keyed by the objects tracked by the
+        # tracepoints
+        self.requests = {}
+        self.buffers = {}
+        self.dequeued = {}
+        self.ipa_calls = {}
+        self.ipc_calls = {}
+        self.messages = {}
+        self.sleeps = {}
+
+        self.request_id = 0
+
+    def stage(self, name, begin, end, tid=0, track=None, id=None):
+        if name not in self.stages:
+            self.stages[name] = Stage()
+        self.stages[name].add(end - begin)
+
+        if self.events is None:
+            return
+
+        if id is None:
+            self.events.append({
+                'name': name, 'ph': 'X', 'pid': 0, 'tid': tid,
+                'ts': begin / 1000, 'dur': (end - begin) / 1000,
+            })
+        else:
+            # Overlapping stages are reported as async events
+            for ph, ts in (('b', begin), ('e', end)):
+                self.events.append({
+                    'name': name, 'cat': track, 'ph': ph, 'pid': 0,
+                    'id': id, 'ts': ts / 1000,
+                })
+
+    def instant(self, name, ts, tid, args):
+        if self.events is None:
+            return
+
+        self.events.append({
+            'name': name, 'ph': 'i', 's': 't', 'pid': 0, 'tid': tid,
+            'ts': ts / 1000, 'args': args,
+        })
+
+    def process(self, msg):
+        event = msg.event
+        name = event.name
+        ts = msg.default_clock_snapshot.ns_from_origin
+        payload = event.payload_field
+
+        try:
+            tid = int(event.common_context_field['vtid'])
+        except (KeyError, TypeError):
+            tid = 0
+
+        if not name.startswith('libcamera:') and \
+           not name.startswith('libcamera_base:'):
+            return
+
+        name = name.split(':', 1)[1]
+
+        # Request stages. The request pointer is reused when requests are
+        # reused, identify each request instance separately.
+        if name == 'request_queue':
+            self.request_id += 1
+            self.requests[int(payload['request'])] = {
+                'id': self.request_id, 'queue': ts,
+            }
+
+        elif name == 'request_device_queue':
+            req = self.requests.get(int(payload['request']))
+            if req:
+                req['device'] = ts
+                self.stage('request.queue_to_device', req['queue'], ts,
+                           track='request', id=req['id'])
+
+        elif name == 'request_complete_buffer':
+            req = self.requests.get(int(payload['request']))
+            buffer = int(payload['buffer'])
+            if req and 'device' in req:
+                req['buffer'] = ts
+                self.stage('request.device_to_buffer', req['device'], ts,
+                           track='request', id=req['id'])
+
+            dequeued = self.dequeued.pop(buffer, None)
+            if dequeued is not None:
+                self.stage('buffer.dequeue_to_complete', dequeued, ts,
+                           track='buffer', id=buffer)
+
+        elif name == 'request_complete':
+            req = self.requests.pop(int(payload['request']), None)
+            if req and int(payload['status']) == 1:
+                if 'buffer' in req:
+                    self.stage('request.buffer_to_complete', req['buffer'],
+                               ts, track='request', id=req['id'])
+                self.stage('request.queue_to_complete', req['queue'], ts,
+                           track='request', id=req['id'])
+
+        # V4L2 buffers
+        elif name == 'v4l2_queue_buffer':
+            self.buffers[int(payload['buffer'])] = ts
+            self.instant('v4l2_queue_buffer', ts, tid,
+                         {'device': str(payload['device']),
+                          'index': int(payload['index'])})
+
+        elif name == 'v4l2_dequeue_buffer':
+            buffer = int(payload['buffer'])
+            queued = self.buffers.pop(buffer, None)
+            if queued is not None:
+                self.stage('v4l2.' + str(payload['device']), queued, ts,
+                           track='v4l2', id=buffer)
+            self.dequeued[buffer] = ts
+
+        elif name == 'v4l2_set_controls':
+            self.instant('v4l2_set_controls', ts, tid,
+                         {'device': str(payload['device']),
+                          'count': int(payload['count']),
+                          'ret': int(payload['ret'])})
+
+        elif name in ('delayed_controls_push', 'delayed_controls_apply'):
+            self.instant(name, ts, tid,
+                         {k: int(payload[k]) for k in payload.keys()})
+
+        # IPA calls
+        elif name == 'ipa_call_begin':
+            key = (str(payload['pipeline_name']), str(payload['function_name']))
+            self.ipa_calls.setdefault(key, []).append(ts)
+
+        elif name == 'ipa_call_end':
+            key = (str(payload['pipeline_name']), str(payload['function_name']))
+            begin = self.ipa_calls.get(key)
+            if begin:
+                self.stage('ipa.{}.{}'.format(*key), begin.pop(), ts, tid)
+
+        # IPC round-trips, matched by cookie
+        elif name == 'ipc_send_sync':
+            self.ipc_calls[int(payload['cookie'])] = (ts, int(payload['cmd']))
+
+        elif name == 'ipc_receive':
+            call = self.ipc_calls.pop(int(payload['cookie']), None)
+            if call is not None:
+                self.stage('ipc.cmd{}'.format(call[1]), call[0], ts, tid)
+            else:
+                self.instant('ipc_receive', ts, tid,
+                             {'cmd': int(payload['cmd']),
+                              'size': int(payload['size'])})
+
+        elif name == 'ipc_send_async':
+            self.instant('ipc_send_async', ts, tid,
+                         {'cmd': int(payload['cmd']),
+                          'size': int(payload['size'])})
+
+        # Thread message queues
+        elif name == 'thread_message_post':
+            self.messages[int(payload['message'])] = ts
+
+        elif name == 'thread_message_dispatch':
+            posted = self.messages.pop(int(payload['message']), None)
+            if posted is not None:
+                self.stage('thread.{}.message_wait'.format(payload['thread']),
+                           posted, ts, track='message',
+                           id=int(payload['message']))
+
+        # Event dispatcher
+        elif name == 'event_dispatcher_sleep':
+            self.sleeps[tid] = ts
+
+        elif name == 'event_dispatcher_wakeup':
+            sleep = self.sleeps.pop(tid, None)
+            if sleep is not None:
+                self.stage('event_dispatcher.sleep', sleep, ts, tid)
+
+    def print_stats(self):
+        rows = [['stage', 'count', 'min', 'mean', 'p50', 'p90', 'p99', 'max']]
+
+        for name, stage in sorted(self.stages.items()):
+            v = stage.samples
+            rows.append([name, str(len(v))] +
+                        ['{:.1f}'.format(x / 1000) for x in
+                         [min(v), stats.mean(v), stage.percentile(50),
+                          stage.percentile(90), stage.percentile(99), max(v)]])
+
+        # Get maximum string width for every column
+        widths = []
+        for i in range(len(rows[0])):
+            widths.append(max([len(row[i]) for row in rows]))
+
+        print('Latencies in microseconds')
+        for row in rows:
+            fmt = [row[i].rjust(widths[i]) for i in range(1, len(row))]
+            print(' '.join([row[0].ljust(widths[0])] + fmt))
+
+    def write_perfetto(self, path):
+        with open(path, 'w', encoding='utf-8') as f:
+            json.dump({'traceEvents': self.events,
+                       'displayTimeUnit': 'ns'}, f)
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(
+            description='Compute per-stage latencies from libcamera lttng traces')
+    parser.add_argument('-p', '--perfetto', type=str,
+                        help='Export the trace to a Chrome JSON trace file, for use with Perfetto')
+    parser.add_argument('trace_path', type=str,
+                        help='Path to lttng trace (eg. ~/lttng-traces/demo-20201029-184003)')
+    args = parser.parse_args(argv[1:])
+
+    analyzer = TraceAnalyzer(args.perfetto is not None)
+
+    traces = bt2.TraceCollectionMessageIterator(args.trace_path)
+    for msg in traces:
+        if type(msg) is not bt2._EventMessageConst:
+            continue
+
+        analyzer.process(msg)
+
+    analyzer.print_stats()
+
+    if args.perfetto:
+        analyzer.write_perfetto(args.perfetto)
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
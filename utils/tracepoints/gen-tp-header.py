@@ -9,8 +9,29 @@
 import datetime
 import jinja2
 import os
+import re
 import sys
 
+
+def event_args(source):
+    '''
+    Extract the names of the arguments of all tracepoint events, to name the
+    arguments of the events recorded by the trace recorder.
+    '''
+    events = []
+
+    patterns = [
+        r'TRACEPOINT_EVENT\(\s*\w+\s*,\s*(\w+)\s*,\s*TP_ARGS\(([^)]*)\)',
+        r'TRACEPOINT_EVENT_INSTANCE\(\s*\w+\s*,\s*\w+\s*,\s*(\w+)\s*,\s*TP_ARGS\(([^)]*)\)',
+    ]
+
+    for pattern in patterns:
+        for match in re.finditer(pattern, source):
+            args = [arg.strip() for arg in match.group(2).split(',')]
+            events.append((match.group(1), args[1::2]))
+
+    return events
+
 def main(argv):
     if len(argv) < 3:
         print(f'Usage: {argv[0]} output template tp_files...')
@@ -27,7 +48,8 @@ def main(argv):
         source += open(fname, 'r', encoding='utf-8').read() + '\n\n'
 
     template = jinja2.Template(open(template, 'r', encoding='utf-8').read())
-    string = template.render(year=year, path=path, source=source)
+    string = template.render(year=year, path=path, source=source,
+                             events=event_args(source))
 
     f = open(output, 'w', encoding='utf-8').write(string)
 